@@ -0,0 +1,73 @@
+#include <opencv/cv.hpp>
+
+#include "bench_util.hpp"
+#include "../serializer.hpp"
+
+using namespace ILLIXR;
+using namespace ILLIXR::bench;
+
+static constexpr std::size_t ITERATIONS = 100000;
+
+template <typename T>
+static void bench_type(const std::string& name, const T& value, std::size_t iterations) {
+	wire_buffer buffer;
+	serialize(value, buffer);
+	const double bytes = buffer.size();
+
+	double encode_ns = ns_per_op(iterations, [&] {
+		serialize(value, buffer);
+		do_not_optimize(buffer.data());
+	});
+	report{"serialize/" + name}
+		.field("iterations", iterations)
+		.field("bytes", buffer.size())
+		.field("ns_per_op", encode_ns)
+		.field("mb_per_s", bytes / encode_ns * 1e3);
+
+	// Reading in place only validates the header.
+	double view_ns = ns_per_op(iterations, [&] {
+		wire_view<T> view {buffer};
+		do_not_optimize(view.body());
+	});
+	report{"view/" + name}
+		.field("iterations", iterations)
+		.field("ns_per_op", view_ns);
+
+	double decode_ns = ns_per_op(iterations, [&] {
+		T out = wire_view<T>{buffer}.decode();
+		do_not_optimize(out);
+		if constexpr (std::is_same_v<T, imu_cam_type>) {
+			delete out.img0.value_or(nullptr);
+			delete out.img1.value_or(nullptr);
+		}
+	});
+	// Images are not copied on decode, so no throughput figure here.
+	report{"deserialize/" + name}
+		.field("iterations", iterations)
+		.field("ns_per_op", decode_ns);
+}
+
+int main() {
+	const time_type now = std::chrono::system_clock::now();
+	const pose_type pose {now, Eigen::Vector3f{1, 2, 3}, Eigen::Quaternionf{1, 0, 0, 0}};
+
+	bench_type("pose_type", pose, ITERATIONS);
+	bench_type("fast_pose_type", fast_pose_type{pose, now, now}, ITERATIONS);
+
+	imu_raw_type imu_raw;
+	imu_raw.w_hat = imu_raw.a_hat = imu_raw.w_hat2 = imu_raw.a_hat2 = Eigen::Vector3d::Ones();
+	imu_raw.state_plus = Eigen::Matrix<double, 13, 1>::Ones();
+	imu_raw.imu_time = now;
+	bench_type("imu_raw_type", imu_raw, ITERATIONS);
+
+	imu_cam_type imu_only {now, Eigen::Vector3f::Ones(), Eigen::Vector3f::Ones(), std::nullopt, std::nullopt, 0};
+	bench_type("imu_cam_type/imu_only", imu_only, ITERATIONS);
+
+	// EuRoC-sized stereo pair; this is dominated by the pixel memcpy on encode.
+	cv::Mat img0 {480, 752, CV_8UC1};
+	cv::Mat img1 {480, 752, CV_8UC1};
+	imu_cam_type imu_cam {now, Eigen::Vector3f::Ones(), Eigen::Vector3f::Ones(), &img0, &img1, 0};
+	bench_type("imu_cam_type/stereo_752x480", imu_cam, ITERATIONS / 100);
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+  Helpers shared by the `bench/` programs of every module.
+
+  Each benchmark prints one JSON object per line to stdout, e.g.
+
+      {"bench": "serialize/imu_cam_type", "iterations": 100000, "ns_per_op": 812.5}
+
+  so that `make bench/run > bench.jsonl` can be diffed between commits or loaded into pandas.
+*/
+
+namespace ILLIXR::bench {
+
+	/**
+	 * @brief Defeats dead-code elimination of a benchmarked value.
+	 */
+	template <typename T>
+	inline void do_not_optimize(const T& value) {
+		asm volatile ("" : : "r,m"(value) : "memory");
+	}
+
+	class report {
+	public:
+		explicit report(std::string name) {
+			line = "{\"bench\": \"" + name + "\"";
+		}
+
+		report& field(const std::string& key, double value) {
+			char buf[64];
+			std::snprintf(buf, sizeof(buf), "%.3f", value);
+			line += ", \"" + key + "\": " + buf;
+			return *this;
+		}
+
+		report& field(const std::string& key, std::size_t value) {
+			line += ", \"" + key + "\": " + std::to_string(value);
+			return *this;
+		}
+
+		report& field(const std::string& key, const std::string& value) {
+			line += ", \"" + key + "\": \"" + value + "\"";
+			return *this;
+		}
+
+		~report() {
+			std::printf("%s}\n", line.c_str());
+			std::fflush(stdout);
+		}
+
+	private:
+		std::string line;
+	};
+
+	/**
+	 * @brief Runs @p fn @p iterations times (after a short warm-up), returning ns per call.
+	 */
+	template <typename Fn>
+	double ns_per_op(std::size_t iterations, Fn&& fn) {
+		for (std::size_t i = 0; i < std::max<std::size_t>(iterations / 100, 1); ++i) {
+			fn();
+		}
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < iterations; ++i) {
+			fn();
+		}
+		auto stop = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>{stop - start}.count() / iterations;
+	}
+
+	/**
+	 * @brief Returns the @p q quantile (0 <= q <= 1) of @p samples. Sorts @p samples in place.
+	 */
+	template <typename T>
+	T quantile(std::vector<T>& samples, double q) {
+		if (samples.empty()) {
+			return T{};
+		}
+		std::sort(samples.begin(), samples.end());
+		return samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))];
+	}
+
+	/**
+	 * @brief Adds p50/p90/p99/p99.9/max of @p samples (in ns) to @p r.
+	 */
+	template <typename T>
+	report& percentiles(report& r, std::vector<T>& samples) {
+		r.field("p50_ns", static_cast<double>(quantile(samples, 0.50)));
+		r.field("p90_ns", static_cast<double>(quantile(samples, 0.90)));
+		r.field("p99_ns", static_cast<double>(quantile(samples, 0.99)));
+		r.field("p999_ns", static_cast<double>(quantile(samples, 0.999)));
+		r.field("max_ns", static_cast<double>(samples.empty() ? T{} : samples.back()));
+		return r;
+	}
+
+}
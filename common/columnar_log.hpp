@@ -0,0 +1,530 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ILLIXR::columnar {
+
+	/*
+	  On-disk format of the append-only metrics log written by `mmap_record_logger`, one file per table.
+	  All integers are little-endian, as on every platform ILLIXR runs on.
+
+	  offset 0:                                   file_header, table name, column descriptions
+	  offset header_bytes + k * extent_bytes:      extent k
+
+	  Each writing thread owns the extent it is appending to, so no two threads ever write the same
+	  bytes. An extent is a sequence of blocks; the unused tail of an extent is zero (no block magic).
+
+	  block:
+	    block_header
+	    uint8_t width[column_count], padded to 8 bytes: bytes per value of each column in this block
+	    each column's values for every row of the block (columnar), each column padded to 8 bytes
+	    string bytes, referenced by the string columns
+
+	  Column encodings:
+	    u64, duration_ns: int64 per row
+	    f64:              double per row
+	    boolean:          uint8 per row
+	    time_point_ns:    int64 base (the first row), then the difference from the previous row in
+	                      `width` (4 or 8) bytes per row. The first difference is always 0.
+	    string:           {uint32 offset from the start of the block, uint32 size} per row
+	*/
+
+	static constexpr uint32_t FILE_MAGIC = 0x43584c49; // "ILXC"
+	static constexpr uint32_t BLOCK_MAGIC = 0x4b4c4249; // "IBLK"
+	static constexpr uint32_t VERSION = 1;
+
+	/**
+	 * @brief Space reserved for the file header; extents start here.
+	 *
+	 * A multiple of the page size on every platform we run on, so extents can be mmap'd individually.
+	 */
+	static constexpr std::size_t HEADER_BYTES = 64 * 1024;
+
+	/**
+	 * @brief Size of the region a thread claims at once.
+	 */
+	static constexpr std::size_t EXTENT_BYTES = 4 * 1024 * 1024;
+
+	enum class column_type : uint8_t {
+		u64 = 1,
+		boolean = 2,
+		f64 = 3,
+		duration_ns = 4,
+		time_point_ns = 5,
+		string = 6,
+	};
+
+	struct file_header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t header_bytes;
+		uint32_t extent_bytes;
+		uint32_t column_count;
+		uint32_t name_size;
+		// Followed by the table name, then column_count * (column_desc, column name).
+	};
+
+	struct column_desc {
+		uint8_t type;
+		uint8_t reserved;
+		uint16_t name_size;
+	};
+
+	struct block_header {
+		uint32_t magic;
+		uint32_t rows;
+		uint32_t size;
+		/// The kernel thread id of the writer.
+		uint32_t tid;
+	};
+
+	static_assert(sizeof(file_header) == 24);
+	static_assert(sizeof(column_desc) == 4);
+	static_assert(sizeof(block_header) == 16);
+
+	static constexpr std::size_t align8(std::size_t offset) {
+		return (offset + 7) & ~std::size_t{7};
+	}
+
+	static inline column_type column_type_of(const std::type_info& type) {
+		if (false) {
+		} else if (type == typeid(std::size_t)) {
+			return column_type::u64;
+		} else if (type == typeid(bool)) {
+			return column_type::boolean;
+		} else if (type == typeid(double)) {
+			return column_type::f64;
+		} else if (type == typeid(std::chrono::nanoseconds)) {
+			return column_type::duration_ns;
+		} else if (type == typeid(std::chrono::high_resolution_clock::time_point)) {
+			return column_type::time_point_ns;
+		} else if (type == typeid(std::string)) {
+			return column_type::string;
+		} else {
+			throw std::runtime_error{std::string{"type "} + type.name() + " cannot be stored in a columnar log"};
+		}
+	}
+
+	static inline const char* column_type_name(column_type type) {
+		switch (type) {
+		case column_type::u64: return "u64";
+		case column_type::boolean: return "bool";
+		case column_type::f64: return "f64";
+		case column_type::duration_ns: return "duration_ns";
+		case column_type::time_point_ns: return "time_point_ns";
+		case column_type::string: return "string";
+		}
+		return "unknown";
+	}
+
+	/**
+	 * @brief Serializes the file header for a table.
+	 */
+	static inline std::vector<std::byte> encode_file_header(const std::string& name, const std::vector<std::pair<std::string, column_type>>& columns) {
+		std::vector<std::byte> ret (sizeof(file_header));
+		auto append = [&](const void* data, std::size_t size) {
+			const std::byte* bytes = static_cast<const std::byte*>(data);
+			ret.insert(ret.end(), bytes, bytes + size);
+		};
+		file_header header {FILE_MAGIC, VERSION, HEADER_BYTES, EXTENT_BYTES,
+			static_cast<uint32_t>(columns.size()), static_cast<uint32_t>(name.size())};
+		std::memcpy(ret.data(), &header, sizeof(header));
+		append(name.data(), name.size());
+		for (const auto& [column_name, type] : columns) {
+			column_desc desc {static_cast<uint8_t>(type), 0, static_cast<uint16_t>(column_name.size())};
+			append(&desc, sizeof(desc));
+			append(column_name.data(), column_name.size());
+		}
+		if (ret.size() > HEADER_BYTES) {
+			throw std::runtime_error{"Schema of " + name + " does not fit in a columnar log header"};
+		}
+		return ret;
+	}
+
+	/**
+	 * @brief Encodes runs of rows into blocks.
+	 *
+	 * `Source` provides `template <typename T> T get(std::size_t row, unsigned column) const` for every
+	 * column type in `column_type_of`. Encoding happens in two passes, `measure` then `encode`, so that
+	 * the caller can claim exactly enough space first.
+	 */
+	class block_encoder {
+	public:
+		using time_point = std::chrono::high_resolution_clock::time_point;
+
+		explicit block_encoder(std::vector<column_type> types_)
+			: types{std::move(types_)}
+		{ }
+
+		/**
+		 * @brief Returns the size in bytes of a block holding rows [first, first + count) of @p src.
+		 *
+		 * Also chooses the per-column widths, which `encode` must be given.
+		 */
+		template <typename Source>
+		std::size_t measure(const Source& src, std::size_t first, std::size_t count, std::vector<uint8_t>& widths) const {
+			widths.resize(types.size());
+			std::size_t size = align8(sizeof(block_header) + types.size());
+			std::size_t string_bytes = 0;
+			for (unsigned column = 0; column < types.size(); ++column) {
+				switch (types[column]) {
+				case column_type::u64:
+				case column_type::duration_ns:
+				case column_type::f64:
+					widths[column] = 8;
+					break;
+				case column_type::boolean:
+					widths[column] = 1;
+					break;
+				case column_type::time_point_ns:
+					widths[column] = deltas_fit_in_32_bits(src, first, count, column) ? 4 : 8;
+					size += sizeof(int64_t);
+					break;
+				case column_type::string:
+					widths[column] = 8;
+					for (std::size_t row = first; row < first + count; ++row) {
+						string_bytes += src.template get<std::string>(row, column).size();
+					}
+					break;
+				}
+				size += align8(widths[column] * count);
+			}
+			return size + align8(string_bytes);
+		}
+
+		/**
+		 * @brief Writes the block measured by `measure` to @p out, which has room for @p size bytes.
+		 */
+		template <typename Source>
+		void encode(const Source& src, std::size_t first, std::size_t count, const std::vector<uint8_t>& widths,
+					uint32_t tid, std::byte* out, std::size_t size) const {
+			block_header header {BLOCK_MAGIC, static_cast<uint32_t>(count), static_cast<uint32_t>(size), tid};
+			std::memcpy(out, &header, sizeof(header));
+			std::memcpy(out + sizeof(header), widths.data(), widths.size());
+
+			std::size_t offset = align8(sizeof(block_header) + types.size());
+			std::vector<std::pair<unsigned, std::size_t>> string_columns;
+			for (unsigned column = 0; column < types.size(); ++column) {
+				std::byte* col = out + offset;
+				switch (types[column]) {
+				case column_type::u64:
+					for (std::size_t i = 0; i < count; ++i) {
+						put<int64_t>(col, i, static_cast<int64_t>(src.template get<std::size_t>(first + i, column)));
+					}
+					break;
+				case column_type::duration_ns:
+					for (std::size_t i = 0; i < count; ++i) {
+						put<int64_t>(col, i, src.template get<std::chrono::nanoseconds>(first + i, column).count());
+					}
+					break;
+				case column_type::f64:
+					for (std::size_t i = 0; i < count; ++i) {
+						put<double>(col, i, src.template get<double>(first + i, column));
+					}
+					break;
+				case column_type::boolean:
+					for (std::size_t i = 0; i < count; ++i) {
+						put<uint8_t>(col, i, src.template get<bool>(first + i, column));
+					}
+					break;
+				case column_type::time_point_ns: {
+					int64_t prev = count ? ns_since_epoch(src.template get<time_point>(first, column)) : 0;
+					std::memcpy(col, &prev, sizeof(prev));
+					col += sizeof(int64_t);
+					offset += sizeof(int64_t);
+					for (std::size_t i = 0; i < count; ++i) {
+						int64_t value = ns_since_epoch(src.template get<time_point>(first + i, column));
+						if (widths[column] == 4) {
+							put<int32_t>(col, i, static_cast<int32_t>(value - prev));
+						} else {
+							put<int64_t>(col, i, value - prev);
+						}
+						prev = value;
+					}
+					break;
+				}
+				case column_type::string:
+					string_columns.emplace_back(column, offset);
+					break;
+				}
+				offset += align8(widths[column] * count);
+			}
+
+			for (const auto& [column, column_offset] : string_columns) {
+				for (std::size_t i = 0; i < count; ++i) {
+					std::string value = src.template get<std::string>(first + i, column);
+					uint32_t ref[2] = {static_cast<uint32_t>(offset), static_cast<uint32_t>(value.size())};
+					std::memcpy(out + column_offset + i * sizeof(ref), ref, sizeof(ref));
+					std::memcpy(out + offset, value.data(), value.size());
+					offset += value.size();
+				}
+			}
+			// Keep the padding deterministic; the extent is zero-filled, but the caller's buffer may not be.
+			std::memset(out + offset, 0, size - offset);
+		}
+
+		const std::vector<column_type>& get_types() const { return types; }
+
+	private:
+		template <typename T>
+		static void put(std::byte* column, std::size_t row, T value) {
+			std::memcpy(column + row * sizeof(T), &value, sizeof(T));
+		}
+
+		static int64_t ns_since_epoch(time_point value) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(value.time_since_epoch()).count();
+		}
+
+		template <typename Source>
+		static bool deltas_fit_in_32_bits(const Source& src, std::size_t first, std::size_t count, unsigned column) {
+			for (std::size_t row = first + 1; row < first + count; ++row) {
+				int64_t delta = ns_since_epoch(src.template get<time_point>(row, column))
+					- ns_since_epoch(src.template get<time_point>(row - 1, column));
+				if (delta < std::numeric_limits<int32_t>::min() || delta > std::numeric_limits<int32_t>::max()) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::vector<column_type> types;
+	};
+
+	/**
+	 * @brief Read-only view of one block in a columnar log.
+	 */
+	class block_view {
+	public:
+		block_view(const std::vector<column_type>& types_, const std::byte* data_)
+			: types{types_}
+			, data{data_}
+		{
+			std::memcpy(&header, data, sizeof(header));
+			std::size_t offset = align8(sizeof(block_header) + types.size());
+			for (unsigned column = 0; column < types.size(); ++column) {
+				uint8_t width = static_cast<uint8_t>(data[sizeof(block_header) + column]);
+				if (types[column] == column_type::time_point_ns) {
+					offset += sizeof(int64_t);
+				}
+				columns.emplace_back(offset, width);
+				offset += align8(width * header.rows);
+				if (offset > header.size) {
+					throw std::runtime_error{"Corrupt block in columnar log"};
+				}
+			}
+		}
+
+		std::size_t rows() const { return header.rows; }
+		uint32_t tid() const { return header.tid; }
+
+		/**
+		 * @brief Decodes an integer-valued column (u64, boolean, duration_ns, time_point_ns) to int64s.
+		 */
+		std::vector<int64_t> integers(unsigned column) const {
+			std::vector<int64_t> ret (header.rows);
+			const std::byte* col = data + columns[column].first;
+			switch (types[column]) {
+			case column_type::u64:
+			case column_type::duration_ns:
+				std::memcpy(ret.data(), col, ret.size() * sizeof(int64_t));
+				break;
+			case column_type::boolean:
+				for (std::size_t i = 0; i < ret.size(); ++i) {
+					ret[i] = static_cast<int64_t>(col[i] != std::byte{0});
+				}
+				break;
+			case column_type::time_point_ns: {
+				int64_t value;
+				std::memcpy(&value, col - sizeof(int64_t), sizeof(value));
+				for (std::size_t i = 0; i < ret.size(); ++i) {
+					if (columns[column].second == 4) {
+						value += get<int32_t>(col, i);
+					} else {
+						value += get<int64_t>(col, i);
+					}
+					ret[i] = value;
+				}
+				break;
+			}
+			default:
+				throw std::runtime_error{std::string{"Column of type "} + column_type_name(types[column]) + " is not an integer"};
+			}
+			return ret;
+		}
+
+		std::vector<double> doubles(unsigned column) const {
+			if (types[column] != column_type::f64) {
+				throw std::runtime_error{std::string{"Column of type "} + column_type_name(types[column]) + " is not a double"};
+			}
+			std::vector<double> ret (header.rows);
+			std::memcpy(ret.data(), data + columns[column].first, ret.size() * sizeof(double));
+			return ret;
+		}
+
+		std::vector<std::string_view> strings(unsigned column) const {
+			if (types[column] != column_type::string) {
+				throw std::runtime_error{std::string{"Column of type "} + column_type_name(types[column]) + " is not a string"};
+			}
+			std::vector<std::string_view> ret;
+			ret.reserve(header.rows);
+			for (std::size_t i = 0; i < header.rows; ++i) {
+				uint32_t ref[2];
+				std::memcpy(ref, data + columns[column].first + i * sizeof(ref), sizeof(ref));
+				if (std::size_t{ref[0]} + ref[1] > header.size) {
+					throw std::runtime_error{"Corrupt string in columnar log"};
+				}
+				ret.emplace_back(reinterpret_cast<const char*>(data + ref[0]), ref[1]);
+			}
+			return ret;
+		}
+
+	private:
+		template <typename T>
+		static T get(const std::byte* column, std::size_t row) {
+			T ret;
+			std::memcpy(&ret, column + row * sizeof(T), sizeof(T));
+			return ret;
+		}
+
+		const std::vector<column_type>& types;
+		const std::byte* data;
+		block_header header;
+		// (offset of the values, width) for each column
+		std::vector<std::pair<std::size_t, uint8_t>> columns;
+	};
+
+	/**
+	 * @brief A read-only mapping of a whole file, for handing to `reader`.
+	 */
+	class mapped_file {
+	public:
+		explicit mapped_file(const std::string& path) {
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				throw std::runtime_error{"Could not open " + path};
+			}
+			struct stat st;
+			::fstat(fd, &st);
+			size = st.st_size;
+			void* mapped = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+			::close(fd);
+			if (mapped == MAP_FAILED) {
+				throw std::runtime_error{"Could not map " + path};
+			}
+			data = static_cast<const std::byte*>(mapped);
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		~mapped_file() {
+			if (data) {
+				::munmap(const_cast<std::byte*>(data), size);
+			}
+		}
+
+		const std::byte* data = nullptr;
+		std::size_t size = 0;
+	};
+
+	/**
+	 * @brief Parses a whole columnar log held in memory (e.g. a `mapped_file`).
+	 */
+	class reader {
+	public:
+		reader(const std::byte* data_, std::size_t size_)
+			: data{data_}
+			, size{size_}
+		{
+			file_header header;
+			if (size < sizeof(header)) {
+				throw std::runtime_error{"Columnar log is truncated"};
+			}
+			std::memcpy(&header, data, sizeof(header));
+			if (header.magic != FILE_MAGIC || header.version != VERSION) {
+				throw std::runtime_error{"Not a columnar log (or an unsupported version)"};
+			}
+			// Every writer uses the compiled-in layout. Any other (say, extent_bytes == 0, which would
+			// never advance, or a header too small for its own schema) means the file is corrupt.
+			if (header.header_bytes != HEADER_BYTES || header.extent_bytes != EXTENT_BYTES) {
+				throw std::runtime_error{"Columnar log has an unsupported layout"};
+			}
+
+			std::size_t offset = sizeof(header);
+			name = read_string(offset, header.name_size);
+			for (uint32_t column = 0; column < header.column_count; ++column) {
+				column_desc desc;
+				check(offset + sizeof(desc));
+				std::memcpy(&desc, data + offset, sizeof(desc));
+				offset += sizeof(desc);
+				column_names.push_back(read_string(offset, desc.name_size));
+				types.push_back(static_cast<column_type>(desc.type));
+			}
+		}
+
+		const std::string& get_name() const { return name; }
+		const std::vector<std::string>& get_column_names() const { return column_names; }
+		const std::vector<column_type>& get_column_types() const { return types; }
+
+		/**
+		 * @brief Calls @p fn with a `block_view` for every block, extent by extent.
+		 *
+		 * Blocks from different threads are interleaved at extent granularity, so rows are in order
+		 * within a thread but not globally.
+		 */
+		template <typename Fn>
+		void for_each_block(Fn fn) const {
+			for (std::size_t extent = HEADER_BYTES; extent + sizeof(block_header) <= size; extent += EXTENT_BYTES) {
+				std::size_t extent_end = std::min(extent + EXTENT_BYTES, size);
+				std::size_t offset = extent;
+				while (offset + sizeof(block_header) <= extent_end) {
+					block_header header;
+					std::memcpy(&header, data + offset, sizeof(header));
+					if (header.magic != BLOCK_MAGIC) {
+						// The rest of this extent was never written.
+						break;
+					}
+					if (header.size < sizeof(header) || offset + header.size > extent_end) {
+						throw std::runtime_error{"Corrupt block in columnar log " + name};
+					}
+					fn(block_view{types, data + offset});
+					offset += header.size;
+				}
+			}
+		}
+
+	private:
+		void check(std::size_t end) const {
+			if (end > size || end > HEADER_BYTES) {
+				throw std::runtime_error{"Columnar log header is truncated"};
+			}
+		}
+
+		std::string read_string(std::size_t& offset, std::size_t length) const {
+			check(offset + length);
+			std::string ret {reinterpret_cast<const char*>(data + offset), length};
+			offset += length;
+			return ret;
+		}
+
+		const std::byte* data;
+		std::size_t size;
+		std::string name;
+		std::vector<std::string> column_names;
+		std::vector<column_type> types;
+	};
+}
@@ -4,12 +4,22 @@ CXX := clang++-10
 STDCXX ?= c++17
 DBG_FLAGS ?= -Og -g -Wall -Wextra
 OPT_FLAGS ?= -O3 -DNDEBUG -Wall -Wextra
-CPP_FILES ?= $(shell find . -name '*.cpp' -not -name 'plugin.cpp' -not -name 'main.cpp' -not -path '*/tests/*')
+CPP_FILES ?= $(shell find . -name '*.cpp' -not -name 'plugin.cpp' -not -name 'main.cpp' -not -path '*/tests/*' -not -path '*/bench/*')
 CPP_TEST_FILES ?= $(shell find tests/ -name '*.cpp' 2> /dev/null)
+CPP_BENCH_FILES ?= $(shell find bench/ -name '*.cpp' 2> /dev/null)
 HPP_FILES ?= $(shell find -L . -name '*.hpp')
 # I need -L to follow symlinks in common/
 LDFLAGS := -ggdb $(LDFLAGS)
 GTEST_LOC := /opt/ILLIXR/googletest
+# Tests that only compile under C++20 (coroutines) are also built on their own, by CPP20_CXX: the
+# first of $(CXX) and the g++s that has coroutines (g++-10 needs -fcoroutines), or none, which
+# skips them.
+CPP20_TEST_FILES ?= $(shell grep -l '__cpp_impl_coroutine' $(CPP_TEST_FILES) /dev/null 2> /dev/null)
+ifndef CPP20_CXX
+CPP20_CXX := $(shell for cxx in $(CXX) g++ g++-11 g++-10; do for flags in '-std=c++20' '-std=c++20 -fcoroutines'; do \
+	$$cxx $$flags -x c++ -dM -E -include coroutine /dev/null 2> /dev/null | grep -q __cpp_impl_coroutine \
+	&& echo "$$cxx $$flags" && exit; done; done)
+endif
 GTEST_FLAGS := -DGTEST_HAS_PTHREAD=1 -lpthread -DGTEST_HAS_PTHREAD=1 -lpthread -I$(GTEST_LOC)/include -L$(GTEST_LOC)/build/lib -lgtest_main -lpthread -lgtest -lpthread
 
 # In the future, if compilation is slow, we can enable partial compilation of object files with
@@ -43,8 +53,15 @@ ifeq ($(CPP_TEST_FILES),)
 tests/run:
 tests/gdb:
 else
-tests/run: tests/test.exe
+tests/run: tests/test.exe $(if $(CPP20_TEST_FILES),$(if $(CPP20_CXX),tests/test20.exe))
 	./tests/test.exe
+ifneq ($(CPP20_TEST_FILES),)
+ifneq ($(CPP20_CXX),)
+	./tests/test20.exe
+else
+	@echo "Skipping $(CPP20_TEST_FILES): no compiler with C++20 coroutines"
+endif
+endif
 
 tests/gdb: tests/test.exe
 	gdb -q ./tests/test.exe -ex r
@@ -53,12 +70,30 @@ tests/test.exe: $(CPP_TEST_FILES) $(CPP_FILES) $(HPP_FILES)
 	$(CXX) -ggdb -std=$(STDCXX) $(CFLAGS) $(CPPFLAGS) $(DBG_FLAGS) \
 	$(GTEST_FLAGS) -fsanitize=address,undefined -o ./tests/test.exe \
 	$(CPP_TEST_FILES) $(CPP_FILES) $(LDFLAGS)
+
+tests/test20.exe: $(CPP20_TEST_FILES) $(CPP_FILES) $(HPP_FILES)
+	$(CPP20_CXX) -ggdb $(CFLAGS) $(CPPFLAGS) $(DBG_FLAGS) \
+	$(GTEST_FLAGS) -fsanitize=address,undefined -o ./tests/test20.exe \
+	$(CPP20_TEST_FILES) $(CPP_FILES) $(LDFLAGS)
+endif
+
+# Each bench/*.cpp is its own program, built optimized. They print one JSON object per line.
+.PHONY: bench/run
+ifeq ($(CPP_BENCH_FILES),)
+bench/run:
+else
+bench/run: $(CPP_BENCH_FILES:.cpp=.exe)
+	for exe in $^; do ./$$exe || exit 1; done
+
+bench/%.exe: bench/%.cpp $(CPP_FILES) $(HPP_FILES) Makefile
+	$(CXX)        -std=$(STDCXX) $(CFLAGS) $(CPPFLAGS) $(OPT_FLAGS) \
+	-o $@ $< $(CPP_FILES) $(LDFLAGS)
 endif
 
 .PHONY: clean
 clean:
 	touch _target && \
-	$(RM) _target *.so *.exe *.o
+	$(RM) _target *.so *.exe *.o bench/*.exe
 # if *.so and *.o do not exist, rm will still work, because it still receives an operand (target)
 
 .PHONY: deepclean
@@ -0,0 +1,666 @@
+#pragma once
+
+/*
+ * Coroutines need C++20: plugins that use this header set `STDCXX = c++20` in their Makefile, and
+ * need a compiler that implements them (GCC 10 or Clang 14 and later). Elsewhere, this header is
+ * empty, so that everything else still builds as C++17.
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "plugin.hpp"
+#include "executor.hpp"
+#include "metrics.hpp"
+#include "stall_watchdog.hpp"
+#include "switchboard.hpp"
+#include "thread_scheduling.hpp"
+#include "wakeup.hpp"
+
+namespace ILLIXR {
+
+class coroutine_driver;
+
+/*
+ * These get included, but they are functionally 'private'. Hence the double-underscores.
+ */
+struct __coroutine_promise_base {
+	/**
+	 * @brief Hands control back to whoever awaited the task; the plugin's own coroutine has nobody.
+	 */
+	struct final_awaiter {
+		bool await_ready() noexcept { return false; }
+
+		template <typename promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<promise> h) noexcept;
+
+		void await_resume() noexcept { }
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+
+	final_awaiter final_suspend() noexcept { return {}; }
+
+	void unhandled_exception() {
+		exception = std::current_exception();
+	}
+
+	std::coroutine_handle<> continuation;
+	// Only set for the plugin's own coroutine, `run()`.
+	coroutine_driver* driver = nullptr;
+	std::exception_ptr exception;
+};
+
+template <typename T>
+struct __coroutine_promise : __coroutine_promise_base {
+	void return_value(T value_) {
+		value.emplace(std::move(value_));
+	}
+
+	std::optional<T> value;
+};
+
+template <>
+struct __coroutine_promise<void> : __coroutine_promise_base {
+	void return_void() { }
+};
+
+/**
+ * @brief What a coroutine in a `coroutine_plugin` returns: `co_await` it for its result.
+ *
+ * It starts when awaited, and resumes its awaiter when it returns, without going through the
+ * scheduler. An exception thrown in it is rethrown in the awaiter.
+ */
+template <typename T = void>
+class [[nodiscard]] coroutine_task {
+public:
+	struct promise_type : __coroutine_promise<T> {
+		coroutine_task get_return_object() {
+			return coroutine_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+	};
+
+	coroutine_task(coroutine_task&& other) noexcept
+		: _m_handle{std::exchange(other._m_handle, nullptr)}
+	{ }
+
+	coroutine_task& operator=(coroutine_task&& other) noexcept {
+		if (this != &other) {
+			if (_m_handle) {
+				_m_handle.destroy();
+			}
+			_m_handle = std::exchange(other._m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	coroutine_task(const coroutine_task&) = delete;
+	coroutine_task& operator=(const coroutine_task&) = delete;
+
+	/**
+	 * @brief Destroys the coroutine, wherever it is suspended, and any it is awaiting.
+	 */
+	~coroutine_task() {
+		if (_m_handle) {
+			_m_handle.destroy();
+		}
+	}
+
+	auto operator co_await() && noexcept {
+		struct awaiter {
+			std::coroutine_handle<promise_type> h;
+
+			bool await_ready() noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+				h.promise().continuation = awaiting;
+				return h;
+			}
+
+			T await_resume() {
+				if (h.promise().exception) {
+					std::rethrow_exception(h.promise().exception);
+				}
+				if constexpr (!std::is_void_v<T>) {
+					return std::move(*h.promise().value);
+				}
+			}
+		};
+		return awaiter{_m_handle};
+	}
+
+	std::coroutine_handle<promise_type> handle() const {
+		return _m_handle;
+	}
+
+private:
+	explicit coroutine_task(std::coroutine_handle<promise_type> h)
+		: _m_handle{h}
+	{ }
+
+	std::coroutine_handle<promise_type> _m_handle;
+};
+
+/**
+ * @brief Resumes one `coroutine_plugin`'s coroutine when what it waits for happens: on the plugin's
+ * own thread, or as a task on the `executor`.
+ *
+ * Each suspension gets an id, and is `armed` with it until one waker (an event, a timer, or `stop()`)
+ * claims it by swapping it for 0, so that the coroutine is resumed exactly once however many of them
+ * race. Wakers that lose, or come late, do nothing. The coroutine only ever runs inside a `step()`,
+ * and once it is `parked` (finished, or suspended after `stop()`), it is never resumed again.
+ *
+ * It is shared with the executor's tasks and timers, which may outlive the plugin.
+ */
+class coroutine_driver : public std::enable_shared_from_this<coroutine_driver> {
+public:
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	coroutine_driver(std::string name_, histogram& timer_latency_)
+		: name{std::move(name_)}
+		, timer_latency{timer_latency_}
+	{ }
+
+	~coroutine_driver() {
+		if (_m_thread.joinable()) {
+			_m_thread.join();
+		}
+	}
+
+	/**
+	 * @brief Runs @p setup and then @p root, on a thread of its own, or on @p exec if it is not null.
+	 */
+	void start(std::coroutine_handle<> root, std::function<void()> setup, std::shared_ptr<executor> exec,
+			   std::shared_ptr<stall_watchdog::heartbeat> heartbeat) {
+		_m_suspended = root;
+		_m_setup = std::move(setup);
+		_m_exec = std::move(exec);
+		_m_heartbeat = std::move(heartbeat);
+		if (_m_exec) {
+			_m_exec->submit([self = shared_from_this()] {
+				self->first_step();
+			});
+		} else {
+			_m_thread = std::thread{[this] {
+				thread_main();
+			}};
+		}
+	}
+
+	/**
+	 * @brief Resumes the coroutine if it waits, and returns once it is parked at its next suspension
+	 * (or has finished). It can then be destroyed.
+	 */
+	void stop() {
+		_m_terminate.store(true);
+		if (_m_exec) {
+			resume_if_waiting();
+			std::unique_lock lock {_m_lock};
+			_m_parked_cv.wait(lock, [this] {
+				return _m_parked.load() && _m_steps.load() == 0;
+			});
+		} else if (_m_thread.joinable()) {
+			_m_wakeup.notify();
+			_m_thread.join();
+		}
+	}
+
+	bool should_terminate() const {
+		return _m_terminate.load();
+	}
+
+	/**
+	 * @brief Called by an awaiter as @p h suspends; arms a timer for @p until if given.
+	 *
+	 * From here on, the coroutine may be resumed on another thread, so the caller must not touch the
+	 * coroutine's frame (the awaiter included) after this.
+	 *
+	 * @return The id to `wake()` the coroutine with, or 0 if it is stopping and will not be resumed.
+	 */
+	std::uint64_t suspend(std::coroutine_handle<> h, std::optional<time_point> until) {
+		if (_m_terminate.load()) {
+			_m_halted.store(true);
+			return 0;
+		}
+		_m_suspended = h;
+		const std::uint64_t id = ++_m_waits;
+		if (!_m_exec) {
+			// Only read by the plugin's thread, which is this one.
+			_m_timer = until ? std::optional{std::pair{id, *until}} : std::nullopt;
+		}
+		_m_armed.store(id);
+		// stop() sets _m_terminate before it looks for an armed suspension, so one of the two sees the other.
+		if (_m_terminate.load() && disarm(id)) {
+			_m_halted.store(true);
+			return 0;
+		}
+		if (until && _m_exec) {
+			_m_exec->submit_at(*until, [self = shared_from_this(), id, until = *until] {
+				if (self->disarm(id)) {
+					self->timer_latency.record(std::chrono::high_resolution_clock::now() - until);
+					self->step();
+				}
+			});
+		}
+		return id;
+	}
+
+	/**
+	 * @brief Resumes the coroutine, if it is still in suspension @p id. Safe to call from any thread.
+	 */
+	void wake(std::uint64_t id) {
+		if (disarm(id)) {
+			schedule();
+		}
+	}
+
+	/**
+	 * @brief Called as the plugin's own coroutine returns, from inside its last `step()`.
+	 */
+	void finish() {
+		_m_finished.store(true);
+	}
+
+private:
+	bool disarm(std::uint64_t id) {
+		return id && _m_armed.compare_exchange_strong(id, 0);
+	}
+
+	void resume_if_waiting() {
+		wake(_m_armed.load());
+	}
+
+	void schedule() {
+		if (_m_exec) {
+			// Run it next on this thread, if this is one of the pool's: what woke it is cache-hot.
+			_m_exec->submit([self = shared_from_this()] {
+				self->step();
+			});
+		} else {
+			_m_ready.store(true);
+			_m_wakeup.notify();
+		}
+	}
+
+	void first_step() {
+		if (_m_setup) {
+			_m_setup();
+		}
+		if (_m_terminate.load()) {
+			park();
+			return;
+		}
+		step();
+	}
+
+	/**
+	 * @brief Runs the coroutine until it next suspends.
+	 */
+	void step() {
+		++_m_steps;
+		if (_m_heartbeat) {
+			_m_heartbeat->start();
+		}
+		_m_suspended.resume();
+		if (_m_heartbeat) {
+			_m_heartbeat->stop();
+		}
+		const bool done = _m_halted.load() || _m_finished.load();
+		// Another step may have started as soon as the coroutine was armed; stop() waits for both.
+		--_m_steps;
+		if (done) {
+			park();
+		} else if (_m_terminate.load()) {
+			const std::lock_guard lock {_m_lock};
+			_m_parked_cv.notify_all();
+		}
+	}
+
+	void park() {
+		const std::lock_guard lock {_m_lock};
+		_m_parked.store(true);
+		_m_parked_cv.notify_all();
+	}
+
+	void thread_main() {
+		std::cout << "thread," << std::this_thread::get_id() << ",coroutine_plugin," << name << std::endl;
+		thread_scheduling::apply(name);
+		first_step();
+		while (!_m_parked.load()) {
+			// Read before checking, so that a wake-up meanwhile is not missed.
+			const std::uint32_t seen = _m_wakeup.sequence();
+			if (_m_ready.exchange(false)) {
+				step();
+				continue;
+			}
+			if (_m_terminate.load()) {
+				resume_if_waiting();
+			}
+			if (_m_timer && std::chrono::high_resolution_clock::now() >= _m_timer->second) {
+				const auto [id, until] = *_m_timer;
+				_m_timer.reset();
+				if (disarm(id)) {
+					timer_latency.record(std::chrono::high_resolution_clock::now() - until);
+					step();
+				}
+				continue;
+			}
+			_m_wakeup.wait(seen, _m_timer ? std::optional{_m_timer->second} : std::nullopt);
+		}
+	}
+
+	const std::string name;
+	histogram& timer_latency;
+	std::shared_ptr<executor> _m_exec;
+	std::shared_ptr<stall_watchdog::heartbeat> _m_heartbeat;
+	std::function<void()> _m_setup;
+
+	// Written by the coroutine as it suspends; read by whoever disarms it.
+	std::coroutine_handle<> _m_suspended;
+	std::uint64_t _m_waits = 0;
+	std::atomic<std::uint64_t> _m_armed {0};
+	std::atomic<bool> _m_terminate {false};
+	std::atomic<bool> _m_halted {false};
+	std::atomic<bool> _m_finished {false};
+	std::atomic<std::size_t> _m_steps {0};
+
+	std::mutex _m_lock;
+	std::condition_variable _m_parked_cv;
+	std::atomic<bool> _m_parked {false};
+
+	// Only used without the executor.
+	std::thread _m_thread;
+	wakeup _m_wakeup;
+	std::atomic<bool> _m_ready {false};
+	// Only used by the plugin's thread: the id and time of the current suspension's timer.
+	std::optional<std::pair<std::uint64_t, time_point>> _m_timer;
+};
+
+template <typename promise>
+std::coroutine_handle<> __coroutine_promise_base::final_awaiter::await_suspend(std::coroutine_handle<promise> h) noexcept {
+	__coroutine_promise_base& p = h.promise();
+	if (p.continuation) {
+		return p.continuation;
+	}
+	if (p.exception) {
+		// As from a threadloop's iteration, an exception that escapes the plugin ends the program.
+		std::rethrow_exception(p.exception);
+	}
+	if (p.driver) {
+		p.driver->finish();
+	}
+	return std::noop_coroutine();
+}
+
+/**
+ * @brief A plugin written as one coroutine, which waits for events and deadlines with `co_await`.
+ *
+ * A plugin like gldemo waits for vsync, samples a pose, renders and publishes, over and over. As a
+ * `threadloop`, each of those waits is a sleep or a `skip_and_wait` that the loop has to come back
+ * from; here, `run()` says it in order:
+ *
+ * \code{.cpp}
+ * coroutine_plugin::task<> run() override {
+ *     while (!should_terminate()) {
+ *         const pose_type* pose = co_await poses.next();
+ *         co_await sleep_until(next_vsync() - render_time);
+ *         publish(render(*pose));
+ *     }
+ * }
+ * \endcode
+ *
+ * A wait suspends the coroutine rather than the thread. If `ILLIXR_EXECUTOR` names the plugin, it
+ * runs as tasks on the shared executor's threads, one task from each wake-up to the next wait, so
+ * many such plugins share a few threads. Otherwise (or if it sets `own_thread`) it has a thread of
+ * its own, which sleeps on a futex between wake-ups. Either way, the coroutine runs on one thread at
+ * a time, so it needs no locks of its own; but without `own_thread`, it may run on a different
+ * thread after each wait.
+ *
+ * The awaitables are `events<event>::next()`, for a switchboard topic; `sleep_until()` and
+ * `sleep_for()`; and `poll_until()`, which checks a condition (such as a GPU fence) at an interval.
+ * Other coroutines that return `task<T>` can be awaited too. How late each timed wait was resumed is
+ * counted in the `coroutine/<name>/timer_latency` histogram, and with the stall watchdog on, each
+ * run from a wake-up to the next wait counts as an iteration without a budget.
+ *
+ * `stop()` resumes the coroutine if it waits, and destroys it at its next wait, so `run()` should
+ * check `should_terminate()` after each one.
+ */
+class coroutine_plugin : public plugin {
+public:
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	template <typename T = void>
+	using task = coroutine_task<T>;
+
+	coroutine_plugin(std::string name_, phonebook* pb_)
+		: plugin(name_, pb_)
+		, metrics_{pb_->lookup_impl<metrics_registry>()}
+		, _m_driver{std::make_shared<coroutine_driver>(name, metrics_->get_histogram("coroutine/" + name + "/timer_latency"))}
+	{ }
+
+	/**
+	 * @brief Starts `run()`.
+	 */
+	virtual void start() override {
+		plugin::start();
+		_m_root.emplace(run());
+		_m_root->handle().promise().driver = _m_driver.get();
+		std::shared_ptr<executor> exec;
+		if (!own_thread && pb->has_impl<executor>() && pb->lookup_impl<executor>()->runs(name)) {
+			exec = pb->lookup_impl<executor>();
+		}
+		std::shared_ptr<stall_watchdog::heartbeat> heartbeat;
+		if (pb->has_impl<stall_watchdog>()) {
+			heartbeat = pb->lookup_impl<stall_watchdog>()->watch(name, std::chrono::nanoseconds{0});
+		}
+		_m_driver->start(_m_root->handle(), [this] {
+			_p_thread_setup();
+		}, std::move(exec), std::move(heartbeat));
+	}
+
+	/**
+	 * @brief Stops `run()` at its next wait, and destroys it.
+	 */
+	virtual void stop() override {
+		if (!_m_stopped) {
+			_m_stopped = true;
+			if (_m_root) {
+				_m_driver->stop();
+				std::cerr << "Joined " << name << std::endl;
+			}
+			for (const auto& [topic_name, w] : _m_watched) {
+				pb->lookup_impl<switchboard>()->unwatch(topic_name, *w);
+			}
+			_m_root.reset();
+			plugin::stop();
+		} else {
+			std::cerr << "You called stop() on this plugin twice." << std::endl;
+		}
+	}
+
+	virtual ~coroutine_plugin() override {
+		if (_m_root) {
+			std::cerr << "You didn't call stop() before destructing this plugin." << std::endl;
+			abort();
+		}
+	}
+
+	/**
+	 * @brief A switchboard topic that the coroutine can wait on.
+	 *
+	 * Make it a member of the plugin, constructed in its constructor.
+	 */
+	template <typename event>
+	class events {
+	public:
+		events(coroutine_plugin& owner, const std::string& topic_name)
+			: _m_driver{owner._m_driver}
+			, _m_reader{owner.pb->lookup_impl<switchboard>()->subscribe_latest<event>(topic_name)}
+		{
+			_m_listener = [this] {
+				if (const std::uint64_t id = _m_waiting.exchange(0)) {
+					_m_driver->wake(id);
+				}
+			};
+			_m_wakeup.set_listener(&_m_listener);
+			owner.pb->lookup_impl<switchboard>()->watch<event>(topic_name, _m_wakeup);
+			owner._m_watched.emplace_back(topic_name, &_m_wakeup);
+		}
+
+		events(const events&) = delete;
+		events& operator=(const events&) = delete;
+
+		/**
+		 * @brief Waits for an event published after the last one this returned, and returns the
+		 * latest; events published meanwhile are skipped, as with `reader_latest`. Returns nullptr
+		 * if the plugin is stopped first.
+		 */
+		auto next() {
+			return awaiter{*this, std::nullopt};
+		}
+
+		/**
+		 * @brief As `next()`, but gives up at @p until, and then returns nullptr.
+		 */
+		auto next_until(time_point until) {
+			return awaiter{*this, until};
+		}
+
+		/**
+		 * @brief The latest event, without waiting; nullptr if there has been none.
+		 */
+		const event* latest() const {
+			return _m_reader->get_latest_ro();
+		}
+
+	private:
+		struct awaiter {
+			events& stream;
+			std::optional<time_point> until;
+
+			bool await_ready() const {
+				return stream._m_wakeup.sequence() != stream._m_seen
+					|| (until && std::chrono::high_resolution_clock::now() >= *until);
+			}
+
+			void await_suspend(std::coroutine_handle<> h) {
+				// The coroutine (and this awaiter with it) may resume as soon as it is suspended.
+				events* const s = &stream;
+				const std::uint32_t seen = s->_m_seen;
+				const std::uint64_t id = s->_m_driver->suspend(h, until);
+				if (id) {
+					s->_m_waiting.store(id);
+					// An event published before it was waiting for did not wake it; do that now.
+					std::uint64_t expected = id;
+					if (s->_m_wakeup.sequence() != seen && s->_m_waiting.compare_exchange_strong(expected, 0)) {
+						s->_m_driver->wake(id);
+					}
+				}
+			}
+
+			const event* await_resume() {
+				const std::uint32_t sequence = stream._m_wakeup.sequence();
+				if (sequence == stream._m_seen) {
+					return nullptr;
+				}
+				stream._m_seen = sequence;
+				return stream._m_reader->get_latest_ro();
+			}
+		};
+
+		const std::shared_ptr<coroutine_driver> _m_driver;
+		const std::unique_ptr<reader_latest<event>> _m_reader;
+		std::function<void()> _m_listener;
+		wakeup _m_wakeup;
+		// The suspension to wake on the next event, if it waits for one.
+		std::atomic<std::uint64_t> _m_waiting {0};
+		// Only used by the coroutine.
+		std::uint32_t _m_seen = 0;
+	};
+
+protected:
+	const std::shared_ptr<metrics_registry> metrics_;
+
+	/// Whether to keep a thread of its own even when `ILLIXR_EXECUTOR` names this plugin; set in the
+	/// subclass's constructor if the coroutine needs thread-local state (such as a GL context) or
+	/// blocks for long between waits.
+	bool own_thread = false;
+
+	/**
+	 * @brief The plugin's work; it is done when this returns (or the plugin is stopped).
+	 */
+	virtual task<> run() = 0;
+
+	/**
+	 * @brief Gets called before `run()` starts, from the thread it starts on.
+	 */
+	virtual void _p_thread_setup() { }
+
+	/**
+	 * @brief Whether the plugin has been asked to stop; check this after each wait.
+	 */
+	bool should_terminate() const {
+		return _m_driver->should_terminate();
+	}
+
+	/**
+	 * @brief Waits until @p until, or until the plugin is stopped.
+	 */
+	auto sleep_until(time_point until) {
+		struct awaiter {
+			coroutine_driver* driver;
+			time_point until;
+
+			bool await_ready() const {
+				return std::chrono::high_resolution_clock::now() >= until;
+			}
+
+			void await_suspend(std::coroutine_handle<> h) {
+				driver->suspend(h, until);
+			}
+
+			void await_resume() { }
+		};
+		return awaiter{_m_driver.get(), until};
+	}
+
+	auto sleep_for(std::chrono::nanoseconds duration) {
+		return sleep_until(std::chrono::high_resolution_clock::now() + duration);
+	}
+
+	/**
+	 * @brief Waits until @p ready returns true, checking it every @p interval.
+	 *
+	 * For a GPU fence, @p ready can be
+	 * `[sync] { return glClientWaitSync(sync, 0, 0) != GL_TIMEOUT_EXPIRED; }`; that needs the GL
+	 * context to be current, so such a plugin sets `own_thread`.
+	 */
+	task<> poll_until(std::function<bool()> ready, std::chrono::nanoseconds interval) {
+		while (!ready() && !should_terminate()) {
+			co_await sleep_for(interval);
+		}
+	}
+
+private:
+	const std::shared_ptr<coroutine_driver> _m_driver;
+	std::optional<task<>> _m_root;
+	std::vector<std::pair<std::string, wakeup*>> _m_watched;
+	bool _m_stopped = false;
+};
+
+}
+
+#endif
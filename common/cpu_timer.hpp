@@ -1,15 +1,26 @@
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #include <sstream>
 #include <chrono>
 #include <cerrno>
 #include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <functional>
 #include <thread>
+#include <utility>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 /**
  * @brief A C++ translation of [clock_gettime][1]
@@ -43,6 +54,274 @@ thread_cpu_time() {
     return cpp_clock_gettime(CLOCK_THREAD_CPUTIME_ID);
 }
 
+/**
+ * @brief Gets the kernel's id for the calling thread, as shown by `top -H`, `perf` and `gdb`.
+ *
+ * Unlike `std::this_thread::get_id()`, this is a small integer that is stable for the life of the
+ * thread and meaningful outside the process, so records can use it to tell threads apart.
+ */
+static inline std::size_t
+kernel_thread_id() {
+	thread_local const std::size_t tid = static_cast<std::size_t>(::syscall(SYS_gettid));
+	return tid;
+}
+
+/**
+ * @brief A clock for instrumentation timestamps that reads the CPU's time-stamp counter.
+ *
+ * `high_resolution_clock::now()` and `thread_cpu_time()` cost a few hundred nanoseconds together
+ * (the latter is a real system call), which adds up when every threadloop iteration and switchboard
+ * callback takes several. On x86 with an invariant TSC that the kernel also uses as its clocksource,
+ * `now()` is an `rdtsc` and a multiply instead; elsewhere, it reads `CLOCK_MONOTONIC_RAW`, which is
+ * still served from the vDSO without a system call.
+ *
+ * Time points are on `high_resolution_clock`'s epoch, so they can be logged next to and subtracted
+ * from the other wall times in records. The rate is calibrated against `CLOCK_MONOTONIC_RAW`, which
+ * NTP does not adjust, while `high_resolution_clock` is the system clock that it does (by up to
+ * 500 ppm). So every 100 ms, `now()` compares itself with `high_resolution_clock` again and adjusts
+ * its rate to close the gap over the next 100 ms, which keeps it continuous and within the drift of
+ * 200 ms of it: up to 100 us at NTP's limit, and a microsecond or so with the usual few ppm. A gap
+ * over a millisecond (the system clock was set) is closed at once. Deadlines and sleeps stay on
+ * `high_resolution_clock`.
+ *
+ * The runtime calibrates it with `export_calibration()` before it starts any thread, and passes the
+ * calibration to the plugins (which each get their own copy of this code) in
+ * `ILLIXR_TSC_CALIBRATION`, so that all timestamps in a run agree. Set that to `off` to always use
+ * `CLOCK_MONOTONIC_RAW`.
+ */
+class tsc_clock {
+public:
+	using duration = std::chrono::nanoseconds;
+	using rep = duration::rep;
+	using period = duration::period;
+	using time_point = std::chrono::high_resolution_clock::time_point;
+	static constexpr bool is_steady = false;
+
+	static time_point now() {
+		clock_state& s = get();
+		const std::uint64_t ticks = read(s.tsc);
+		const anchor a = s.load();
+		if (ticks > a.base_ticks && ticks - a.base_ticks >= s.reanchor_ticks) {
+			s.reanchor(a);
+		}
+		return time_point{std::chrono::duration_cast<time_point::duration>(duration{from_ticks(a, ticks)})};
+	}
+
+	/**
+	 * @brief Whether `now()` reads the time-stamp counter, rather than `CLOCK_MONOTONIC_RAW`.
+	 */
+	static bool uses_tsc() {
+		return get().tsc;
+	}
+
+	/**
+	 * @brief Calibrates the clock, if it is not yet, and sets `ILLIXR_TSC_CALIBRATION` for the
+	 * plugins loaded later. `setenv` is not thread-safe, so call this before starting any thread.
+	 */
+	static void export_calibration() {
+		const clock_state& s = get();
+		const anchor a = s.load();
+		const std::string value = std::to_string(s.tsc) + "," + std::to_string(a.base_ticks) + "," + std::to_string(a.base_ns) + "," + std::to_string(s.rate);
+		setenv(env_var, value.c_str(), false);
+	}
+
+private:
+	// Maps ticks to nanoseconds on high_resolution_clock's epoch, around a reading.
+	struct anchor {
+		// A reading of the counter, and what it stands for on high_resolution_clock, in nanoseconds.
+		std::uint64_t base_ticks;
+		std::int64_t base_ns;
+		// Nanoseconds per tick, in 32.32 fixed point.
+		std::uint64_t mult;
+	};
+
+	struct calibration {
+		bool tsc;
+		anchor first;
+	};
+
+	static constexpr const char* env_var = "ILLIXR_TSC_CALIBRATION";
+	static constexpr std::int64_t reanchor_ns = 100'000'000;
+	static constexpr std::int64_t max_slew_ns = 1'000'000;
+
+	/**
+	 * @brief The calibrated rate, and the current anchor, which `now()` reads without a lock (as a seqlock).
+	 */
+	class clock_state {
+	public:
+		explicit clock_state(const calibration& c)
+			: tsc{c.tsc}
+			, rate{c.first.mult}
+			, reanchor_ticks{static_cast<std::uint64_t>((static_cast<unsigned __int128>(reanchor_ns) << 32) / c.first.mult)}
+		{
+			store(c.first);
+		}
+
+		anchor load() const noexcept {
+			while (true) {
+				const std::uint32_t before = seq.load(std::memory_order_acquire);
+				const anchor a {base_ticks.load(std::memory_order_relaxed), base_ns.load(std::memory_order_relaxed), mult.load(std::memory_order_relaxed)};
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (!(before & 1) && seq.load(std::memory_order_relaxed) == before) {
+					return a;
+				}
+			}
+		}
+
+		/**
+		 * @brief Compares with `high_resolution_clock` and sets a rate that closes the gap over the
+		 * next `reanchor_ns`, unless another thread is already doing so.
+		 */
+		void reanchor(const anchor& old) noexcept {
+			if (updating.exchange(true, std::memory_order_acquire)) {
+				return;
+			}
+			// Unless another thread has re-anchored since this one read @p old.
+			if (load().base_ticks == old.base_ticks) {
+				const auto [ticks, ns] = sample(tsc, hrc_ns);
+				const std::int64_t mapped = from_ticks(old, ticks);
+				const std::int64_t gap = ns - mapped;
+				if (gap > max_slew_ns || gap < -max_slew_ns) {
+					store(anchor{ticks, ns, rate});
+				} else {
+					const std::int64_t correction = static_cast<std::int64_t>((static_cast<__int128>(rate) * gap) / reanchor_ns);
+					store(anchor{ticks, mapped, static_cast<std::uint64_t>(static_cast<std::int64_t>(rate) + correction)});
+				}
+			}
+			updating.store(false, std::memory_order_release);
+		}
+
+		const bool tsc;
+		// The calibrated nanoseconds per tick, in 32.32 fixed point, which each anchor adjusts.
+		const std::uint64_t rate;
+		const std::uint64_t reanchor_ticks;
+
+	private:
+		void store(const anchor& a) noexcept {
+			const std::uint32_t before = seq.load(std::memory_order_relaxed);
+			seq.store(before + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			base_ticks.store(a.base_ticks, std::memory_order_relaxed);
+			base_ns.store(a.base_ns, std::memory_order_relaxed);
+			mult.store(a.mult, std::memory_order_relaxed);
+			seq.store(before + 2, std::memory_order_release);
+		}
+
+		std::atomic<std::uint32_t> seq {0};
+		std::atomic<std::uint64_t> base_ticks {0};
+		std::atomic<std::int64_t> base_ns {0};
+		std::atomic<std::uint64_t> mult {0};
+		// Held by the thread re-anchoring, which is the only one to store.
+		std::atomic<bool> updating {false};
+	};
+
+	static std::uint64_t monotonic_raw_ns() {
+		return static_cast<std::uint64_t>(cpp_clock_gettime(CLOCK_MONOTONIC_RAW).count());
+	}
+
+	static std::int64_t hrc_ns() noexcept {
+		return static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now().time_since_epoch()).count());
+	}
+
+	static std::uint64_t read(bool tsc) noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+		if (tsc) {
+			asm volatile ("" : : : "memory");
+			const std::uint64_t ticks = __rdtsc();
+			asm volatile ("" : : : "memory");
+			return ticks;
+		}
+#endif
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+		return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u + static_cast<std::uint64_t>(ts.tv_nsec);
+	}
+
+	static std::int64_t from_ticks(const anchor& a, std::uint64_t ticks) noexcept {
+		const std::int64_t delta = ticks >= a.base_ticks
+			?   static_cast<std::int64_t>((static_cast<unsigned __int128>(ticks - a.base_ticks) * a.mult) >> 32)
+			: -static_cast<std::int64_t>((static_cast<unsigned __int128>(a.base_ticks - ticks) * a.mult) >> 32);
+		return a.base_ns + delta;
+	}
+
+	static bool has_invariant_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+			return false;
+		}
+		// The kernel only keeps the TSC as its clocksource if it is in sync across cores. Without
+		// that confirmation (e.g. no sysfs in a container), the TSC is not trusted.
+		const char* const path = "/sys/devices/system/clocksource/clocksource0/current_clocksource";
+		std::ifstream clocksource {path};
+		std::string name;
+		if (!(clocksource >> name)) {
+			std::cerr << "cpu_timer: cannot read " << path << ", so using CLOCK_MONOTONIC_RAW rather than the TSC" << std::endl;
+			return false;
+		}
+		return name == "tsc";
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * @brief Reads the counter and @p ns_clock as close together as it can: the pair from the
+	 * quickest of a few tries, with the counter's reading from the middle.
+	 */
+	template <typename ns_fn>
+	static std::pair<std::uint64_t, std::int64_t> sample(bool tsc, ns_fn ns_clock) noexcept {
+		std::uint64_t best_span = UINT64_MAX;
+		std::pair<std::uint64_t, std::int64_t> best;
+		for (int i = 0; i < 5; ++i) {
+			const std::uint64_t before = read(tsc);
+			const std::int64_t ns = ns_clock();
+			const std::uint64_t after = read(tsc);
+			if (after - before < best_span) {
+				best_span = after - before;
+				best = {before + (after - before) / 2, ns};
+			}
+		}
+		return best;
+	}
+
+	static calibration calibrate() {
+		const char* shared = std::getenv(env_var);
+		if (shared && std::strcmp(shared, "off") == 0) {
+			return measure(false);
+		}
+		if (shared && *shared) {
+			int tsc;
+			unsigned long long base_ticks, mult;
+			long long base_ns;
+			if (std::sscanf(shared, "%d,%llu,%lld,%llu", &tsc, &base_ticks, &base_ns, &mult) == 4 && mult) {
+				return calibration{tsc != 0, anchor{base_ticks, base_ns, mult}};
+			}
+			std::cerr << "Ignoring " << env_var << "=" << shared << std::endl;
+		}
+		return measure(has_invariant_tsc());
+	}
+
+	static calibration measure(bool tsc) {
+		const auto raw = [] { return static_cast<std::int64_t>(monotonic_raw_ns()); };
+		std::uint64_t mult = std::uint64_t{1} << 32;
+		if (tsc) {
+			const auto start = sample(tsc, raw);
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			const auto stop = sample(tsc, raw);
+			mult = static_cast<std::uint64_t>((static_cast<unsigned __int128>(stop.second - start.second) << 32) / (stop.first - start.first));
+		}
+		const auto base = sample(tsc, hrc_ns);
+		return calibration{tsc, anchor{base.first, base.second, mult}};
+	}
+
+	static clock_state& get() {
+		static clock_state s {calibrate()};
+		return s;
+	}
+};
+
 /**
  * @brief a timer that times until the end of the code block ([RAII]).
  *
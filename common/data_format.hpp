@@ -72,6 +72,7 @@ namespace ILLIXR {
 		GLuint texture_handle;
 		pose_type render_pose; // The pose used when rendering this frame.
 		std::chrono::time_point<std::chrono::system_clock> sample_time;
+		std::chrono::time_point<std::chrono::system_clock> render_time;
 	};
 
 	// Using arrays as a swapchain
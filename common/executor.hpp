@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include "phonebook.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief A fixed pool of threads shared by components that would otherwise each start their own.
+ *
+ * On a machine with few cores, a thread per plugin (plus switchboard's and the loggers') means
+ * constant context switches and cold caches. Components named in `ILLIXR_EXECUTOR` run as tasks on
+ * this pool instead: a threadloop becomes a task that runs one iteration and requeues itself, and
+ * switchboard runs each topic's callbacks as a task. The runtime always provides this service; with
+ * nothing named, it starts no threads and `runs()` is always false.
+ */
+class executor : public phonebook::service {
+public:
+	using task = std::function<void()>;
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	/**
+	 * @brief Whether the component called @p name (a threadloop's plugin name, or `switchboard`)
+	 * should run its work here rather than on a thread of its own.
+	 */
+	virtual bool runs(const std::string& name) const = 0;
+
+	/**
+	 * @brief Runs @p t soon, on one of the pool's threads.
+	 *
+	 * From a pool thread, the task goes on that thread's own queue, where it is likely to run next and
+	 * on the same core (work it spawned is cache-hot); idle threads steal from the other end.
+	 * Safe to call from any thread.
+	 */
+	virtual void submit(task t) = 0;
+
+	/**
+	 * @brief Runs @p t after the tasks already waiting; for recurring tasks, so they take turns.
+	 */
+	virtual void defer(task t) = 0;
+
+	/**
+	 * @brief Runs @p t no earlier than @p when.
+	 */
+	virtual void submit_at(time_point when, task t) = 0;
+
+	/**
+	 * @brief Joins the pool's threads. Tasks still waiting are dropped, and later ones are ignored.
+	 */
+	virtual void stop() = 0;
+
+	virtual ~executor() { }
+};
+
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "phonebook.hpp"
+#include "record_logger.hpp"
+#include "thread_scheduling.hpp"
+
+namespace ILLIXR {
+
+	/**
+	 * @brief A fixed-size, lock-free histogram of nanosecond durations, in the style of HdrHistogram.
+	 *
+	 * Values below 2^sub_bucket_bits are counted exactly. Above that, each power of two is split
+	 * into 2^(sub_bucket_bits - 1) equal buckets, so every bucket is within 1/32 (about 3%) of the
+	 * values it holds. Values above max_value are counted as max_value.
+	 *
+	 * `record` is a few relaxed atomic adds, and never allocates, so it can sit on the hot path of
+	 * any thread. `take` reads and zeroes the counts, so each call sees what was recorded since the
+	 * last one; a value recorded concurrently with `take` lands in one interval or the next.
+	 */
+	class histogram {
+	public:
+		static constexpr unsigned sub_bucket_bits = 6;
+		static constexpr unsigned max_value_bits = 40;
+		static constexpr std::uint64_t max_value = (std::uint64_t{1} << max_value_bits) - 1;
+		static constexpr std::size_t half_sub_buckets = std::size_t{1} << (sub_bucket_bits - 1);
+		static constexpr std::size_t buckets = (max_value_bits - sub_bucket_bits + 2) * half_sub_buckets;
+
+		/**
+		 * @brief The counts of one interval, as returned by `take`.
+		 */
+		struct snapshot {
+			std::array<std::uint64_t, buckets> counts {};
+			std::uint64_t count = 0;
+			std::uint64_t sum = 0;
+			std::uint64_t max = 0;
+
+			/**
+			 * @brief The value at quantile @p q (0 <= q <= 1), rounded up to its bucket's upper bound.
+			 */
+			std::uint64_t quantile(double q) const {
+				if (count == 0) {
+					return 0;
+				}
+				const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * count + 0.5));
+				std::uint64_t seen = 0;
+				for (std::size_t i = 0; i < buckets; ++i) {
+					seen += counts[i];
+					if (seen >= rank) {
+						return std::min(highest_equivalent(i), max);
+					}
+				}
+				return max;
+			}
+
+			std::uint64_t mean() const {
+				return count ? sum / count : 0;
+			}
+		};
+
+		void record(std::uint64_t value) {
+			value = std::min(value, max_value);
+			_m_counts[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+			_m_sum.fetch_add(value, std::memory_order_relaxed);
+			std::uint64_t max = _m_max.load(std::memory_order_relaxed);
+			while (value > max && !_m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+		}
+
+		void record(std::chrono::nanoseconds value) {
+			record(static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(value.count(), 0)));
+		}
+
+		/**
+		 * @brief Returns the counts since the last call, and resets them.
+		 */
+		void take(snapshot& out) {
+			out.count = 0;
+			for (std::size_t i = 0; i < buckets; ++i) {
+				out.counts[i] = _m_counts[i].exchange(0, std::memory_order_relaxed);
+				out.count += out.counts[i];
+			}
+			out.sum = _m_sum.exchange(0, std::memory_order_relaxed);
+			out.max = _m_max.exchange(0, std::memory_order_relaxed);
+		}
+
+		static std::size_t index_of(std::uint64_t value) {
+			if (value < 2 * half_sub_buckets) {
+				return value;
+			}
+			const unsigned msb = 63 - __builtin_clzll(value);
+			const unsigned shift = msb - (sub_bucket_bits - 1);
+			return shift * half_sub_buckets + (value >> shift);
+		}
+
+		/**
+		 * @brief The largest value that `index_of` maps to @p index.
+		 */
+		static std::uint64_t highest_equivalent(std::size_t index) {
+			if (index < 2 * half_sub_buckets) {
+				return index;
+			}
+			const unsigned shift = index / half_sub_buckets - 1;
+			const std::uint64_t mantissa = index - shift * half_sub_buckets;
+			return ((mantissa + 1) << shift) - 1;
+		}
+
+	private:
+		std::array<std::atomic<std::uint64_t>, buckets> _m_counts {};
+		std::atomic<std::uint64_t> _m_sum {0};
+		std::atomic<std::uint64_t> _m_max {0};
+	};
+
+	/**
+	 * @brief The current value of some quantity, such as a queue depth.
+	 *
+	 * `set` is a relaxed atomic store; readers (the metrics endpoint) see the latest value.
+	 */
+	class gauge {
+	public:
+		void set(double value) {
+			_m_value.store(value, std::memory_order_relaxed);
+		}
+
+		double get() const {
+			return _m_value.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<double> _m_value {0};
+	};
+
+	/*
+	 * This gets included, but it is functionally 'private'. Hence the double-underscores.
+	 */
+	const record_header __metrics_histogram_header {"metrics_histogram", {
+		{"histogram_id", typeid(std::size_t)},
+		{"histogram_name", typeid(std::string)},
+	}, record_verbosity::essential};
+
+	// Inline, so that metrics_registry (whose methods are inline too) logs the same header in every
+	// translation unit.
+	inline const record_type<
+		std::size_t,
+		std::chrono::high_resolution_clock::time_point,
+		std::size_t,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds
+	> __metrics_summary_header {"metrics_summary", {
+		"histogram_id",
+		"wall_time",
+		"count",
+		"mean",
+		"p50",
+		"p90",
+		"p99",
+		"p999",
+		"max",
+	}};
+
+	/**
+	 * @brief Named histograms, summarized through the record_logger once per period.
+	 *
+	 * Components get their histograms once, at setup (`get_histogram` allocates and locks), and
+	 * then `record` into them freely. Every period, a background thread writes one
+	 * `metrics_summary` row (count, mean, p50/p90/p99/p99.9, max) per histogram that saw any values,
+	 * and `metrics_histogram` maps each histogram_id to its name.
+	 *
+	 * With summaries available, the per-event rows (`threadloop_iteration`, `switchboard_callback`,
+	 * `switchboard_check_queues`) are often unnecessary; set `ILLIXR_METRICS_RAW_ROWS=0` to have
+	 * their producers skip them (see `raw_rows`).
+	 *
+	 * The registry also keeps every histogram's totals since startup, and named gauges, for
+	 * `write_prometheus`.
+	 */
+	class metrics_registry : public phonebook::service {
+	public:
+		metrics_registry(std::shared_ptr<record_logger> logger_, std::chrono::milliseconds period_ = std::chrono::seconds{1})
+			: logger{std::move(logger_)}
+			, period{period_}
+			, _m_raw_rows{raw_rows_from_env()}
+			, summaries{logger, __metrics_summary_header}
+			, reporter{[this] { report_periodically(); }}
+		{ }
+
+		metrics_registry(const metrics_registry&) = delete;
+		metrics_registry& operator=(const metrics_registry&) = delete;
+
+		virtual ~metrics_registry() override {
+			{
+				const std::lock_guard lock{_m_terminate_lock};
+				terminate = true;
+			}
+			_m_terminate_cv.notify_all();
+			reporter.join();
+			// The last partial period.
+			report();
+		}
+
+		/**
+		 * @brief Returns the histogram called @p name, creating it if necessary.
+		 *
+		 * Call this at setup; the returned reference is valid for the life of the registry.
+		 */
+		histogram& get_histogram(const std::string& name) {
+			const std::lock_guard lock{_m_histograms_lock};
+			for (const auto& entry : histograms) {
+				if (entry->name == name) {
+					return entry->hist;
+				}
+			}
+			histograms.push_back(std::make_unique<named_histogram>(histograms.size(), name));
+			if (__metrics_histogram_header.should_log()) {
+				logger->log(record{__metrics_histogram_header, {
+					{histograms.back()->id},
+					{name},
+				}});
+			}
+			return histograms.back()->hist;
+		}
+
+		/**
+		 * @brief Returns the gauge called @p name, creating it if necessary.
+		 *
+		 * Like `get_histogram`, call this at setup; the returned reference is valid for the life of
+		 * the registry.
+		 */
+		gauge& get_gauge(const std::string& name) {
+			const std::lock_guard lock{_m_histograms_lock};
+			for (const auto& entry : gauges) {
+				if (entry.first == name) {
+					return *entry.second;
+				}
+			}
+			gauges.emplace_back(name, std::make_unique<gauge>());
+			return *gauges.back().second;
+		}
+
+		/**
+		 * @brief Whether producers should also log their raw per-event rows.
+		 */
+		bool raw_rows() const {
+			return _m_raw_rows;
+		}
+
+		/**
+		 * @brief Writes a summary of every histogram's values since the last report.
+		 */
+		void report() {
+			const std::lock_guard lock{_m_histograms_lock};
+			const auto now = std::chrono::high_resolution_clock::now();
+			for (const auto& entry : histograms) {
+				report(*entry, now);
+			}
+			summaries.flush();
+		}
+
+		/**
+		 * @brief Returns everything the histogram called @p name has recorded since startup.
+		 *
+		 * Values not yet reported are summarized first, so this is up to date; meant for
+		 * end-of-run summaries. Returns an empty snapshot for an unknown name.
+		 */
+		histogram::snapshot totals(const std::string& name) {
+			const std::lock_guard lock{_m_histograms_lock};
+			for (const auto& entry : histograms) {
+				if (entry->name == name) {
+					report(*entry, std::chrono::high_resolution_clock::now());
+					summaries.flush();
+					return entry->total;
+				}
+			}
+			return histogram::snapshot{};
+		}
+
+		/**
+		 * @brief Writes the histograms and gauges to @p out in the Prometheus text format.
+		 *
+		 * Histograms become one `illixr_duration_seconds` summary: `_count` and `_sum` are totals
+		 * since startup, and the quantiles are those of the last period that saw any values. Both
+		 * are as of the last `report`, so this never touches the histograms themselves.
+		 */
+		void write_prometheus(std::ostream& out) {
+			const std::lock_guard lock{_m_histograms_lock};
+			out << "# HELP illixr_duration_seconds Durations recorded by ILLIXR components.\n"
+				<< "# TYPE illixr_duration_seconds summary\n";
+			for (const auto& entry : histograms) {
+				if (entry->total.count) {
+					const std::string name = prometheus_label(entry->name);
+					for (double q : {0.5, 0.9, 0.99, 0.999}) {
+						out << "illixr_duration_seconds{name=\"" << name << "\",quantile=\"" << q << "\"} "
+							<< entry->last.quantile(q) * 1e-9 << "\n";
+					}
+					out << "illixr_duration_seconds_sum{name=\"" << name << "\"} " << entry->total.sum * 1e-9 << "\n"
+						<< "illixr_duration_seconds_count{name=\"" << name << "\"} " << entry->total.count << "\n";
+				}
+			}
+			out << "# HELP illixr_duration_max_seconds Largest duration recorded since startup.\n"
+				<< "# TYPE illixr_duration_max_seconds gauge\n";
+			for (const auto& entry : histograms) {
+				if (entry->total.count) {
+					out << "illixr_duration_max_seconds{name=\"" << prometheus_label(entry->name) << "\"} "
+						<< entry->total.max * 1e-9 << "\n";
+				}
+			}
+			out << "# HELP illixr_gauge Current values reported by ILLIXR components.\n"
+				<< "# TYPE illixr_gauge gauge\n";
+			for (const auto& entry : gauges) {
+				out << "illixr_gauge{name=\"" << prometheus_label(entry.first) << "\"} " << entry.second->get() << "\n";
+			}
+		}
+
+	private:
+		struct named_histogram {
+			named_histogram(std::size_t id_, std::string name_)
+				: id{id_}
+				, name{std::move(name_)}
+			{ }
+
+			const std::size_t id;
+			const std::string name;
+			histogram hist;
+			// Since startup, and the last non-empty period; both guarded by _m_histograms_lock.
+			histogram::snapshot total;
+			histogram::snapshot last;
+
+			void add_to_total(const histogram::snapshot& period) {
+				for (std::size_t i = 0; i < histogram::buckets; ++i) {
+					total.counts[i] += period.counts[i];
+				}
+				total.count += period.count;
+				total.sum += period.sum;
+				total.max = std::max(total.max, period.max);
+				last = period;
+			}
+		};
+
+		/**
+		 * @brief Summarizes what @p entry recorded since it was last reported. Needs _m_histograms_lock.
+		 */
+		void report(named_histogram& entry, std::chrono::high_resolution_clock::time_point now) {
+			entry.hist.take(scratch);
+			if (scratch.count) {
+				entry.add_to_total(scratch);
+				summaries.log(
+					entry.id,
+					now,
+					scratch.count,
+					std::chrono::nanoseconds{scratch.mean()},
+					std::chrono::nanoseconds{scratch.quantile(0.5)},
+					std::chrono::nanoseconds{scratch.quantile(0.9)},
+					std::chrono::nanoseconds{scratch.quantile(0.99)},
+					std::chrono::nanoseconds{scratch.quantile(0.999)},
+					std::chrono::nanoseconds{scratch.max}
+				);
+			}
+		}
+
+		static std::string prometheus_label(const std::string& value) {
+			std::string ret;
+			for (char c : value) {
+				if (c == '\\' || c == '"') {
+					ret += '\\';
+					ret += c;
+				} else if (c == '\n') {
+					ret += "\\n";
+				} else {
+					ret += c;
+				}
+			}
+			return ret;
+		}
+
+		static bool raw_rows_from_env() {
+			const char* raw_rows = std::getenv("ILLIXR_METRICS_RAW_ROWS");
+			return !raw_rows || std::string{raw_rows} != "0";
+		}
+
+		void report_periodically() {
+			thread_scheduling::apply("metrics");
+			std::unique_lock lock{_m_terminate_lock};
+			while (!_m_terminate_cv.wait_for(lock, period, [this] { return terminate; })) {
+				lock.unlock();
+				report();
+				lock.lock();
+			}
+		}
+
+		const std::shared_ptr<record_logger> logger;
+		const std::chrono::milliseconds period;
+		const bool _m_raw_rows;
+		std::vector<std::unique_ptr<named_histogram>> histograms;
+		// Also guarded by _m_histograms_lock.
+		std::vector<std::pair<std::string, std::unique_ptr<gauge>>> gauges;
+		std::mutex _m_histograms_lock;
+		// Guarded by _m_histograms_lock, like the histograms it reads.
+		histogram::snapshot scratch;
+		decltype(__metrics_summary_header)::coalescer summaries;
+		bool terminate = false;
+		std::mutex _m_terminate_lock;
+		std::condition_variable _m_terminate_cv;
+		std::thread reporter;
+	};
+
+}
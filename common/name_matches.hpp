@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+namespace ILLIXR {
+
+/**
+ * @brief Whether @p name matches @p pattern: equal, or starting with it if it ends in `*`.
+ *
+ * The patterns that pick tables (`ILLIXR_RECORD_*`), threads (`ILLIXR_THREAD_SCHEDULING`) and
+ * components (`ILLIXR_EXECUTOR`) by name all mean this.
+ */
+static inline bool name_matches(const std::string& pattern, const std::string& name) {
+	if (!pattern.empty() && pattern.back() == '*') {
+		return name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+	}
+	return name == pattern;
+}
+
+}
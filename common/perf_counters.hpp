@@ -0,0 +1,278 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ILLIXR {
+
+/**
+ * @brief Hardware performance counters for the calling thread, from `perf_event_open`.
+ *
+ * Wall and CPU time say that an iteration was slow, not why; these say whether it ran more
+ * instructions, ran them slower (cycles per instruction), missed the last-level cache or mispredicted
+ * branches, or was switched out. Set `ILLIXR_PERF_COUNTERS=1` to have threadloops and switchboard
+ * log them, as the difference over each iteration and callback, in extra columns of
+ * `threadloop_iteration` and `switchboard_callback` (which are 0 otherwise).
+ *
+ * Each counter is mapped into memory and read without a system call: software counters from the
+ * page the kernel updates when the thread is scheduled in, and hardware ones on x86 with the
+ * `rdpmc` instruction, where the kernel allows it (`rdpmc` in /sys/bus/event_source/devices/cpu).
+ * Elsewhere, hardware counters take a `read`.
+ *
+ * The hardware counters are one group, led by cycles, so the PMU always counts them together and
+ * ratios such as instructions per cycle hold. When the group had to share the PMU with other events
+ * (multiplexing), `difference` scales its counts by how long it was enabled over how long it
+ * actually counted, as `perf stat` does, and zeroes them if it did not count at all.
+ *
+ * Counters the kernel refuses (no PMU, as in most VMs, or `perf_event_paranoid` forbids it) read 0;
+ * the first refusal of each is reported on stderr, and is never fatal.
+ */
+class perf_counters {
+public:
+	enum counter : std::size_t {
+		cycles,
+		instructions,
+		llc_misses,
+		branch_misses,
+		context_switches,
+		count,
+	};
+
+	/// After the counters, how long the hardware group was enabled, and how long it counted (in ns).
+	static constexpr std::size_t time_enabled = count;
+	static constexpr std::size_t time_running = count + 1;
+
+	using values = std::array<std::uint64_t, count + 2>;
+
+	/**
+	 * @brief Whether `ILLIXR_PERF_COUNTERS` asks for counters; if not, nothing should read them.
+	 */
+	static bool enabled() {
+		static const bool on = [] {
+			const char* env = std::getenv("ILLIXR_PERF_COUNTERS");
+			return env && *env && std::string{env} != "0";
+		}();
+		return on;
+	}
+
+	/**
+	 * @brief The calling thread's counters, opened on first use.
+	 */
+	static perf_counters& this_thread() {
+		static thread_local perf_counters counters;
+		return counters;
+	}
+
+	/**
+	 * @brief The counts since they were opened; 0 for counters that are not available.
+	 */
+	values read() const {
+		values v {};
+		for (std::size_t i = 0; i < count; ++i) {
+			// The group's times come with its leader's count.
+			std::uint64_t* const times = i == leader ? &v[time_enabled] : nullptr;
+			if (pages[i] && read_page(*pages[i], v[i], times)) {
+				continue;
+			}
+			if (fds[i] >= 0) {
+				// Hardware counters also give the group's times (see read_format).
+				std::uint64_t value[3] = {};
+				const ssize_t size = is_hardware(i) ? sizeof(value) : sizeof(value[0]);
+				if (::read(fds[i], value, size) == size) {
+					v[i] = value[0];
+					if (times) {
+						times[0] = value[1];
+						times[1] = value[2];
+					}
+				}
+			}
+		}
+		return v;
+	}
+
+	/**
+	 * @brief The counts from @p start to @p stop, scaled up if the hardware group was multiplexed.
+	 */
+	static values difference(const values& start, const values& stop) {
+		values v;
+		for (std::size_t i = 0; i < v.size(); ++i) {
+			v[i] = stop[i] - start[i];
+		}
+		const std::uint64_t enabled = v[time_enabled];
+		const std::uint64_t running = v[time_running];
+		if (running != enabled) {
+			for (std::size_t i = 0; i < count; ++i) {
+				if (is_hardware(i)) {
+					v[i] = running ? static_cast<std::uint64_t>(static_cast<unsigned __int128>(v[i]) * enabled / running) : 0;
+				}
+			}
+		}
+		return v;
+	}
+
+	/**
+	 * @brief Whether counter @p c could be opened; if not, it reads 0.
+	 */
+	bool available(counter c) const {
+		return fds[c] >= 0;
+	}
+
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+
+	~perf_counters() {
+		for (std::size_t i = 0; i < count; ++i) {
+			if (pages[i]) {
+				munmap(const_cast<perf_event_mmap_page*>(pages[i]), page_size());
+			}
+			if (fds[i] >= 0) {
+				close(fds[i]);
+			}
+		}
+	}
+
+private:
+	perf_counters() {
+		static constexpr std::array<const char*, count> names {
+			"cycles", "instructions", "llc_misses", "branch_misses", "context_switches",
+		};
+		fds.fill(-1);
+		pages.fill(nullptr);
+		for (std::size_t i = 0; i < count; ++i) {
+			perf_event_attr attr {};
+			attr.size = sizeof(attr);
+			attr.type = events[i].first;
+			attr.config = events[i].second;
+			// The hardware counters join their leader's group, so they are scheduled together; without
+			// a leader, they are not counted at all, rather than each at different times.
+			int group = -1;
+			if (is_hardware(i)) {
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				if (i != leader) {
+					group = fds[leader];
+					if (group < 0) {
+						report_once(i, names[i], "its group's leader, cycles, cannot be counted");
+						continue;
+					}
+				}
+			}
+			// Counts in the kernel too, if allowed. Context switches happen there, so they need it;
+			// the others can do without.
+			fds[i] = open(attr, group);
+			if (fds[i] < 0 && errno == EACCES && is_hardware(i)) {
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				fds[i] = open(attr, group);
+			}
+			if (fds[i] < 0) {
+				report_once(i, names[i]);
+				continue;
+			}
+			void* page = mmap(nullptr, page_size(), PROT_READ, MAP_SHARED, fds[i], 0);
+			if (page != MAP_FAILED) {
+				pages[i] = static_cast<const perf_event_mmap_page*>(page);
+			}
+		}
+	}
+
+	static constexpr std::array<std::pair<std::uint32_t, std::uint64_t>, count> events {{
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+	}};
+	// The hardware group's leader, which opens first.
+	static constexpr std::size_t leader = cycles;
+
+	static constexpr bool is_hardware(std::size_t i) {
+		return events[i].first == PERF_TYPE_HARDWARE;
+	}
+
+	static int open(perf_event_attr& attr, int group) {
+		// This thread (0), on any CPU (-1), in @p group's group (or a new one, if -1).
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+	}
+
+	static void report_once(std::size_t i, const char* name, const char* reason = nullptr) {
+		static std::mutex lock;
+		static std::array<bool, count> reported {};
+		const int error = errno;
+		const std::lock_guard guard {lock};
+		if (!reported[i]) {
+			reported[i] = true;
+			std::cerr << "perf_counters: cannot count " << name << ": " << (reason ? reason : std::strerror(error)) << "; logging 0" << std::endl;
+		}
+	}
+
+	static std::size_t page_size() {
+		return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	/**
+	 * @brief Reads a counter from its page, as in the example in `linux/perf_event.h`, and if
+	 * @p times is set, its group's time enabled and time running up to now (where the page allows).
+	 *
+	 * @return false if the counter is live in a hardware register that this thread cannot read.
+	 */
+	static bool read_page(const perf_event_mmap_page& pc, std::uint64_t& value, std::uint64_t* times) {
+		std::uint32_t seq;
+		do {
+			seq = pc.lock;
+			asm volatile ("" : : : "memory");
+			value = pc.offset;
+			if (times) {
+				times[0] = pc.time_enabled;
+				times[1] = pc.time_running;
+#if defined(__x86_64__) || defined(__i386__)
+				if (pc.cap_user_time) {
+					// The time since the page was last updated, from the TSC.
+					const std::uint64_t cyc = __rdtsc();
+					const std::uint64_t quot = cyc >> pc.time_shift;
+					const std::uint64_t rem = cyc & ((std::uint64_t{1} << pc.time_shift) - 1);
+					const std::uint64_t delta = pc.time_offset + quot * pc.time_mult + ((rem * pc.time_mult) >> pc.time_shift);
+					times[0] += delta;
+					if (pc.index) {
+						times[1] += delta;
+					}
+				}
+#endif
+			}
+			if (const std::uint32_t index = pc.index) {
+#if defined(__x86_64__) || defined(__i386__)
+				if (!pc.cap_user_rdpmc) {
+					return false;
+				}
+				// The hardware counter is pmc_width bits wide; sign-extend it.
+				const std::uint16_t width = pc.pmc_width;
+				std::int64_t pmc = static_cast<std::int64_t>(__rdpmc(static_cast<int>(index - 1)));
+				pmc = static_cast<std::int64_t>(static_cast<std::uint64_t>(pmc) << (64 - width)) >> (64 - width);
+				value += static_cast<std::uint64_t>(pmc);
+#else
+				return false;
+#endif
+			}
+			asm volatile ("" : : : "memory");
+		} while (pc.lock != seq);
+		return true;
+	}
+
+	std::array<int, count> fds;
+	std::array<const perf_event_mmap_page*, count> pages;
+};
+
+}
@@ -136,6 +136,17 @@ namespace ILLIXR {
 			return this_specific_service;
 		}
 
+		/**
+		 * @brief Whether an implementation of @p specific_service has been registered.
+		 *
+		 * Safe to be called from any thread.
+		 */
+		template <typename specific_service>
+		bool has_impl() const {
+			const std::lock_guard<std::mutex> lock{_m_mutex};
+			return _m_registry.count(std::type_index(typeid(specific_service))) == 1;
+		}
+
 	private:
 		std::unordered_map<std::type_index, const std::shared_ptr<service>> _m_registry;
 		mutable std::mutex _m_mutex;
@@ -14,6 +14,7 @@ namespace ILLIXR {
 			{"plugin_id", typeid(std::size_t)},
 			{"plugin_name", typeid(std::string)},
 		},
+		record_verbosity::essential,
 	};
 
 	/**
@@ -29,10 +30,12 @@ namespace ILLIXR {
 		 * consturctors.
 		 */
 		virtual void start() {
-			record_logger_->log(record{__plugin_start_header, {
-				{id},
-				{name},
-			}});
+			if (__plugin_start_header.should_log()) {
+				record_logger_->log(record{__plugin_start_header, {
+					{id},
+					{name},
+				}});
+			}
 		}
 
 		/**
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "phonebook.hpp"
+#include "record_logger.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Live, in-process access to the records most recently logged, by table.
+ *
+ * The runtime keeps the last few records of every table (`ILLIXR_RECENT_RECORDS`, default 256) as
+ * they pass through the record_logger, so components such as debugview or an adaptive controller
+ * can react to measurements while the system runs, without a database round-trip.
+ *
+ * Records arrive here from the record_logger's collector, so they lag their `log` call by up to
+ * its collect period (10ms), plus any coalescing the producer does.
+ */
+class recent_records : public phonebook::service {
+public:
+	using callback = std::function<void(const record&)>;
+
+	/**
+	 * @brief A live subscription; unsubscribes when destroyed.
+	 *
+	 * Destroy it before the recent_records service.
+	 */
+	class subscription {
+	public:
+		virtual ~subscription() { }
+	};
+
+	/**
+	 * @brief Returns the last (up to) @p count records of the table called @p table, oldest first.
+	 *
+	 * Safe to call from any thread. Returns nothing for a table that has not been logged yet.
+	 */
+	virtual std::vector<record> query(const std::string& table, std::size_t count) const = 0;
+
+	/**
+	 * @brief Calls @p cb with every record of the table called @p table logged from now on.
+	 *
+	 * @p cb runs on the record_logger's collector thread, so it should be quick, and it must not
+	 * call `query` or `subscribe` on this table.
+	 */
+	virtual std::unique_ptr<subscription> subscribe(const std::string& table, callback cb) = 0;
+
+	virtual ~recent_records() { }
+};
+
+}
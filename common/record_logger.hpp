@@ -1,15 +1,217 @@
 #pragma once
 
+#include <algorithm>
 #include <any>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <iostream>
+#include <optional>
 #include <unordered_map>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <memory>
 #include "phonebook.hpp"
+#include "cpu_timer.hpp"
+#include "name_matches.hpp"
 
 namespace ILLIXR {
 
+	/**
+	 * @brief How much detail a table carries. Tables above `ILLIXR_RECORD_VERBOSITY` are not logged.
+	 */
+	enum class record_verbosity {
+		/// Names and other one-off rows that make the rest readable.
+		essential,
+		/// Per-frame or per-second rows.
+		normal,
+		/// Per-event rows on hot paths.
+		detailed,
+	};
+
+	/**
+	 * @brief Decides which records of one record_header are logged.
+	 *
+	 * Configured once per record_header, when it is constructed, from the environment:
+	 *
+	 * - `ILLIXR_RECORD_VERBOSITY`: `essential`, `normal` or `detailed` (default). Tables whose
+	 *   verbosity is above this are off.
+	 * - `ILLIXR_RECORD_SAMPLING`: a comma-separated list of `table=policy`, where table may end in
+	 *   `*` to match a prefix, and policy is one of:
+	 *   - `1/N`: one record in N.
+	 *   - a period such as `10ms` (also `ns`, `us`, `s`): at most one record per period.
+	 *   - `reservoir:K`: a uniform sample of at most K records per flush of each
+	 *     `typed_record_coalescer` (about one per second). Only for `record_type` tables.
+	 *   - `off` or `all`.
+	 *
+	 * For example, `ILLIXR_RECORD_SAMPLING=threadloop_iteration=1/10,switchboard_*=5ms`.
+	 *
+	 * Tables without a policy have no sampler at all, so `record_header::should_log` costs a null
+	 * check for them.
+	 */
+	class record_sampler {
+	public:
+		enum class mode {
+			none,
+			one_in_n,
+			period,
+			reservoir,
+		};
+
+		record_sampler(mode mode_, std::size_t n_ = 1, std::chrono::nanoseconds period_ = std::chrono::nanoseconds{0})
+			: _m_mode{mode_}
+			, n{n_}
+			, period{period_}
+		{ }
+
+		/**
+		 * @brief Whether to log the next record. Thread-safe and lock-free.
+		 */
+		bool sample() {
+			switch (_m_mode) {
+			case mode::none:
+				return false;
+			case mode::one_in_n:
+				return counter.fetch_add(1, std::memory_order_relaxed) % n == 0;
+			case mode::period: {
+				const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()
+				).count();
+				std::int64_t next = next_time.load(std::memory_order_relaxed);
+				return now >= next && next_time.compare_exchange_strong(next, now + period.count(), std::memory_order_relaxed);
+			}
+			case mode::reservoir:
+				// Sampled by typed_record_coalescer, which holds the reservoir.
+				return true;
+			}
+			return true;
+		}
+
+		mode get_mode() const { return _m_mode; }
+
+		/**
+		 * @brief The reservoir size, for `mode::reservoir`.
+		 */
+		std::size_t get_n() const { return n; }
+
+		/**
+		 * @brief Builds the sampler for the table called @p name from the environment.
+		 *
+		 * Returns null if every record should be logged.
+		 */
+		static std::shared_ptr<record_sampler> for_table(const std::string& name, record_verbosity verbosity, bool fixed_layout) {
+			const config& conf = get_config();
+			if (verbosity > conf.verbosity) {
+				return std::make_shared<record_sampler>(mode::none);
+			}
+			for (const auto& [pattern, policy] : conf.policies) {
+				if (name_matches(pattern, name)) {
+					return from_policy(name, policy, fixed_layout);
+				}
+			}
+			return nullptr;
+		}
+
+		/**
+		 * @brief Builds the sampler for one `ILLIXR_RECORD_SAMPLING` @p policy, for the table called @p name.
+		 *
+		 * Returns null if every record should be logged.
+		 */
+		static std::shared_ptr<record_sampler> from_policy(const std::string& name, const std::string& policy, bool fixed_layout) {
+			const auto number = [&](const std::string& str) {
+				std::size_t end = 0;
+				unsigned long ret = 0;
+				try {
+					ret = std::stoul(str, &end);
+				} catch (const std::logic_error&) { }
+				if (end != str.size() || ret == 0) {
+					throw std::runtime_error{"ILLIXR_RECORD_SAMPLING has a bad policy for " + name + ": " + policy};
+				}
+				return ret;
+			};
+			const auto ends_with = [&](const std::string& suffix) {
+				return policy.size() > suffix.size() && policy.compare(policy.size() - suffix.size(), suffix.size(), suffix) == 0;
+			};
+
+			if (false) {
+			} else if (policy == "all") {
+				return nullptr;
+			} else if (policy == "off") {
+				return std::make_shared<record_sampler>(mode::none);
+			} else if (policy.compare(0, 2, "1/") == 0) {
+				const std::size_t n = number(policy.substr(2));
+				return n == 1 ? nullptr : std::make_shared<record_sampler>(mode::one_in_n, n);
+			} else if (policy.compare(0, 10, "reservoir:") == 0) {
+				if (!fixed_layout) {
+					std::cerr << "ILLIXR_RECORD_SAMPLING: " << name << " is not a record_type, so it cannot be reservoir-sampled; logging all of it" << std::endl;
+					return nullptr;
+				}
+				return std::make_shared<record_sampler>(mode::reservoir, number(policy.substr(10)));
+			} else if (ends_with("ns")) {
+				return std::make_shared<record_sampler>(mode::period, 1, std::chrono::nanoseconds{number(policy.substr(0, policy.size() - 2))});
+			} else if (ends_with("us")) {
+				return std::make_shared<record_sampler>(mode::period, 1, std::chrono::microseconds{number(policy.substr(0, policy.size() - 2))});
+			} else if (ends_with("ms")) {
+				return std::make_shared<record_sampler>(mode::period, 1, std::chrono::milliseconds{number(policy.substr(0, policy.size() - 2))});
+			} else if (ends_with("s")) {
+				return std::make_shared<record_sampler>(mode::period, 1, std::chrono::seconds{number(policy.substr(0, policy.size() - 1))});
+			} else {
+				throw std::runtime_error{"ILLIXR_RECORD_SAMPLING has a bad policy for " + name + ": " + policy};
+			}
+		}
+
+	private:
+		struct config {
+			record_verbosity verbosity = record_verbosity::detailed;
+			std::vector<std::pair<std::string, std::string>> policies;
+		};
+
+		static const config& get_config() {
+			static const config conf = [] {
+				config ret;
+				if (const char* verbosity = std::getenv("ILLIXR_RECORD_VERBOSITY")) {
+					if (false) {
+					} else if (std::string{verbosity} == "essential") {
+						ret.verbosity = record_verbosity::essential;
+					} else if (std::string{verbosity} == "normal") {
+						ret.verbosity = record_verbosity::normal;
+					} else if (std::string{verbosity} == "detailed") {
+						ret.verbosity = record_verbosity::detailed;
+					} else {
+						throw std::runtime_error{std::string{"ILLIXR_RECORD_VERBOSITY should be essential, normal or detailed, not "} + verbosity};
+					}
+				}
+				if (const char* sampling = std::getenv("ILLIXR_RECORD_SAMPLING")) {
+					std::istringstream entries {sampling};
+					std::string entry;
+					while (std::getline(entries, entry, ',')) {
+						const std::size_t equals = entry.find('=');
+						if (equals == std::string::npos) {
+							throw std::runtime_error{"ILLIXR_RECORD_SAMPLING entries should be table=policy, not " + entry};
+						}
+						ret.policies.emplace_back(entry.substr(0, equals), entry.substr(equals + 1));
+					}
+				}
+				return ret;
+			}();
+			return conf;
+		}
+
+		const mode _m_mode;
+		const std::size_t n;
+		const std::chrono::nanoseconds period;
+		std::atomic<std::size_t> counter {0};
+		std::atomic<std::int64_t> next_time {std::numeric_limits<std::int64_t>::min()};
+	};
+
 	/**
 	 * @brief Schema of each record.
 	 *
@@ -17,10 +219,13 @@ namespace ILLIXR {
 	 */
 	class record_header {
 	public:
-		record_header(std::string name_, std::vector<std::pair<std::string, const std::type_info&>> columns_)
+		record_header(std::string name_, std::vector<std::pair<std::string, const std::type_info&>> columns_,
+					  record_verbosity verbosity_ = record_verbosity::normal)
 			: id{std::hash<std::string>{}(name_)}
 			, name{name_}
 			, columns{columns_}
+			, verbosity{verbosity_}
+			, sampler{record_sampler::for_table(name, verbosity, false)}
 		{ }
 
 		/**
@@ -52,6 +257,48 @@ namespace ILLIXR {
 		const std::string& get_column_name(unsigned column) const { return columns[column].first; }
 		const std::type_info& get_column_type(unsigned column) const { return columns[column].second; }
 		unsigned get_columns() const { return columns.size(); }
+
+		/**
+		 * @brief Whether rows of this schema have a fixed, inline layout (see `record_type`).
+		 */
+		bool has_fixed_layout() const { return row_size != 0; }
+		/**
+		 * @brief Size in bytes of one fixed-layout row; 0 if `!has_fixed_layout()`.
+		 */
+		std::size_t get_row_size() const { return row_size; }
+		/**
+		 * @brief Byte offset of @p column within a fixed-layout row.
+		 */
+		std::size_t get_column_offset(unsigned column) const { return offsets[column]; }
+
+		record_verbosity get_verbosity() const { return verbosity; }
+
+		/**
+		 * @brief Whether to log the next record of this schema (see `record_sampler`).
+		 *
+		 * Check this before building a record, so that sampled-out records cost nothing more.
+		 * `typed_record_coalescer` checks it for you.
+		 */
+		bool should_log() const {
+			return !sampler || sampler->sample();
+		}
+
+		/**
+		 * @brief Replaces the sampler configured from the environment (null logs everything).
+		 *
+		 * Not thread-safe: call it before anything logs this schema.
+		 */
+		void set_sampler(std::shared_ptr<record_sampler> sampler_) {
+			sampler = std::move(sampler_);
+		}
+
+		/**
+		 * @brief The reservoir size if this schema is reservoir-sampled, else 0.
+		 */
+		std::size_t get_reservoir_size() const {
+			return sampler && sampler->get_mode() == record_sampler::mode::reservoir ? sampler->get_n() : 0;
+		}
+
 		std::string to_string() const {
 			std::string ret = std::string{"record_header "} + name + std::string{" { "};
 			for (const auto& pair : columns) {
@@ -62,12 +309,165 @@ namespace ILLIXR {
 			return ret;
 		}
 
+	protected:
+		record_header(std::string name_, std::vector<std::pair<std::string, const std::type_info&>> columns_,
+					  std::vector<std::size_t> offsets_, std::size_t row_size_, record_verbosity verbosity_)
+			: id{std::hash<std::string>{}(name_)}
+			, name{name_}
+			, columns{columns_}
+			, offsets{offsets_}
+			, row_size{row_size_}
+			, verbosity{verbosity_}
+			, sampler{record_sampler::for_table(name, verbosity, true)}
+		{ }
+
 	private:
 		std::size_t id;
 		std::string name;
 		const std::vector<std::pair<std::string, const std::type_info&>> columns;
+		const std::vector<std::size_t> offsets;
+		const std::size_t row_size = 0;
+		const record_verbosity verbosity;
+		// Shared, so that copies of a header sample together.
+		std::shared_ptr<record_sampler> sampler;
+	};
+
+	/**
+	 * @brief The column types which every backend knows how to store inline.
+	 *
+	 * `std::string` is deliberately missing: it would allocate. Use a plain `record_header` for
+	 * records with strings (these are rare, e.g. one per plugin or topic).
+	 */
+	template <typename T>
+	static constexpr bool is_fixed_column_v =
+		std::is_same_v<T, std::size_t>
+		|| std::is_same_v<T, bool>
+		|| std::is_same_v<T, double>
+		|| std::is_same_v<T, std::chrono::nanoseconds>
+		|| std::is_same_v<T, std::chrono::high_resolution_clock::time_point>;
+
+	/**
+	 * @brief Compile-time layout of a row: each column at its natural alignment, in order.
+	 */
+	template <typename... Columns>
+	struct record_layout {
+		static constexpr std::size_t columns = sizeof...(Columns);
+
+		static constexpr std::size_t alignment = std::max({alignof(Columns)...});
+
+		static constexpr std::array<std::size_t, columns> offsets = [] {
+			constexpr std::array<std::size_t, columns> sizes {sizeof(Columns)...};
+			constexpr std::array<std::size_t, columns> aligns {alignof(Columns)...};
+			std::array<std::size_t, columns> ret {};
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < columns; ++i) {
+				offset = (offset + aligns[i] - 1) / aligns[i] * aligns[i];
+				ret[i] = offset;
+				offset += sizes[i];
+			}
+			return ret;
+		}();
+
+		static constexpr std::size_t size = [] {
+			constexpr std::array<std::size_t, columns> sizes {sizeof(Columns)...};
+			std::size_t end = offsets[columns - 1] + sizes[columns - 1];
+			return (end + alignment - 1) / alignment * alignment;
+		}();
 	};
 
+	/**
+	 * @brief One row of a `record_type`, stored inline.
+	 *
+	 * This is trivially copyable, so buffers of rows can be memcpy'd around by backends.
+	 */
+	template <typename... Columns>
+	class record_row {
+	public:
+		using layout = record_layout<Columns...>;
+
+		template <std::size_t column>
+		using column_type = std::tuple_element_t<column, std::tuple<Columns...>>;
+
+		record_row() = default;
+
+		record_row(const Columns&... values) {
+			set(std::index_sequence_for<Columns...>{}, values...);
+		}
+
+		template <std::size_t column>
+		column_type<column> get() const {
+			column_type<column> ret;
+			std::memcpy(&ret, bytes + layout::offsets[column], sizeof(ret));
+			return ret;
+		}
+
+		const std::byte* data() const { return bytes; }
+
+	private:
+		template <std::size_t... column>
+		void set(std::index_sequence<column...>, const Columns&... values) {
+			(std::memcpy(bytes + layout::offsets[column], &values, sizeof(values)), ...);
+		}
+
+		alignas(layout::alignment) std::byte bytes[layout::size];
+	};
+
+	template <typename... Columns>
+	class typed_record_coalescer;
+
+	/**
+	 * @brief A record_header whose schema is known at compile time.
+	 *
+	 * Rows of a record_type are stored inline in a POD `row`, so logging them does not allocate,
+	 * and backends can bulk-copy them (see `record_logger::log(const record_header&, const std::byte*, std::size_t)`).
+	 *
+	 * \code{.cpp}
+	 * const record_type<std::size_t, std::chrono::nanoseconds> my_header {"my_table", {"iteration_no", "duration"}};
+	 * typed_record_coalescer my_log {record_logger_, my_header};
+	 * my_log.log(iteration_no, duration);
+	 * \endcode
+	 *
+	 * A record_type is also a record_header, so the dynamic `record` API still works on it.
+	 */
+	template <typename... Columns>
+	class record_type : public record_header {
+		static_assert(sizeof...(Columns) > 0);
+		static_assert((is_fixed_column_v<Columns> && ...), "record_type columns must be fixed-width; see is_fixed_column_v");
+
+	public:
+		using row = record_row<Columns...>;
+		using layout = typename row::layout;
+		using coalescer = typed_record_coalescer<Columns...>;
+		static_assert(sizeof(row) == layout::size);
+		static_assert(std::is_trivially_copyable_v<row>);
+
+		record_type(std::string name_, std::array<std::string, sizeof...(Columns)> column_names,
+					record_verbosity verbosity_ = record_verbosity::normal)
+			: record_header{name_, make_columns(column_names, std::index_sequence_for<Columns...>{}),
+							std::vector<std::size_t>(layout::offsets.begin(), layout::offsets.end()), layout::size, verbosity_}
+		{ }
+
+	private:
+		template <std::size_t... column>
+		static std::vector<std::pair<std::string, const std::type_info&>>
+		make_columns(const std::array<std::string, sizeof...(Columns)>& column_names, std::index_sequence<column...>) {
+			return {{column_names[column], typeid(Columns)}...};
+		}
+	};
+
+	/**
+	 * @brief Reads @p column of the fixed-layout @p row as a @p T.
+	 *
+	 * The caller is responsible for checking `rh.get_column_type(column) == typeid(T)`.
+	 */
+	template <typename T>
+	T get_row_value(const record_header& rh, const std::byte* row, unsigned column) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		T ret;
+		std::memcpy(&ret, row + rh.get_column_offset(column), sizeof(T));
+		return ret;
+	}
+
 	/**
 	 * @brief A helper class that lets one dynamically determine if some data gets used.
 	 *
@@ -106,7 +506,7 @@ namespace ILLIXR {
 	public:
 		record(const record_header& rh_, std::vector<std::any> values_)
 			: rh{rh_}
-			, values{values_}
+			, values(std::move(values_))
 		{
 #ifndef NDEBUG
 			assert(rh);
@@ -204,6 +604,87 @@ namespace ILLIXR {
 				log(r);
 			}
 		}
+
+		/**
+		 * @brief Writes @p count fixed-layout rows of @p rh, packed back-to-back at @p rows.
+		 *
+		 * Backends should override this to copy the rows in bulk. This default unpacks each row
+		 * into a `record`, which is correct but allocates.
+		 */
+		virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) {
+			std::vector<record> rs;
+			rs.reserve(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				rs.push_back(unpack_row(rh, rows + i * rh.get_row_size()));
+			}
+			log(rs);
+		}
+
+		/**
+		 * @brief Writes an `instrumentation_overhead` record (see `instrumentation_meter`).
+		 *
+		 * These describe the logging machinery itself, so a logger handed to a coalescer should not
+		 * have to expect them; by default they are dropped. The runtime's logger writes them.
+		 */
+		virtual void log_overhead(const record& r) {
+			r.mark_used();
+		}
+
+		/**
+		 * @brief Converts one fixed-layout row into a dynamic `record`.
+		 */
+		static record unpack_row(const record_header& rh, const std::byte* row) {
+			std::vector<std::any> values;
+			values.reserve(rh.get_columns());
+			for (unsigned i = 0; i < rh.get_columns(); ++i) {
+				if (false) {
+				} else if (rh.get_column_type(i) == typeid(std::size_t)) {
+					values.emplace_back(get_row_value<std::size_t>(rh, row, i));
+				} else if (rh.get_column_type(i) == typeid(bool)) {
+					values.emplace_back(get_row_value<bool>(rh, row, i));
+				} else if (rh.get_column_type(i) == typeid(double)) {
+					values.emplace_back(get_row_value<double>(rh, row, i));
+				} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
+					values.emplace_back(get_row_value<std::chrono::nanoseconds>(rh, row, i));
+				} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
+					values.emplace_back(get_row_value<std::chrono::high_resolution_clock::time_point>(rh, row, i));
+				} else {
+					throw std::runtime_error{std::string{"type "} + rh.get_column_type(i).name() + " cannot be in a fixed-layout row"};
+				}
+			}
+			return record{rh, std::move(values)};
+		}
+
+		/**
+		 * @brief Converts a dynamic `record` into one fixed-layout row at @p row.
+		 *
+		 * `r.get_record_header()` must have a fixed layout.
+		 */
+		static void pack_row(const record& r, std::byte* row) {
+			const record_header& rh = r.get_record_header();
+			for (unsigned i = 0; i < rh.get_columns(); ++i) {
+				if (false) {
+				} else if (rh.get_column_type(i) == typeid(std::size_t)) {
+					set_row_value(rh, row, i, r.get_value<std::size_t>(i));
+				} else if (rh.get_column_type(i) == typeid(bool)) {
+					set_row_value(rh, row, i, r.get_value<bool>(i));
+				} else if (rh.get_column_type(i) == typeid(double)) {
+					set_row_value(rh, row, i, r.get_value<double>(i));
+				} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
+					set_row_value(rh, row, i, r.get_value<std::chrono::nanoseconds>(i));
+				} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
+					set_row_value(rh, row, i, r.get_value<std::chrono::high_resolution_clock::time_point>(i));
+				} else {
+					throw std::runtime_error{std::string{"type "} + rh.get_column_type(i).name() + " cannot be in a fixed-layout row"};
+				}
+			}
+		}
+
+	private:
+		template <typename T>
+		static void set_row_value(const record_header& rh, std::byte* row, unsigned column, const T& value) {
+			std::memcpy(row + rh.get_column_offset(column), &value, sizeof(T));
+		}
 	};
 
 	/**
@@ -236,6 +717,100 @@ namespace ILLIXR {
 		std::unordered_map<std::size_t, std::unordered_map<std::size_t, std::unordered_map<std::size_t, std::atomic<std::size_t>>>> guid_starts;
 	};
 
+	/*
+	 * This gets included, but it is functionally 'private'. Hence the double-underscores.
+	 */
+	const record_header __instrumentation_overhead_header {"instrumentation_overhead", {
+		{"thread_id", typeid(std::size_t)},
+		{"site", typeid(std::string)},
+		{"calls", typeid(std::size_t)},
+		{"sampled_calls", typeid(std::size_t)},
+		{"sampled_time", typeid(std::chrono::nanoseconds)},
+		{"estimated_time", typeid(std::chrono::nanoseconds)},
+	}};
+
+	/**
+	 * @brief Estimates how long one thread spends in one piece of instrumentation.
+	 *
+	 * Wrap the instrumentation (clock reads, building and logging rows, histograms) in a `scope`.
+	 * One scope in `sample_period` is timed with the thread's CPU clock (so being preempted in the
+	 * middle does not count); the others cost an increment and a branch. When the meter is
+	 * destroyed, it logs one `instrumentation_overhead` row, with `estimated_time` = `sampled_time` *
+	 * `calls` / `sampled_calls`, through `record_logger::log_overhead`.
+	 *
+	 * Sites nest: a threadloop's site (`threadloop/<plugin>`) includes the time spent in its
+	 * `threadloop_iteration` coalescer, which is also a site of its own (`record/threadloop_iteration`).
+	 *
+	 * Not thread-safe; a meter belongs to one thread.
+	 */
+	class instrumentation_meter {
+	public:
+		static constexpr std::size_t sample_period = 64;
+
+		class scope {
+		public:
+			explicit scope(instrumentation_meter& meter_)
+				: meter{meter_}
+				, start{meter.start()}
+			{ }
+
+			scope(const scope&) = delete;
+			scope& operator=(const scope&) = delete;
+
+			~scope() {
+				meter.stop(start);
+			}
+
+		private:
+			instrumentation_meter& meter;
+			const std::chrono::nanoseconds start;
+		};
+
+		instrumentation_meter(std::shared_ptr<record_logger> logger_, std::string site_)
+			: logger{std::move(logger_)}
+			, site{std::move(site_)}
+		{ }
+
+		instrumentation_meter(const instrumentation_meter&) = delete;
+		instrumentation_meter& operator=(const instrumentation_meter&) = delete;
+
+		~instrumentation_meter() {
+			if (sampled_calls && __instrumentation_overhead_header.should_log()) {
+				logger->log_overhead(record{__instrumentation_overhead_header, {
+					{thread_id},
+					{site},
+					{calls},
+					{sampled_calls},
+					{sampled_time},
+					{std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(sampled_time.count() * calls / sampled_calls)}},
+				}});
+			}
+		}
+
+	private:
+		static constexpr std::chrono::nanoseconds not_sampled = std::chrono::nanoseconds::min();
+
+		std::chrono::nanoseconds start() {
+			// Includes the first call, so that short-lived sites are still sampled.
+			return calls++ % sample_period == 0 ? thread_cpu_time() : not_sampled;
+		}
+
+		void stop(std::chrono::nanoseconds start) {
+			if (start != not_sampled) {
+				sampled_time += thread_cpu_time() - start;
+				++sampled_calls;
+				thread_id = kernel_thread_id();
+			}
+		}
+
+		const std::shared_ptr<record_logger> logger;
+		const std::string site;
+		std::size_t thread_id = 0;
+		std::size_t calls = 0;
+		std::size_t sampled_calls = 0;
+		std::chrono::nanoseconds sampled_time {0};
+	};
+
 
 	static std::chrono::milliseconds LOG_BUFFER_DELAY {1000};
 
@@ -274,7 +849,7 @@ namespace ILLIXR {
 	public:
 		record_coalescer(std::shared_ptr<record_logger> logger_)
 			: logger{logger_}
-			, last_log{std::chrono::high_resolution_clock::now()}
+			, last_log{tsc_clock::now()}
 		{ }
 
 		~record_coalescer() {
@@ -303,7 +878,7 @@ namespace ILLIXR {
 		 * @brief Use internal decision process, and possibly trigger flush.
 		 */
 		void maybe_flush() {
-			if (std::chrono::high_resolution_clock::now() > last_log + LOG_BUFFER_DELAY) {
+			if (tsc_clock::now() > last_log + LOG_BUFFER_DELAY) {
 				flush();
 			}
 		}
@@ -315,7 +890,139 @@ namespace ILLIXR {
 			std::vector<record> buffer2;
 			buffer.swap(buffer2);
 			logger->log(buffer2);
-			last_log = std::chrono::high_resolution_clock::now();
+			last_log = tsc_clock::now();
 		}
 	};
+
+	/**
+	 * @brief Like `record_coalescer`, but for one `record_type`, and allocation-free.
+	 *
+	 * Rows are written in place into a buffer whose capacity is reserved up front, and handed to
+	 * the backend in bulk when the buffer is full or its oldest row is older than
+	 * LOG_BUFFER_DELAY. The buffer is reused after each flush.
+	 *
+	 * Sampling (see `record_sampler`) can be decided before a row is built: a call site whose
+	 * columns cost something to read (CPU clocks, performance counters) asks `wants_row()` first, and
+	 * only reads them and calls `log()` if it says so. For a reservoir-sampled header, the buffer is
+	 * the reservoir: each flush writes a uniform sample of the rows logged since the previous one.
+	 *
+	 * \code{.cpp}
+	 * typed_record_coalescer it_log {record_logger_, __threadloop_iteration_header};
+	 * if (it_log.wants_row()) {
+	 *     it_log.log(id, iteration_no, thread_cpu_time(), ...);
+	 * }
+	 * \endcode
+	 */
+	template <typename... Columns>
+	class typed_record_coalescer {
+	public:
+		using row = typename record_type<Columns...>::row;
+
+		typed_record_coalescer(std::shared_ptr<record_logger> logger_, const record_type<Columns...>& rh_, std::size_t capacity_ = 1024)
+			: logger{logger_}
+			, rh{rh_}
+			, capacity{capacity_}
+			, reservoir_size{rh_.get_reservoir_size()}
+			, last_log{tsc_clock::now()}
+			, overhead{logger_, "record/" + rh_.get_name()}
+		{
+			buffer.reserve(reservoir_size ? reservoir_size : capacity);
+		}
+
+		typed_record_coalescer(const typed_record_coalescer&) = delete;
+		typed_record_coalescer& operator=(const typed_record_coalescer&) = delete;
+
+		~typed_record_coalescer() {
+			flush();
+		}
+
+		/**
+		 * @brief Decides whether the next row is kept; if not, the call site need not build it.
+		 *
+		 * Each call decides one row, which the call site then passes to `log()` before asking again.
+		 */
+		bool wants_row() {
+			if (reservoir_size) {
+				// Algorithm R, over the rows since the last flush.
+				++seen;
+				if (buffer.size() < reservoir_size) {
+					slot = buffer.size();
+				} else if (std::size_t replaced = next_random() % seen; replaced < reservoir_size) {
+					slot = replaced;
+				} else {
+					maybe_flush();
+					return false;
+				}
+			} else if (rh.should_log()) {
+				slot = buffer.size();
+			} else {
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Appends a row to the buffer, which will eventually be written.
+		 *
+		 * Unless `wants_row()` has just kept it, this decides by itself whether to keep it.
+		 */
+		void log(const Columns&... values) {
+			if (!slot && !wants_row()) {
+				return;
+			}
+			const instrumentation_meter::scope measure {overhead};
+			if (*slot == buffer.size()) {
+				buffer.emplace_back(values...);
+			} else {
+				buffer[*slot] = row{values...};
+			}
+			slot.reset();
+			maybe_flush();
+		}
+
+		/**
+		 * @brief Use internal decision process, and possibly trigger flush.
+		 */
+		void maybe_flush() {
+			if ((!reservoir_size && buffer.size() >= capacity)
+				|| tsc_clock::now() > last_log + LOG_BUFFER_DELAY) {
+				flush();
+			}
+		}
+
+		/**
+		 * @brief Flush buffer of rows to the underlying logger.
+		 */
+		void flush() {
+			if (!buffer.empty()) {
+				logger->log(rh, reinterpret_cast<const std::byte*>(buffer.data()), buffer.size());
+				buffer.clear();
+			}
+			seen = 0;
+			last_log = tsc_clock::now();
+		}
+
+	private:
+		/**
+		 * @brief xorshift64; plenty for picking reservoir slots, and never allocates or locks.
+		 */
+		std::uint64_t next_random() {
+			random_state ^= random_state << 13;
+			random_state ^= random_state >> 7;
+			random_state ^= random_state << 17;
+			return random_state;
+		}
+
+		const std::shared_ptr<record_logger> logger;
+		const record_type<Columns...>& rh;
+		const std::size_t capacity;
+		const std::size_t reservoir_size;
+		std::size_t seen = 0;
+		// Where the row that `wants_row()` kept goes, until it is logged.
+		std::optional<std::size_t> slot;
+		std::uint64_t random_state = reinterpret_cast<std::uintptr_t>(this) | 1;
+		std::chrono::time_point<std::chrono::high_resolution_clock> last_log;
+		std::vector<row> buffer;
+		instrumentation_meter overhead;
+	};
 }
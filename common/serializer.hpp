@@ -0,0 +1,647 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "data_format.hpp"
+
+namespace ILLIXR {
+
+	/*
+	  Wire format (all integers little-endian, as on every platform ILLIXR runs on):
+
+	  offset 0:                 wire_header
+	  offset header.body_offset: serializer<T>::wire_type (fixed layout, trivially copyable)
+	  offset blob_ref.offset:    out-of-line blobs (image pixels), each aligned to WIRE_ALIGNMENT
+
+	  Every offset is relative to the start of the message, so a message can be memcpy'd, mmap'd or
+	  sent over a socket and then read in place through `wire_view` without any parsing.
+	*/
+
+	/**
+	 * @brief Alignment of the body and of every blob within a serialized message.
+	 *
+	 * A cache line, so that image rows handed to SIMD code start on a nice boundary.
+	 */
+	static constexpr std::size_t WIRE_ALIGNMENT = 64;
+
+	static constexpr uint32_t WIRE_MAGIC = 0x57584c49; // "ILXW"
+	static constexpr uint16_t WIRE_VERSION = 1;
+
+	static constexpr std::size_t wire_align(std::size_t offset) {
+		return (offset + WIRE_ALIGNMENT - 1) & ~(WIRE_ALIGNMENT - 1);
+	}
+
+	/**
+	 * @brief A stable (across processes and builds) identifier for a wire type.
+	 *
+	 * `typeid(T).hash_code()` is not stable across compilers, so we hash the name given in the
+	 * `serializer` specialization instead (64-bit FNV-1a).
+	 */
+	static constexpr uint64_t wire_type_id(const char* name) {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (; *name; ++name) {
+			hash = (hash ^ static_cast<uint8_t>(*name)) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	struct wire_header {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+		uint64_t type_id;
+		uint64_t size;
+		uint32_t body_offset;
+		uint32_t body_size;
+	};
+	static_assert(sizeof(wire_header) == 32);
+
+	/**
+	 * @brief A reference to an out-of-line blob, relative to the start of the message.
+	 */
+	struct blob_ref {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	/**
+	 * @brief An image, stored out-of-line. Rows are packed (step == cols * elem_size).
+	 */
+	struct wire_mat {
+		blob_ref data;
+		int32_t rows;
+		int32_t cols;
+		int32_t type;
+		uint32_t present;
+	};
+
+	/**
+	 * @brief A growable buffer with WIRE_ALIGNMENT-aligned storage.
+	 *
+	 * `clear()` keeps the capacity, so reusing one buffer for many messages does not allocate in
+	 * the steady state.
+	 */
+	class wire_buffer {
+	public:
+		wire_buffer() { }
+		wire_buffer(const wire_buffer&) = delete;
+		wire_buffer& operator=(const wire_buffer&) = delete;
+		~wire_buffer() { std::free(_m_data); }
+
+		std::byte* data() { return _m_data; }
+		const std::byte* data() const { return _m_data; }
+		std::size_t size() const { return _m_size; }
+		std::size_t capacity() const { return _m_capacity; }
+		void clear() { _m_size = 0; }
+
+		/**
+		 * @brief Grows the buffer to @p new_size bytes, zero-filling any new bytes.
+		 */
+		void resize(std::size_t new_size) {
+			reserve(new_size);
+			if (new_size > _m_size) {
+				std::memset(_m_data + _m_size, 0, new_size - _m_size);
+			}
+			_m_size = new_size;
+		}
+
+		void reserve(std::size_t new_capacity) {
+			if (new_capacity <= _m_capacity) {
+				return;
+			}
+			new_capacity = wire_align(std::max(new_capacity, 2 * _m_capacity));
+			auto* new_data = static_cast<std::byte*>(std::aligned_alloc(WIRE_ALIGNMENT, new_capacity));
+			if (!new_data) {
+				throw std::bad_alloc{};
+			}
+			if (_m_data) {
+				std::memcpy(new_data, _m_data, _m_size);
+				std::free(_m_data);
+			}
+			_m_data = new_data;
+			_m_capacity = new_capacity;
+		}
+
+	private:
+		std::byte* _m_data = nullptr;
+		std::size_t _m_size = 0;
+		std::size_t _m_capacity = 0;
+	};
+
+	/**
+	 * @brief Appends blobs to a message that is being encoded.
+	 */
+	class blob_writer {
+	public:
+		blob_writer(wire_buffer& buffer_) : buffer{buffer_} { }
+
+		blob_ref write(const void* src, std::size_t size) {
+			blob_ref ref {wire_align(buffer.size()), size};
+			buffer.resize(ref.offset + size);
+			if (size) {
+				std::memcpy(buffer.data() + ref.offset, src, size);
+			}
+			return ref;
+		}
+
+		wire_mat write(const cv::Mat& mat) {
+			const std::size_t row_size = mat.cols * mat.elemSize();
+			wire_mat ret {{wire_align(buffer.size()), row_size * mat.rows}, mat.rows, mat.cols, mat.type(), 1};
+			buffer.resize(ret.data.offset + ret.data.size);
+			if (mat.isContinuous()) {
+				std::memcpy(buffer.data() + ret.data.offset, mat.data, ret.data.size);
+			} else {
+				for (int row = 0; row < mat.rows; ++row) {
+					std::memcpy(buffer.data() + ret.data.offset + row * row_size, mat.ptr(row), row_size);
+				}
+			}
+			return ret;
+		}
+
+		wire_mat write(const std::optional<cv::Mat*>& mat) {
+			if (mat && *mat) {
+				return write(**mat);
+			} else {
+				return wire_mat{{0, 0}, 0, 0, 0, 0};
+			}
+		}
+
+	private:
+		wire_buffer& buffer;
+	};
+
+	/**
+	 * @brief Reads blobs from a message that is being decoded, in place.
+	 */
+	class blob_reader {
+	public:
+		blob_reader(const std::byte* message_, std::size_t size_)
+			: message{message_}
+			, size{size_}
+		{ }
+
+		const std::byte* read(const blob_ref& ref) const {
+			// Not offset + size, which a corrupt offset can wrap around.
+			if (ref.offset > size || ref.size > size - ref.offset) {
+				throw std::runtime_error{"blob_ref points past the end of the message"};
+			}
+			return message + ref.offset;
+		}
+
+		/**
+		 * @brief Returns a cv::Mat header which points into the message (no pixel copy).
+		 *
+		 * The message must outlive the returned cv::Mat; clone() it if it needs to outlive.
+		 *
+		 * @throws If the dimensions are negative, or the pixels they describe are not exactly the blob.
+		 */
+		cv::Mat read(const wire_mat& mat) const {
+			if (mat.rows < 0 || mat.cols < 0) {
+				throw std::runtime_error{"wire_mat has negative dimensions"};
+			}
+			// rows * cols fits in 62 bits; check the element size would not overflow before multiplying.
+			const uint64_t pixels = static_cast<uint64_t>(mat.rows) * static_cast<uint64_t>(mat.cols);
+			const uint64_t elem_size = CV_ELEM_SIZE(mat.type);
+			if (pixels > std::numeric_limits<uint64_t>::max() / elem_size || pixels * elem_size != mat.data.size) {
+				throw std::runtime_error{"wire_mat dimensions do not match its pixel data"};
+			}
+			return cv::Mat{mat.rows, mat.cols, mat.type, const_cast<std::byte*>(read(mat.data))};
+		}
+
+		/**
+		 * @brief Like read(const wire_mat&) but in the `std::optional<cv::Mat*>` form of `imu_cam_type`.
+		 *
+		 * The caller owns the returned cv::Mat* (but not the pixels it points at).
+		 */
+		std::optional<cv::Mat*> read_optional(const wire_mat& mat) const {
+			return mat.present ? std::make_optional<cv::Mat*>(new cv::Mat{read(mat)}) : std::nullopt;
+		}
+
+	private:
+		const std::byte* message;
+		std::size_t size;
+	};
+
+	/**
+	 * @brief Serialization traits. Specialize this for every type which goes on the wire.
+	 *
+	 * A specialization provides:
+	 * - `static constexpr const char* name`: stable name, used for the type_id.
+	 * - `wire_type`: a trivially copyable, standard layout struct with fixed-width fields.
+	 * - `static void encode(const T&, wire_type&, blob_writer&)`, which may take further arguments
+	 *   that the producer passes to `serialize()` (e.g. sizes that `T` does not carry itself)
+	 * - `static T decode(const wire_type&, const blob_reader&)`
+	 */
+	template <typename T>
+	struct serializer;
+
+	/* Helpers for the common field types. */
+
+	static inline int64_t encode_time(time_type t) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+	}
+
+	static inline time_type decode_time(int64_t ns) {
+		return time_type{std::chrono::duration_cast<time_type::duration>(std::chrono::nanoseconds{ns})};
+	}
+
+	template <typename Scalar, int rows>
+	static void encode_vector(const Eigen::Matrix<Scalar, rows, 1>& in, Scalar (&out)[rows]) {
+		Eigen::Map<Eigen::Matrix<Scalar, rows, 1>>{out} = in;
+	}
+
+	template <typename Scalar, int rows>
+	static Eigen::Matrix<Scalar, rows, 1> decode_vector(const Scalar (&in)[rows]) {
+		return Eigen::Map<const Eigen::Matrix<Scalar, rows, 1>>{in};
+	}
+
+	/* One specialization per type in data_format.hpp (and the bare types used as topics). */
+
+	template <>
+	struct serializer<time_type> {
+		static constexpr const char* name = "time_type";
+		struct wire_type {
+			int64_t time;
+		};
+		static void encode(const time_type& in, wire_type& out, blob_writer&) {
+			out.time = encode_time(in);
+		}
+		static time_type decode(const wire_type& in, const blob_reader&) {
+			return decode_time(in.time);
+		}
+	};
+
+	template <>
+	struct serializer<std::chrono::duration<double, std::nano>> {
+		static constexpr const char* name = "duration_ns";
+		struct wire_type {
+			double count;
+		};
+		static void encode(const std::chrono::duration<double, std::nano>& in, wire_type& out, blob_writer&) {
+			out.count = in.count();
+		}
+		static std::chrono::duration<double, std::nano> decode(const wire_type& in, const blob_reader&) {
+			return std::chrono::duration<double, std::nano>{in.count};
+		}
+	};
+
+	template <>
+	struct serializer<imu_cam_type> {
+		static constexpr const char* name = "imu_cam_type";
+		struct wire_type {
+			int64_t time;
+			float angular_v[3];
+			float linear_a[3];
+			uint64_t dataset_time;
+			wire_mat img0;
+			wire_mat img1;
+		};
+		static void encode(const imu_cam_type& in, wire_type& out, blob_writer& blobs) {
+			out.time = encode_time(in.time);
+			encode_vector(in.angular_v, out.angular_v);
+			encode_vector(in.linear_a, out.linear_a);
+			out.dataset_time = in.dataset_time;
+			out.img0 = blobs.write(in.img0);
+			out.img1 = blobs.write(in.img1);
+		}
+		/**
+		 * The decoded images borrow the message's pixels; see blob_reader::read.
+		 */
+		static imu_cam_type decode(const wire_type& in, const blob_reader& blobs) {
+			return imu_cam_type{
+				decode_time(in.time),
+				decode_vector(in.angular_v),
+				decode_vector(in.linear_a),
+				blobs.read_optional(in.img0),
+				blobs.read_optional(in.img1),
+				in.dataset_time,
+			};
+		}
+	};
+
+	template <>
+	struct serializer<imu_raw_type> {
+		static constexpr const char* name = "imu_raw_type";
+		struct wire_type {
+			double w_hat[3];
+			double a_hat[3];
+			double w_hat2[3];
+			double a_hat2[3];
+			double state_plus[13];
+			int64_t imu_time;
+		};
+		static void encode(const imu_raw_type& in, wire_type& out, blob_writer&) {
+			encode_vector(in.w_hat, out.w_hat);
+			encode_vector(in.a_hat, out.a_hat);
+			encode_vector(in.w_hat2, out.w_hat2);
+			encode_vector(in.a_hat2, out.a_hat2);
+			encode_vector(in.state_plus, out.state_plus);
+			out.imu_time = encode_time(in.imu_time);
+		}
+		static imu_raw_type decode(const wire_type& in, const blob_reader&) {
+			return imu_raw_type{
+				decode_vector(in.w_hat),
+				decode_vector(in.a_hat),
+				decode_vector(in.w_hat2),
+				decode_vector(in.a_hat2),
+				decode_vector(in.state_plus),
+				decode_time(in.imu_time),
+			};
+		}
+	};
+
+	/**
+	 * `rgb_depth_type` carries bare pointers without their extents, so the producer passes how many
+	 * bytes are behind them to each `serialize(value, buffer, extent)`.
+	 */
+	template <>
+	struct serializer<rgb_depth_type> {
+		static constexpr const char* name = "rgb_depth_type";
+		struct extent_type {
+			std::size_t rgb_bytes;
+			std::size_t depth_bytes;
+		};
+
+		struct wire_type {
+			int64_t time;
+			blob_ref rgb;
+			blob_ref depth;
+		};
+		static void encode(const rgb_depth_type& in, wire_type& out, blob_writer& blobs, const extent_type& extent) {
+			out.time = in.time;
+			out.rgb = blobs.write(in.rgb, in.rgb ? extent.rgb_bytes : 0);
+			out.depth = blobs.write(in.depth, in.depth ? extent.depth_bytes : 0);
+		}
+		/**
+		 * The decoded pointers borrow the message's bytes.
+		 */
+		static rgb_depth_type decode(const wire_type& in, const blob_reader& blobs) {
+			return rgb_depth_type{
+				in.time,
+				in.rgb.size ? reinterpret_cast<const unsigned char*>(blobs.read(in.rgb)) : nullptr,
+				in.depth.size ? reinterpret_cast<const unsigned short*>(blobs.read(in.depth)) : nullptr,
+			};
+		}
+	};
+
+	template <>
+	struct serializer<pose_type> {
+		static constexpr const char* name = "pose_type";
+		struct wire_type {
+			int64_t sensor_time;
+			float position[3];
+			/// Eigen's coeffs() order: x, y, z, w
+			float orientation[4];
+		};
+		static void encode(const pose_type& in, wire_type& out, blob_writer&) {
+			out.sensor_time = encode_time(in.sensor_time);
+			encode_vector(in.position, out.position);
+			encode_vector(Eigen::Vector4f{in.orientation.coeffs()}, out.orientation);
+		}
+		static pose_type decode(const wire_type& in, const blob_reader&) {
+			return pose_type{
+				decode_time(in.sensor_time),
+				decode_vector(in.position),
+				Eigen::Quaternionf{decode_vector(in.orientation)},
+			};
+		}
+	};
+
+	template <>
+	struct serializer<fast_pose_type> {
+		static constexpr const char* name = "fast_pose_type";
+		struct wire_type {
+			serializer<pose_type>::wire_type pose;
+			int64_t predict_computed_time;
+			int64_t predict_target_time;
+		};
+		static void encode(const fast_pose_type& in, wire_type& out, blob_writer& blobs) {
+			serializer<pose_type>::encode(in.pose, out.pose, blobs);
+			out.predict_computed_time = encode_time(in.predict_computed_time);
+			out.predict_target_time = encode_time(in.predict_target_time);
+		}
+		static fast_pose_type decode(const wire_type& in, const blob_reader& blobs) {
+			return fast_pose_type{
+				serializer<pose_type>::decode(in.pose, blobs),
+				decode_time(in.predict_computed_time),
+				decode_time(in.predict_target_time),
+			};
+		}
+	};
+
+	/**
+	 * @brief Serializer for types which already have a fixed, pointer-free layout.
+	 */
+	template <typename T>
+	struct memcpy_serializer {
+		static_assert(std::is_trivially_copyable_v<T>);
+		using wire_type = T;
+		static void encode(const T& in, wire_type& out, blob_writer&) { out = in; }
+		static T decode(const wire_type& in, const blob_reader&) { return in; }
+	};
+
+	template <>
+	struct serializer<camera_frame> : memcpy_serializer<camera_frame> {
+		static constexpr const char* name = "camera_frame";
+	};
+
+	template <>
+	struct serializer<hologram_input> : memcpy_serializer<hologram_input> {
+		static constexpr const char* name = "hologram_input";
+	};
+
+	template <>
+	struct serializer<hologram_output> : memcpy_serializer<hologram_output> {
+		static constexpr const char* name = "hologram_output";
+	};
+
+	template <>
+	struct serializer<accel> : memcpy_serializer<accel> {
+		static constexpr const char* name = "accel";
+	};
+
+	template <>
+	struct serializer<hmd_physical_info> : memcpy_serializer<hmd_physical_info> {
+		static constexpr const char* name = "hmd_physical_info";
+	};
+
+	/**
+	 * Texture handles are only meaningful within the GL share-group which created them.
+	 */
+	template <>
+	struct serializer<rendered_frame> {
+		static constexpr const char* name = "rendered_frame";
+		struct wire_type {
+			uint32_t texture_handle;
+			serializer<pose_type>::wire_type render_pose;
+			int64_t sample_time;
+			int64_t render_time;
+		};
+		static void encode(const rendered_frame& in, wire_type& out, blob_writer& blobs) {
+			out.texture_handle = in.texture_handle;
+			serializer<pose_type>::encode(in.render_pose, out.render_pose, blobs);
+			out.sample_time = encode_time(in.sample_time);
+			out.render_time = encode_time(in.render_time);
+		}
+		static rendered_frame decode(const wire_type& in, const blob_reader& blobs) {
+			return rendered_frame{
+				in.texture_handle,
+				serializer<pose_type>::decode(in.render_pose, blobs),
+				decode_time(in.sample_time),
+				decode_time(in.render_time),
+			};
+		}
+	};
+
+	template <>
+	struct serializer<rendered_frame_alt> {
+		static constexpr const char* name = "rendered_frame_alt";
+		struct wire_type {
+			uint32_t texture_handles[2];
+			uint32_t swap_indices[2];
+			serializer<fast_pose_type>::wire_type render_pose;
+			int64_t sample_time;
+			int64_t render_time;
+		};
+		static void encode(const rendered_frame_alt& in, wire_type& out, blob_writer& blobs) {
+			for (int eye = 0; eye < 2; ++eye) {
+				out.texture_handles[eye] = in.texture_handles[eye];
+				out.swap_indices[eye] = in.swap_indices[eye];
+			}
+			serializer<fast_pose_type>::encode(in.render_pose, out.render_pose, blobs);
+			out.sample_time = encode_time(in.sample_time);
+			out.render_time = encode_time(in.render_time);
+		}
+		static rendered_frame_alt decode(const wire_type& in, const blob_reader& blobs) {
+			rendered_frame_alt out;
+			for (int eye = 0; eye < 2; ++eye) {
+				out.texture_handles[eye] = in.texture_handles[eye];
+				out.swap_indices[eye] = in.swap_indices[eye];
+			}
+			out.render_pose = serializer<fast_pose_type>::decode(in.render_pose, blobs);
+			out.sample_time = decode_time(in.sample_time);
+			out.render_time = decode_time(in.render_time);
+			return out;
+		}
+	};
+
+	/**
+	 * @brief Encodes @p value into @p buffer, replacing its contents.
+	 *
+	 * @p args go to `serializer<T>::encode`, for types that need them. Returns the size of the
+	 * message (also `buffer.size()`).
+	 */
+	template <typename T, typename... Args>
+	std::size_t serialize(const T& value, wire_buffer& buffer, const Args&... args) {
+		using wire_type = typename serializer<T>::wire_type;
+		static_assert(std::is_trivially_copyable_v<wire_type>, "wire types must be memcpy-able");
+		static_assert(std::is_standard_layout_v<wire_type>, "wire types must have a fixed layout");
+		static_assert(alignof(wire_type) <= WIRE_ALIGNMENT);
+
+		const std::size_t body_offset = wire_align(sizeof(wire_header));
+		buffer.clear();
+		buffer.resize(body_offset + sizeof(wire_type));
+
+		// Encode into a local; the blob_writer may move the buffer as it grows.
+		// Zeroing it keeps padding bytes deterministic.
+		wire_type body;
+		std::memset(&body, 0, sizeof(body));
+		blob_writer blobs {buffer};
+		serializer<T>::encode(value, body, blobs, args...);
+		std::memcpy(buffer.data() + body_offset, &body, sizeof(wire_type));
+
+		const wire_header header {
+			WIRE_MAGIC,
+			WIRE_VERSION,
+			0,
+			wire_type_id(serializer<T>::name),
+			buffer.size(),
+			static_cast<uint32_t>(body_offset),
+			static_cast<uint32_t>(sizeof(wire_type)),
+		};
+		std::memcpy(buffer.data(), &header, sizeof(header));
+		return buffer.size();
+	}
+
+	/**
+	 * @brief A typed, zero-copy view of a serialized message.
+	 *
+	 * Construction validates the header; after that, `body()` is a reference straight into the
+	 * message, and blobs can be read in place through `blobs()`.
+	 *
+	 * \code{.cpp}
+	 * wire_view<imu_cam_type> view {buffer.data(), buffer.size()};
+	 * int64_t time = view.body().time;
+	 * cv::Mat img0 = view.blobs().read(view.body().img0);
+	 * \endcode
+	 */
+	template <typename T>
+	class wire_view {
+	public:
+		using wire_type = typename serializer<T>::wire_type;
+
+		wire_view(const std::byte* message_, std::size_t size_)
+			: message{message_}
+			, size{size_}
+		{
+			if (size < sizeof(wire_header)) {
+				throw std::runtime_error{"message is smaller than its header"};
+			}
+			if (reinterpret_cast<std::uintptr_t>(message) % alignof(wire_type) != 0) {
+				throw std::runtime_error{"message is misaligned"};
+			}
+			const wire_header& h = header();
+			if (h.magic != WIRE_MAGIC || h.version != WIRE_VERSION) {
+				throw std::runtime_error{"not an ILLIXR wire message (or wrong version)"};
+			}
+			if (h.type_id != wire_type_id(serializer<T>::name)) {
+				throw std::runtime_error{std::string{"message does not contain a "} + serializer<T>::name};
+			}
+			if (h.size > size || h.body_size != sizeof(wire_type) || uint64_t{h.body_offset} + h.body_size > h.size
+				|| h.body_offset % alignof(wire_type) != 0) {
+				throw std::runtime_error{std::string{"truncated or corrupt "} + serializer<T>::name};
+			}
+		}
+
+		wire_view(const wire_buffer& buffer)
+			: wire_view{buffer.data(), buffer.size()}
+		{ }
+
+		const wire_header& header() const {
+			return *reinterpret_cast<const wire_header*>(message);
+		}
+
+		const wire_type& body() const {
+			return *reinterpret_cast<const wire_type*>(message + header().body_offset);
+		}
+
+		blob_reader blobs() const {
+			return blob_reader{message, static_cast<std::size_t>(header().size)};
+		}
+
+		/**
+		 * @brief Materializes a `T`. Any images or buffers still point into the message.
+		 */
+		T decode() const {
+			return serializer<T>::decode(body(), blobs());
+		}
+
+	private:
+		const std::byte* message;
+		std::size_t size;
+	};
+
+	template <typename T>
+	T deserialize(const std::byte* message, std::size_t size) {
+		return wire_view<T>{message, size}.decode();
+	}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "cpu_timer.hpp"
+#include "phonebook.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Notices when a threadloop iteration or switchboard callback has been running for too long.
+ *
+ * A plugin that hangs in `_p_one_iteration()` or in a callback does not crash anything; frames just
+ * stop. Components take a `heartbeat` for each thing they run, and beat it as each iteration or
+ * callback starts and stops; the watchdog's own thread checks the heartbeats, and for one that has
+ * been running for too long, logs a `thread_stall` record with the stuck thread's stack.
+ *
+ * The runtime always provides this service; unless `ILLIXR_WATCHDOG` is set, `watch()` returns
+ * nullptr and nothing is watched.
+ */
+class stall_watchdog : public phonebook::service {
+public:
+	/**
+	 * @brief When one component's current iteration (or callback) started, and on which thread.
+	 *
+	 * `start()` and `stop()` are a clock read and a few relaxed stores, so they can go on hot paths.
+	 * Each heartbeat belongs to one component, which runs one iteration at a time (though not
+	 * always on the same thread).
+	 */
+	class heartbeat {
+	public:
+		heartbeat(std::string name_, std::chrono::nanoseconds limit_)
+			: name{std::move(name_)}
+			, limit{limit_}
+		{ }
+
+		void start() {
+			_m_thread_id.store(kernel_thread_id(), std::memory_order_relaxed);
+			_m_started.store(tsc_clock::now().time_since_epoch().count(), std::memory_order_release);
+		}
+
+		void stop() {
+			_m_started.store(0, std::memory_order_release);
+		}
+
+		/**
+		 * @brief When the current iteration started (on `tsc_clock`), or 0 if none is running.
+		 */
+		std::int64_t started() const {
+			return _m_started.load(std::memory_order_acquire);
+		}
+
+		std::size_t thread_id() const {
+			return _m_thread_id.load(std::memory_order_relaxed);
+		}
+
+		const std::string name;
+		// How long an iteration may run before it counts as stalled.
+		const std::chrono::nanoseconds limit;
+
+	private:
+		std::atomic<std::int64_t> _m_started {0};
+		std::atomic<std::size_t> _m_thread_id {0};
+	};
+
+	/**
+	 * @brief Starts watching the component called @p name, whose iterations should take no longer
+	 * than @p budget (0 if it has none).
+	 *
+	 * @return The heartbeat to beat, or nullptr if the watchdog is off. The watchdog stops watching
+	 * once the component drops it.
+	 */
+	virtual std::shared_ptr<heartbeat> watch(const std::string& name, std::chrono::nanoseconds budget) = 0;
+
+	/**
+	 * @brief Stops the watchdog's thread.
+	 */
+	virtual void stop() = 0;
+
+	virtual ~stall_watchdog() { }
+};
+
+}
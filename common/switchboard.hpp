@@ -6,6 +6,7 @@
 #include <functional>
 #include "phonebook.hpp"
 #include "cpu_timer.hpp"
+#include "wakeup.hpp"
 
 namespace ILLIXR {
 
@@ -117,6 +118,9 @@ private:
 	virtual
 	void _p_schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const void*)> fn, std::size_t ty) = 0;
 
+	virtual
+	void _p_watch(const std::string& topic_name, wakeup* w, std::size_t ty) = 0;
+
 	/* TODO: (usability) add a method which queries if a topic has a writer. Readers might assert this. */
 
 public:
@@ -165,6 +169,24 @@ public:
 		return std::move(std::unique_ptr<reader_latest<event>>(reinterpret_cast<reader_latest<event>*>(void_writer.release())));
 	}
 
+	/**
+	 * @brief Notifies @p w every time an event is published to @p topic_name, until `unwatch()`.
+	 *
+	 * This lets a thread sleep until a topic updates, rather than polling `get_latest_ro()`; see
+	 * `threadloop::wake_on()`. This is safe to be called from any thread.
+	 *
+	 * @throws If topic already exists, and its type does not match the @p event.
+	 */
+	template <typename event>
+	void watch(const std::string& topic_name, wakeup& w) {
+		_p_watch(topic_name, &w, typeid(event).hash_code());
+	}
+
+	/**
+	 * @brief Stops notifying @p w of events on @p topic_name. Once this returns, @p w may be destroyed.
+	 */
+	virtual void unwatch(const std::string& topic_name, wakeup& w) = 0;
+
 	virtual ~switchboard() { }
 
 	virtual void stop() = 0;
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include "../columnar_log.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRColumnarLog : public ::testing::Test { };
+
+using time_point = std::chrono::high_resolution_clock::time_point;
+
+/**
+ * Rows of (std::size_t, bool, double, time_point, std::string), as a block_encoder source.
+ */
+struct test_rows {
+	std::vector<std::size_t> ids;
+	std::vector<bool> flags;
+	std::vector<double> values;
+	std::vector<time_point> times;
+	std::vector<std::string> names;
+
+	template <typename T>
+	T get(std::size_t row, unsigned column) const {
+		if constexpr (std::is_same_v<T, std::size_t>) {
+			return ids[row];
+		} else if constexpr (std::is_same_v<T, bool>) {
+			return flags[row];
+		} else if constexpr (std::is_same_v<T, double>) {
+			return values[row];
+		} else if constexpr (std::is_same_v<T, time_point>) {
+			return times[row];
+		} else if constexpr (std::is_same_v<T, std::string>) {
+			return names[row];
+		} else {
+			throw std::logic_error{"unexpected column " + std::to_string(column)};
+		}
+	}
+};
+
+static const std::vector<columnar::column_type> test_types {
+	columnar::column_type::u64,
+	columnar::column_type::boolean,
+	columnar::column_type::f64,
+	columnar::column_type::time_point_ns,
+	columnar::column_type::string,
+};
+
+static int64_t ns(time_point t) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+TEST_F(ILLIXRColumnarLog, RoundTrip) {
+	const time_point start = std::chrono::high_resolution_clock::now();
+	test_rows rows;
+	for (std::size_t i = 0; i < 10; ++i) {
+		rows.ids.push_back(i * 3);
+		rows.flags.push_back(i % 3 == 0);
+		rows.values.push_back(i * 0.5);
+		rows.names.push_back(std::string(i, 'x'));
+		// Rows 0-4 are close together (32-bit deltas); rows 5-9 are minutes apart (64-bit deltas).
+		rows.times.push_back(start + (i < 5 ? std::chrono::microseconds{i} : std::chrono::minutes{i}));
+	}
+
+	std::vector<std::byte> file (columnar::HEADER_BYTES + columnar::EXTENT_BYTES);
+	std::vector<std::byte> header = columnar::encode_file_header("test_table", {
+		{"id", test_types[0]}, {"flag", test_types[1]}, {"value", test_types[2]}, {"time", test_types[3]}, {"name", test_types[4]},
+	});
+	std::copy(header.begin(), header.end(), file.begin());
+
+	columnar::block_encoder encoder {test_types};
+	std::vector<uint8_t> widths;
+	std::size_t offset = columnar::HEADER_BYTES;
+	for (std::size_t first : {0, 5}) {
+		std::size_t size = encoder.measure(rows, first, 5, widths);
+		EXPECT_EQ(widths[3], first == 0 ? 4 : 8);
+		EXPECT_EQ(size % 8, 0u);
+		encoder.encode(rows, first, 5, widths, 1234, file.data() + offset, size);
+		offset += size;
+	}
+
+	columnar::reader log {file.data(), file.size()};
+	EXPECT_EQ(log.get_name(), "test_table");
+	EXPECT_EQ(log.get_column_names(), (std::vector<std::string>{"id", "flag", "value", "time", "name"}));
+	EXPECT_EQ(log.get_column_types(), test_types);
+
+	std::size_t row = 0;
+	log.for_each_block([&](const columnar::block_view& block) {
+		EXPECT_EQ(block.tid(), 1234u);
+		std::vector<int64_t> ids = block.integers(0);
+		std::vector<int64_t> flags = block.integers(1);
+		std::vector<double> values = block.doubles(2);
+		std::vector<int64_t> times = block.integers(3);
+		std::vector<std::string_view> names = block.strings(4);
+		for (std::size_t i = 0; i < block.rows(); ++i, ++row) {
+			EXPECT_EQ(ids[i], static_cast<int64_t>(rows.ids[row]));
+			EXPECT_EQ(flags[i], rows.flags[row]);
+			EXPECT_EQ(values[i], rows.values[row]);
+			EXPECT_EQ(times[i], ns(rows.times[row]));
+			EXPECT_EQ(names[i], rows.names[row]);
+		}
+	});
+	EXPECT_EQ(row, 10u);
+}
+
+TEST_F(ILLIXRColumnarLog, RejectsGarbage) {
+	std::vector<std::byte> file (columnar::HEADER_BYTES);
+	EXPECT_THROW((columnar::reader{file.data(), file.size()}), std::runtime_error);
+	EXPECT_THROW((columnar::reader{file.data(), 3}), std::runtime_error);
+
+	// A valid schema, but a layout no writer uses: an extent_bytes of 0 would never advance, and a
+	// small header_bytes would read the schema as blocks.
+	const std::vector<std::byte> header = columnar::encode_file_header("test_table", {{"id", columnar::column_type::u64}});
+	std::copy(header.begin(), header.end(), file.begin());
+	file.resize(columnar::HEADER_BYTES + columnar::EXTENT_BYTES);
+	EXPECT_NO_THROW((columnar::reader{file.data(), file.size()}));
+	for (auto [header_bytes, extent_bytes] : {
+			std::pair<uint32_t, uint32_t>{columnar::HEADER_BYTES, 0},
+			std::pair<uint32_t, uint32_t>{sizeof(columnar::file_header), columnar::EXTENT_BYTES},
+			std::pair<uint32_t, uint32_t>{0, columnar::EXTENT_BYTES},
+		}) {
+		std::vector<std::byte> bad = file;
+		columnar::file_header fh;
+		std::memcpy(&fh, bad.data(), sizeof(fh));
+		fh.header_bytes = header_bytes;
+		fh.extent_bytes = extent_bytes;
+		std::memcpy(bad.data(), &fh, sizeof(fh));
+		EXPECT_THROW((columnar::reader{bad.data(), bad.size()}), std::runtime_error);
+	}
+}
+
+}
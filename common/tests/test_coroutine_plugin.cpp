@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include "../coroutine_plugin.hpp"
+
+// Only built with C++20: `make -C common tests/run` also builds this file alone with a compiler
+// that has coroutines, if it finds one (see CPP20_CXX in common.mk).
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <map>
+
+#include "test_services.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRCoroutinePlugin : public ::testing::Test { };
+
+/**
+ * Just enough of a switchboard for `events`: the latest event of each topic, and its watchers.
+ * Topics have to be declared with their type first.
+ */
+class latest_only_switchboard : public switchboard {
+public:
+	template <typename event>
+	void declare(const std::string& topic_name) {
+		const std::lock_guard lock {mutex};
+		topic& t = topics[topic_name];
+		t.make_reader = [&t] {
+			// Deleted as what it is, by the unique_ptr<reader_latest<event>> subscribe_latest() makes of it.
+			return reinterpret_cast<reader_latest<void>*>(new reader<event>{t});
+		};
+	}
+
+	template <typename event>
+	void put(const std::string& topic_name, const event* e) {
+		std::vector<wakeup*> to_notify;
+		{
+			const std::lock_guard lock {mutex};
+			topics[topic_name].latest.store(e);
+			to_notify = topics[topic_name].watchers;
+		}
+		for (wakeup* w : to_notify) {
+			w->notify();
+		}
+	}
+
+	virtual void unwatch(const std::string& topic_name, wakeup& w) override {
+		const std::lock_guard lock {mutex};
+		std::vector<wakeup*>& watchers = topics[topic_name].watchers;
+		watchers.erase(std::remove(watchers.begin(), watchers.end(), &w), watchers.end());
+	}
+
+	virtual void stop() override { }
+
+private:
+	struct topic {
+		std::atomic<const void*> latest {nullptr};
+		std::vector<wakeup*> watchers;
+		std::function<reader_latest<void>*()> make_reader;
+	};
+
+	template <typename event>
+	class reader : public reader_latest<event> {
+	public:
+		explicit reader(topic& t_)
+			: t{t_}
+		{ }
+
+		virtual const event* get_latest_ro() const override {
+			return static_cast<const event*>(t.latest.load());
+		}
+
+		virtual event* get_latest() const override {
+			return nullptr;
+		}
+
+	private:
+		topic& t;
+	};
+
+	virtual std::unique_ptr<writer<void>> _p_publish(const std::string&, std::size_t) override {
+		return nullptr;
+	}
+
+	virtual std::unique_ptr<reader_latest<void>> _p_subscribe_latest(const std::string& topic_name, std::size_t) override {
+		const std::lock_guard lock {mutex};
+		return std::unique_ptr<reader_latest<void>>{topics.at(topic_name).make_reader()};
+	}
+
+	virtual void _p_schedule(std::size_t, const std::string&, std::function<void(const void*)>, std::size_t) override { }
+
+	virtual void _p_watch(const std::string& topic_name, wakeup* w, std::size_t) override {
+		const std::lock_guard lock {mutex};
+		topics[topic_name].watchers.push_back(w);
+	}
+
+	std::mutex mutex;
+	std::map<std::string, topic> topics;
+};
+
+/**
+ * Counts events on "numbers", and sleeps for a millisecond after each, until it has seen `wanted`.
+ */
+class counter : public coroutine_plugin {
+public:
+	counter(phonebook* pb_, std::size_t wanted_)
+		: coroutine_plugin{"counter", pb_}
+		, numbers{*this, "numbers"}
+		, wanted{wanted_}
+	{ }
+
+	std::atomic<std::size_t> seen {0};
+	std::atomic<std::size_t> sum {0};
+	std::atomic<bool> finished {false};
+	std::vector<std::size_t> threads;
+
+protected:
+	virtual task<> run() override {
+		while (seen.load() < wanted && !should_terminate()) {
+			const std::size_t* number = co_await numbers.next();
+			if (!number) {
+				break;
+			}
+			sum += co_await twice(*number);
+			threads.push_back(kernel_thread_id());
+			const time_point until = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds{1};
+			co_await sleep_until(until);
+			EXPECT_GE(std::chrono::high_resolution_clock::now(), until);
+			++seen;
+		}
+		finished = true;
+	}
+
+private:
+	task<std::size_t> twice(std::size_t number) {
+		co_return 2 * number;
+	}
+
+	events<std::size_t> numbers;
+	const std::size_t wanted;
+};
+
+/**
+ * Notes whether its coroutine's frame was destroyed, while it waits for an event that never comes.
+ */
+class forever : public coroutine_plugin {
+public:
+	forever(phonebook* pb_)
+		: coroutine_plugin{"forever", pb_}
+		, never{*this, "never"}
+	{ }
+
+	std::atomic<bool> waiting {false};
+	std::atomic<bool> destroyed {false};
+
+protected:
+	virtual task<> run() override {
+		struct on_destroy {
+			std::atomic<bool>& flag;
+			~on_destroy() {
+				flag = true;
+			}
+		} guard {destroyed};
+		waiting = true;
+		co_await poll_until([] { return false; }, std::chrono::milliseconds{1});
+		co_await never.next();
+	}
+
+private:
+	events<int> never;
+};
+
+static std::shared_ptr<latest_only_switchboard> register_services_and_switchboard(phonebook& pb) {
+	register_services(pb);
+	auto sb = std::make_shared<latest_only_switchboard>();
+	pb.register_impl<switchboard>(sb);
+	sb->declare<std::size_t>("numbers");
+	sb->declare<int>("never");
+	return sb;
+}
+
+static void count_to(counter& c, latest_only_switchboard& sb, std::size_t n) {
+	static const std::vector<std::size_t> numbers {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	for (std::size_t i = 0; i < n; ++i) {
+		sb.put("numbers", &numbers[i]);
+		while (c.seen.load() <= i) {
+			std::this_thread::sleep_for(std::chrono::microseconds{100});
+		}
+	}
+}
+
+TEST_F(ILLIXRCoroutinePlugin, WaitsForEventsAndDeadlines) {
+	phonebook pb;
+	auto sb = register_services_and_switchboard(pb);
+
+	counter c {&pb, 5};
+	c.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds{5});
+	// Nothing was published yet, so it is still waiting.
+	EXPECT_EQ(c.seen.load(), 0);
+	count_to(c, *sb, 5);
+	c.stop();
+
+	EXPECT_TRUE(c.finished.load());
+	EXPECT_EQ(c.sum.load(), 2 * (1 + 2 + 3 + 4 + 5));
+	// One thread of its own.
+	EXPECT_NE(c.threads.front(), kernel_thread_id());
+	EXPECT_EQ(std::count(c.threads.begin(), c.threads.end(), c.threads.front()), 5);
+	EXPECT_EQ(pb.lookup_impl<metrics_registry>()->totals("coroutine/counter/timer_latency").count, 5);
+}
+
+TEST_F(ILLIXRCoroutinePlugin, RunsOnTheExecutor) {
+	phonebook pb;
+	auto sb = register_services_and_switchboard(pb);
+	auto exec = std::make_shared<serial_executor>();
+	pb.register_impl<executor>(exec);
+
+	counter c {&pb, 5};
+	c.start();
+	// Waiting for the first event, so that each one resumes it.
+	std::this_thread::sleep_for(std::chrono::milliseconds{5});
+	count_to(c, *sb, 5);
+	c.stop();
+	exec->stop();
+
+	EXPECT_TRUE(c.finished.load());
+	EXPECT_EQ(c.sum.load(), 2 * (1 + 2 + 3 + 4 + 5));
+	// A task to start, and one for each of the five events and five deadlines.
+	EXPECT_EQ(exec->executed.load(), 11);
+}
+
+TEST_F(ILLIXRCoroutinePlugin, StopDestroysAWaitingCoroutine) {
+	phonebook pb;
+	register_services_and_switchboard(pb);
+
+	forever f {&pb};
+	f.start();
+	while (!f.waiting.load()) {
+		std::this_thread::sleep_for(std::chrono::microseconds{100});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds{5});
+	const auto stop_start = std::chrono::steady_clock::now();
+	f.stop();
+	EXPECT_LT(std::chrono::steady_clock::now() - stop_start, std::chrono::milliseconds{50});
+	EXPECT_TRUE(f.destroyed.load());
+}
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <opencv/cv.hpp>
+#include <vector>
 
 #include "../cpu_timer.hpp"
 
@@ -24,5 +25,48 @@ TEST_F(ILLIXRCommon, CPUTimer) {
 	ASSERT_EQ(i, 12);
 }
 
+TEST_F(ILLIXRCommon, TSCClockTracksHighResolutionClock) {
+	using namespace std::chrono_literals;
+
+	const auto tsc_start = tsc_clock::now();
+	const auto hrc_start = std::chrono::high_resolution_clock::now();
+	// Same epoch: the two agree to well within a millisecond.
+	EXPECT_LT(std::chrono::abs(hrc_start - tsc_start), 1ms);
+
+	tsc_clock::time_point last = tsc_start;
+	for (int i = 0; i < 100000; ++i) {
+		const tsc_clock::time_point t = tsc_clock::now();
+		ASSERT_GE(t, last);
+		last = t;
+	}
+
+	std::this_thread::sleep_for(50ms);
+	const auto tsc_elapsed = tsc_clock::now() - tsc_start;
+	const auto hrc_elapsed = std::chrono::high_resolution_clock::now() - hrc_start;
+	EXPECT_LT(std::chrono::abs(tsc_elapsed - hrc_elapsed), 500us);
+}
+
+TEST_F(ILLIXRCommon, TSCClockStaysOnHighResolutionClockAcrossReanchors) {
+	using namespace std::chrono_literals;
+
+	// Several re-anchors, from several threads at once; each thread's readings never go back.
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([] {
+			tsc_clock::time_point last = tsc_clock::now();
+			const auto stop = std::chrono::steady_clock::now() + 350ms;
+			while (std::chrono::steady_clock::now() < stop) {
+				const tsc_clock::time_point t = tsc_clock::now();
+				ASSERT_GE(t, last);
+				last = t;
+			}
+		});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+	EXPECT_LT(std::chrono::abs(tsc_clock::now() - std::chrono::high_resolution_clock::now()), 100us);
+}
+
 }
 
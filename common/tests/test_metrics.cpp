@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "../metrics.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRMetrics : public ::testing::Test { };
+
+/**
+ * Keeps the metrics_summary rows it is given.
+ */
+class summary_record_logger : public record_logger {
+public:
+	virtual void log(const record& r) override {
+		r.mark_used();
+		names++;
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		EXPECT_EQ(&rh, &__metrics_summary_header);
+		for (std::size_t i = 0; i < count; ++i) {
+			const std::byte* row = rows + i * rh.get_row_size();
+			summaries.push_back({
+				get_row_value<std::size_t>(rh, row, 0),
+				get_row_value<std::size_t>(rh, row, 2),
+				get_row_value<std::chrono::nanoseconds>(rh, row, 4),
+				get_row_value<std::chrono::nanoseconds>(rh, row, 8),
+			});
+		}
+	}
+
+	struct summary {
+		std::size_t histogram_id;
+		std::size_t count;
+		std::chrono::nanoseconds p50;
+		std::chrono::nanoseconds max;
+	};
+
+	std::size_t names = 0;
+	std::vector<summary> summaries;
+};
+
+TEST_F(ILLIXRMetrics, BucketsCoverEveryValue) {
+	std::size_t last_index = 0;
+	for (std::uint64_t value = 0; value < 100000; ++value) {
+		const std::size_t index = histogram::index_of(value);
+		// Monotonic, contiguous, and every value is within its bucket.
+		ASSERT_TRUE(index == last_index || index == last_index + 1) << value;
+		ASSERT_LE(value, histogram::highest_equivalent(index));
+		ASSERT_LE(histogram::highest_equivalent(index) - value, value / 32) << value;
+		last_index = index;
+	}
+	EXPECT_EQ(histogram::index_of(histogram::max_value), histogram::buckets - 1);
+	EXPECT_EQ(histogram::highest_equivalent(histogram::buckets - 1), histogram::max_value);
+}
+
+TEST_F(ILLIXRMetrics, Quantiles) {
+	histogram hist;
+	for (std::uint64_t value = 1; value <= 10000; ++value) {
+		hist.record(value * 1000);
+	}
+	histogram::snapshot snap;
+	hist.take(snap);
+	EXPECT_EQ(snap.count, 10000);
+	EXPECT_EQ(snap.max, 10000000);
+	EXPECT_EQ(snap.mean(), 5000500);
+	EXPECT_NEAR(snap.quantile(0.5), 5000000, 5000000 / 32);
+	EXPECT_NEAR(snap.quantile(0.99), 9900000, 9900000 / 32);
+	EXPECT_EQ(snap.quantile(1.0), 10000000);
+
+	// take() starts a new interval.
+	hist.record(std::chrono::nanoseconds{7});
+	hist.take(snap);
+	EXPECT_EQ(snap.count, 1);
+	EXPECT_EQ(snap.max, 7);
+	EXPECT_EQ(snap.quantile(0.5), 7);
+}
+
+TEST_F(ILLIXRMetrics, RegistryReports) {
+	auto logger = std::make_shared<summary_record_logger>();
+	{
+		// A long period, so that only the explicit and final reports run.
+		metrics_registry registry {logger, std::chrono::hours{1}};
+		histogram& a = registry.get_histogram("a");
+		histogram& b = registry.get_histogram("b");
+		EXPECT_EQ(&registry.get_histogram("a"), &a);
+		EXPECT_EQ(logger->names, 2);
+
+		a.record(std::chrono::microseconds{3});
+		registry.report();
+		ASSERT_EQ(logger->summaries.size(), 1);
+		EXPECT_EQ(logger->summaries[0].histogram_id, 0);
+		EXPECT_EQ(logger->summaries[0].count, 1);
+		EXPECT_EQ(logger->summaries[0].max, std::chrono::microseconds{3});
+
+		b.record(std::chrono::microseconds{5});
+		b.record(std::chrono::microseconds{5});
+	}
+	ASSERT_EQ(logger->summaries.size(), 2);
+	EXPECT_EQ(logger->summaries[1].histogram_id, 1);
+	EXPECT_EQ(logger->summaries[1].count, 2);
+	EXPECT_EQ(logger->summaries[1].p50, std::chrono::microseconds{5});
+}
+
+TEST_F(ILLIXRMetrics, PrometheusText) {
+	auto logger = std::make_shared<summary_record_logger>();
+	metrics_registry registry {logger, std::chrono::hours{1}};
+	histogram& a = registry.get_histogram("a/\"quoted\"");
+	registry.get_histogram("unused");
+	registry.get_gauge("depth").set(3);
+
+	a.record(std::chrono::milliseconds{2});
+	registry.report();
+	a.record(std::chrono::milliseconds{4});
+	registry.report();
+
+	std::ostringstream out;
+	registry.write_prometheus(out);
+	const std::string text = out.str();
+	// Totals span both reports; quantiles are the last report's.
+	EXPECT_NE(text.find("illixr_duration_seconds_count{name=\"a/\\\"quoted\\\"\"} 2\n"), std::string::npos) << text;
+	EXPECT_NE(text.find("illixr_duration_seconds_sum{name=\"a/\\\"quoted\\\"\"} 0.006\n"), std::string::npos) << text;
+	EXPECT_NE(text.find("illixr_duration_max_seconds{name=\"a/\\\"quoted\\\"\"} 0.004\n"), std::string::npos) << text;
+	EXPECT_NE(text.find("quantile=\"0.5\"} 0.004"), std::string::npos) << text;
+	EXPECT_NE(text.find("illixr_gauge{name=\"depth\"} 3\n"), std::string::npos) << text;
+	// Histograms that never saw a value are left out.
+	EXPECT_EQ(text.find("unused"), std::string::npos) << text;
+}
+
+}
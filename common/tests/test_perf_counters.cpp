@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+#include "../perf_counters.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRPerfCounters : public ::testing::Test { };
+
+TEST_F(ILLIXRPerfCounters, CountsOrReadsZero) {
+	std::thread{[] {
+		const perf_counters& counters = perf_counters::this_thread();
+		const perf_counters::values start = counters.read();
+		std::size_t x = 1;
+		for (std::size_t i = 0; i < 1000000; ++i) {
+			x = x * 6364136223846793005u + 1442695040888963407u;
+		}
+		EXPECT_NE(x, 0u);
+		// Sleeping switches this thread out at least once.
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		const perf_counters::values counts = perf_counters::difference(start, counters.read());
+
+		// Where perf events are not permitted, counters read 0; that is not an error.
+		for (std::size_t i = 0; i < perf_counters::count; ++i) {
+			if (!counters.available(static_cast<perf_counters::counter>(i))) {
+				EXPECT_EQ(counts[i], 0u) << "counter " << i;
+			}
+		}
+		if (counters.available(perf_counters::instructions)) {
+			EXPECT_GT(counts[perf_counters::instructions], 1000000u);
+		}
+		if (counters.available(perf_counters::context_switches)) {
+			EXPECT_GE(counts[perf_counters::context_switches], 1u);
+		}
+	}}.join();
+}
+
+TEST_F(ILLIXRPerfCounters, ScalesMultiplexedCounts) {
+	perf_counters::values start {};
+	perf_counters::values stop {};
+	stop[perf_counters::cycles] = 1000;
+	stop[perf_counters::instructions] = 3000;
+	stop[perf_counters::context_switches] = 2;
+
+	// Counted the whole time: as they are.
+	stop[perf_counters::time_enabled] = stop[perf_counters::time_running] = 500;
+	EXPECT_EQ(perf_counters::difference(start, stop)[perf_counters::cycles], 1000u);
+
+	// Counted half the time: the hardware counts double, and keep their ratio.
+	stop[perf_counters::time_running] = 250;
+	perf_counters::values counts = perf_counters::difference(start, stop);
+	EXPECT_EQ(counts[perf_counters::cycles], 2000u);
+	EXPECT_EQ(counts[perf_counters::instructions], 6000u);
+	EXPECT_EQ(counts[perf_counters::context_switches], 2u);
+
+	// Never counted: nothing to scale.
+	stop[perf_counters::time_running] = 0;
+	counts = perf_counters::difference(start, stop);
+	EXPECT_EQ(counts[perf_counters::cycles], 0u);
+	EXPECT_EQ(counts[perf_counters::context_switches], 2u);
+}
+
+TEST_F(ILLIXRPerfCounters, PerThread) {
+	const perf_counters* main_counters = &perf_counters::this_thread();
+	const perf_counters* other_counters = nullptr;
+	std::thread{[&] {
+		other_counters = &perf_counters::this_thread();
+	}}.join();
+	EXPECT_NE(main_counters, other_counters);
+	EXPECT_EQ(main_counters, &perf_counters::this_thread());
+}
+
+}
@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+
+#include "../record_logger.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRRecordLogger : public ::testing::Test { };
+
+using time_point = std::chrono::high_resolution_clock::time_point;
+
+static const record_type<bool, std::size_t, std::chrono::nanoseconds, bool, double, time_point> test_header {"test_table", {
+	"flag",
+	"count",
+	"duration",
+	"other_flag",
+	"value",
+	"when",
+}};
+
+/**
+ * Keeps every bulk flush of rows it is given.
+ */
+class capture_record_logger : public record_logger {
+public:
+	virtual void log(const record& r) override {
+		r.mark_used();
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		EXPECT_EQ(&rh, &test_header);
+		flushes.emplace_back(rows, rows + count * rh.get_row_size());
+	}
+
+	static std::vector<std::byte> pack(const record& r) {
+		std::vector<std::byte> row (r.get_record_header().get_row_size());
+		record_logger::pack_row(r, row.data());
+		return row;
+	}
+
+	std::vector<std::vector<std::byte>> flushes;
+};
+
+TEST_F(ILLIXRRecordLogger, Layout) {
+	using layout = decltype(test_header)::layout;
+	// Each column is naturally aligned, and the row is padded to its alignment.
+	EXPECT_EQ(layout::offsets, (std::array<std::size_t, 6>{0, 8, 16, 24, 32, 40}));
+	EXPECT_EQ(layout::size, 48u);
+	EXPECT_EQ(layout::alignment, 8u);
+
+	EXPECT_TRUE(test_header.has_fixed_layout());
+	EXPECT_EQ(test_header.get_row_size(), 48u);
+	EXPECT_EQ(test_header.get_columns(), 6u);
+	EXPECT_EQ(test_header.get_column_name(2), "duration");
+	EXPECT_EQ(test_header.get_column_type(2), typeid(std::chrono::nanoseconds));
+	EXPECT_EQ(test_header.get_column_offset(4), 32u);
+
+	const record_header dynamic_header {"dynamic_table", {{"name", typeid(std::string)}}};
+	EXPECT_FALSE(dynamic_header.has_fixed_layout());
+}
+
+TEST_F(ILLIXRRecordLogger, RowRoundTrip) {
+	const time_point now = std::chrono::high_resolution_clock::now();
+	decltype(test_header)::row row {true, 42, std::chrono::nanoseconds{7}, false, 0.25, now};
+	EXPECT_EQ(row.get<1>(), 42u);
+	EXPECT_EQ(row.get<5>(), now);
+
+	record r = record_logger::unpack_row(test_header, row.data());
+	EXPECT_EQ(r.get_value<bool>(0), true);
+	EXPECT_EQ(r.get_value<std::size_t>(1), 42u);
+	EXPECT_EQ(r.get_value<std::chrono::nanoseconds>(2), std::chrono::nanoseconds{7});
+	EXPECT_EQ(r.get_value<bool>(3), false);
+	EXPECT_EQ(r.get_value<double>(4), 0.25);
+	EXPECT_EQ(r.get_value<time_point>(5), now);
+
+	std::vector<std::byte> packed = capture_record_logger::pack(r);
+	EXPECT_EQ(get_row_value<std::size_t>(test_header, packed.data(), 1), 42u);
+	EXPECT_EQ(get_row_value<double>(test_header, packed.data(), 4), 0.25);
+	EXPECT_EQ(get_row_value<time_point>(test_header, packed.data(), 5), now);
+}
+
+TEST_F(ILLIXRRecordLogger, TypedCoalescer) {
+	auto logger = std::make_shared<capture_record_logger>();
+	const time_point now = std::chrono::high_resolution_clock::now();
+	{
+		typed_record_coalescer coalescer {logger, test_header, 4};
+		for (std::size_t i = 0; i < 10; ++i) {
+			coalescer.log(i % 2 == 0, i, std::chrono::nanoseconds{i}, false, i * 1.5, now);
+		}
+		// Two full buffers; the remainder is flushed on destruction.
+		EXPECT_EQ(logger->flushes.size(), 2u);
+	}
+	ASSERT_EQ(logger->flushes.size(), 3u);
+	EXPECT_EQ(logger->flushes[2].size(), 2 * test_header.get_row_size());
+
+	std::size_t i = 0;
+	for (const std::vector<std::byte>& flush : logger->flushes) {
+		for (std::size_t offset = 0; offset < flush.size(); offset += test_header.get_row_size(), ++i) {
+			EXPECT_EQ(get_row_value<bool>(test_header, flush.data() + offset, 0), i % 2 == 0);
+			EXPECT_EQ(get_row_value<std::size_t>(test_header, flush.data() + offset, 1), i);
+			EXPECT_EQ(get_row_value<double>(test_header, flush.data() + offset, 4), i * 1.5);
+		}
+	}
+	EXPECT_EQ(i, 10u);
+}
+
+TEST_F(ILLIXRRecordLogger, DefaultRowLogUnpacks) {
+	class record_only_logger : public record_logger {
+	public:
+		virtual void log(const record& r) override {
+			counts.push_back(r.get_value<std::size_t>(1));
+		}
+		std::vector<std::size_t> counts;
+	};
+
+	auto logger = std::make_shared<record_only_logger>();
+	{
+		typed_record_coalescer coalescer {logger, test_header};
+		coalescer.log(true, 3, std::chrono::nanoseconds{0}, true, 0.0, time_point{});
+		coalescer.log(true, 4, std::chrono::nanoseconds{0}, true, 0.0, time_point{});
+	}
+	EXPECT_EQ(logger->counts, (std::vector<std::size_t>{3, 4}));
+}
+
+TEST_F(ILLIXRRecordLogger, SamplerPolicies) {
+	EXPECT_EQ(record_sampler::from_policy("t", "all", true), nullptr);
+	EXPECT_EQ(record_sampler::from_policy("t", "1/1", true), nullptr);
+	// Reservoirs live in typed_record_coalescer, so dynamic records cannot have one.
+	EXPECT_EQ(record_sampler::from_policy("t", "reservoir:8", false), nullptr);
+	EXPECT_EQ(record_sampler::from_policy("t", "reservoir:8", true)->get_n(), 8u);
+
+	EXPECT_FALSE(record_sampler::from_policy("t", "off", true)->sample());
+
+	auto one_in_4 = record_sampler::from_policy("t", "1/4", true);
+	std::vector<bool> sampled;
+	for (int i = 0; i < 8; ++i) {
+		sampled.push_back(one_in_4->sample());
+	}
+	EXPECT_EQ(sampled, (std::vector<bool>{true, false, false, false, true, false, false, false}));
+
+	auto every_minute = record_sampler::from_policy("t", "60s", true);
+	EXPECT_TRUE(every_minute->sample());
+	EXPECT_FALSE(every_minute->sample());
+	EXPECT_EQ(record_sampler::from_policy("t", "250us", true)->get_mode(), record_sampler::mode::period);
+
+	for (const char* bad : {"1/0", "1/x", "reservoir:", "10 ms", "fast"}) {
+		EXPECT_THROW(record_sampler::from_policy("t", bad, true), std::runtime_error) << bad;
+	}
+}
+
+TEST_F(ILLIXRRecordLogger, CoalescerSamples) {
+	class count_logger : public record_logger {
+	public:
+		virtual void log(const record& r) override {
+			r.mark_used();
+		}
+		virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+			for (std::size_t i = 0; i < count; ++i) {
+				counts.push_back(get_row_value<std::size_t>(rh, rows + i * rh.get_row_size(), 0));
+			}
+		}
+		std::vector<std::size_t> counts;
+	};
+
+	record_type<std::size_t> sampled_header {"sampled_table", {"count"}};
+	auto logger = std::make_shared<count_logger>();
+
+	sampled_header.set_sampler(record_sampler::from_policy("sampled_table", "1/3", true));
+	{
+		typed_record_coalescer coalescer {logger, sampled_header};
+		for (std::size_t i = 0; i < 9; ++i) {
+			coalescer.log(i);
+		}
+	}
+	EXPECT_EQ(logger->counts, (std::vector<std::size_t>{0, 3, 6}));
+
+	logger->counts.clear();
+	sampled_header.set_sampler(record_sampler::from_policy("sampled_table", "reservoir:5", true));
+	{
+		typed_record_coalescer coalescer {logger, sampled_header};
+		for (std::size_t i = 0; i < 1000; ++i) {
+			coalescer.log(i);
+		}
+	}
+	ASSERT_EQ(logger->counts.size(), 5u);
+	std::sort(logger->counts.begin(), logger->counts.end());
+	EXPECT_EQ(std::unique(logger->counts.begin(), logger->counts.end()), logger->counts.end());
+	EXPECT_LT(logger->counts.back(), 1000u);
+	// A uniform sample of 1000 is very unlikely to stay within the first 5.
+	EXPECT_GT(logger->counts.back(), 5u);
+
+	// Asked first, the coalescer keeps exactly the rows it said it wants.
+	for (const char* policy : {"1/3", "reservoir:5"}) {
+		logger->counts.clear();
+		sampled_header.set_sampler(record_sampler::from_policy("sampled_table", policy, true));
+		std::vector<std::size_t> wanted;
+		{
+			typed_record_coalescer coalescer {logger, sampled_header};
+			for (std::size_t i = 0; i < 9; ++i) {
+				if (coalescer.wants_row()) {
+					wanted.push_back(i);
+					coalescer.log(i);
+				}
+			}
+		}
+		std::sort(logger->counts.begin(), logger->counts.end());
+		if (std::string{policy} == "1/3") {
+			EXPECT_EQ(logger->counts, (std::vector<std::size_t>{0, 3, 6}));
+		} else {
+			EXPECT_EQ(logger->counts.size(), 5u);
+		}
+		// Every row it keeps was built; a reservoir may have replaced some of them since.
+		EXPECT_TRUE(std::includes(wanted.begin(), wanted.end(), logger->counts.begin(), logger->counts.end())) << policy;
+	}
+}
+
+TEST_F(ILLIXRRecordLogger, OverheadMeter) {
+	class overhead_logger : public record_logger {
+	public:
+		virtual void log(const record& r) override {
+			r.mark_used();
+			ADD_FAILURE() << "Overhead should only go through log_overhead";
+		}
+		virtual void log_overhead(const record& r) override {
+			EXPECT_EQ(r.get_value<std::string>(1), "test_site");
+			calls = r.get_value<std::size_t>(2);
+			sampled_calls = r.get_value<std::size_t>(3);
+			sampled_time = r.get_value<std::chrono::nanoseconds>(4);
+			estimated_time = r.get_value<std::chrono::nanoseconds>(5);
+		}
+		std::size_t calls = 0;
+		std::size_t sampled_calls = 0;
+		std::chrono::nanoseconds sampled_time {0};
+		std::chrono::nanoseconds estimated_time {0};
+	};
+
+	auto logger = std::make_shared<overhead_logger>();
+	{
+		instrumentation_meter meter {logger, "test_site"};
+		for (std::size_t i = 0; i < 2 * instrumentation_meter::sample_period + 2; ++i) {
+			const instrumentation_meter::scope measure {meter};
+			// The meter counts CPU time, so sleeping would not do.
+			for (const auto start = thread_cpu_time(); thread_cpu_time() - start < std::chrono::microseconds{10}; ) { }
+		}
+	}
+	EXPECT_EQ(logger->calls, 2 * instrumentation_meter::sample_period + 2);
+	// The first call, and one in every sample_period after it.
+	EXPECT_EQ(logger->sampled_calls, 3u);
+	EXPECT_GE(logger->sampled_time, std::chrono::microseconds{30});
+	EXPECT_EQ(logger->estimated_time.count(), logger->sampled_time.count() * 130 / 3);
+}
+
+}
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include <opencv/cv.hpp>
+
+#include "../serializer.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRSerializer : public ::testing::Test { };
+
+static time_type some_time(long long ns) {
+	return time_type{std::chrono::duration_cast<time_type::duration>(std::chrono::nanoseconds{ns})};
+}
+
+static pose_type some_pose() {
+	return pose_type{
+		some_time(1234567890),
+		Eigen::Vector3f{1.0f, -2.0f, 3.5f},
+		Eigen::Quaternionf{0.5f, 0.5f, -0.5f, 0.5f},
+	};
+}
+
+static void expect_pose_eq(const pose_type& a, const pose_type& b) {
+	EXPECT_EQ(a.sensor_time, b.sensor_time);
+	EXPECT_EQ(a.position, b.position);
+	EXPECT_EQ(a.orientation.coeffs(), b.orientation.coeffs());
+}
+
+TEST_F(ILLIXRSerializer, ImuCamRoundTrip) {
+	cv::Mat img0 {4, 6, CV_8UC1};
+	for (int row = 0; row < img0.rows; ++row) {
+		for (int col = 0; col < img0.cols; ++col) {
+			img0.ptr(row)[col] = static_cast<unsigned char>(row * 16 + col);
+		}
+	}
+	imu_cam_type in {
+		some_time(42),
+		Eigen::Vector3f{0.1f, 0.2f, 0.3f},
+		Eigen::Vector3f{-9.8f, 0.0f, 0.1f},
+		std::make_optional<cv::Mat*>(&img0),
+		std::nullopt,
+		987654321,
+	};
+
+	wire_buffer buffer;
+	serialize(in, buffer);
+
+	wire_view<imu_cam_type> view {buffer};
+	EXPECT_EQ(view.body().dataset_time, 987654321u);
+	EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&view.body()) % WIRE_ALIGNMENT, 0u);
+	EXPECT_EQ(view.body().img0.data.offset % WIRE_ALIGNMENT, 0u);
+
+	imu_cam_type out = view.decode();
+	EXPECT_EQ(out.time, in.time);
+	EXPECT_EQ(out.angular_v, in.angular_v);
+	EXPECT_EQ(out.linear_a, in.linear_a);
+	EXPECT_EQ(out.dataset_time, in.dataset_time);
+	ASSERT_TRUE(out.img0);
+	EXPECT_FALSE(out.img1);
+
+	// The decoded image points into the message; no pixels were copied.
+	const cv::Mat& img0_out = *out.img0.value();
+	EXPECT_EQ(img0_out.rows, img0.rows);
+	EXPECT_EQ(img0_out.cols, img0.cols);
+	EXPECT_EQ(img0_out.type(), img0.type());
+	EXPECT_GE(reinterpret_cast<const std::byte*>(img0_out.data), buffer.data());
+	EXPECT_LT(reinterpret_cast<const std::byte*>(img0_out.data), buffer.data() + buffer.size());
+	for (int row = 0; row < img0.rows; ++row) {
+		EXPECT_EQ(std::memcmp(img0_out.ptr(row), img0.ptr(row), img0.cols), 0);
+	}
+	delete out.img0.value();
+}
+
+TEST_F(ILLIXRSerializer, PoseRoundTrip) {
+	wire_buffer buffer;
+	serialize(some_pose(), buffer);
+	expect_pose_eq(deserialize<pose_type>(buffer.data(), buffer.size()), some_pose());
+
+	fast_pose_type fast_in {some_pose(), some_time(100), some_time(200)};
+	serialize(fast_in, buffer);
+	fast_pose_type fast_out = deserialize<fast_pose_type>(buffer.data(), buffer.size());
+	expect_pose_eq(fast_out.pose, fast_in.pose);
+	EXPECT_EQ(fast_out.predict_computed_time, fast_in.predict_computed_time);
+	EXPECT_EQ(fast_out.predict_target_time, fast_in.predict_target_time);
+}
+
+TEST_F(ILLIXRSerializer, ImuRawRoundTrip) {
+	imu_raw_type in;
+	in.w_hat = Eigen::Vector3d{1, 2, 3};
+	in.a_hat = Eigen::Vector3d{4, 5, 6};
+	in.w_hat2 = Eigen::Vector3d{7, 8, 9};
+	in.a_hat2 = Eigen::Vector3d{10, 11, 12};
+	for (int i = 0; i < 13; ++i) {
+		in.state_plus[i] = i * 0.5;
+	}
+	in.imu_time = some_time(77);
+
+	wire_buffer buffer;
+	serialize(in, buffer);
+	imu_raw_type out = deserialize<imu_raw_type>(buffer.data(), buffer.size());
+	EXPECT_EQ(out.w_hat, in.w_hat);
+	EXPECT_EQ(out.a_hat, in.a_hat);
+	EXPECT_EQ(out.w_hat2, in.w_hat2);
+	EXPECT_EQ(out.a_hat2, in.a_hat2);
+	EXPECT_EQ(out.state_plus, in.state_plus);
+	EXPECT_EQ(out.imu_time, in.imu_time);
+}
+
+TEST_F(ILLIXRSerializer, RgbDepthRoundTrip) {
+	const unsigned char rgb[] = {1, 2, 3, 4, 5, 6};
+	const unsigned short depth[] = {1000, 2000};
+
+	wire_buffer buffer;
+	serialize(rgb_depth_type{55, rgb, depth}, buffer, serializer<rgb_depth_type>::extent_type{sizeof(rgb), sizeof(depth)});
+	rgb_depth_type out = deserialize<rgb_depth_type>(buffer.data(), buffer.size());
+	EXPECT_EQ(out.time, 55);
+	EXPECT_EQ(std::memcmp(out.rgb, rgb, sizeof(rgb)), 0);
+	EXPECT_EQ(std::memcmp(out.depth, depth, sizeof(depth)), 0);
+}
+
+TEST_F(ILLIXRSerializer, FramesRoundTrip) {
+	wire_buffer buffer;
+
+	rendered_frame frame_in {7, some_pose(), some_time(300), some_time(400)};
+	serialize(frame_in, buffer);
+	rendered_frame frame_out = deserialize<rendered_frame>(buffer.data(), buffer.size());
+	EXPECT_EQ(frame_out.texture_handle, frame_in.texture_handle);
+	expect_pose_eq(frame_out.render_pose, frame_in.render_pose);
+	EXPECT_EQ(frame_out.sample_time, frame_in.sample_time);
+	EXPECT_EQ(frame_out.render_time, frame_in.render_time);
+
+	rendered_frame_alt alt_in {{1, 2}, {0, 1}, {some_pose(), some_time(1), some_time(2)}, some_time(3), some_time(4)};
+	serialize(alt_in, buffer);
+	rendered_frame_alt alt_out = deserialize<rendered_frame_alt>(buffer.data(), buffer.size());
+	EXPECT_EQ(alt_out.texture_handles[1], 2u);
+	EXPECT_EQ(alt_out.swap_indices[1], 1u);
+	expect_pose_eq(alt_out.render_pose.pose, alt_in.render_pose.pose);
+	EXPECT_EQ(alt_out.render_pose.predict_target_time, alt_in.render_pose.predict_target_time);
+	EXPECT_EQ(alt_out.render_time, alt_in.render_time);
+}
+
+TEST_F(ILLIXRSerializer, PlainRoundTrip) {
+	wire_buffer buffer;
+
+	serialize(hologram_input{12}, buffer);
+	EXPECT_EQ(deserialize<hologram_input>(buffer.data(), buffer.size()).seq, 12);
+
+	serialize(hologram_output{13}, buffer);
+	EXPECT_EQ(deserialize<hologram_output>(buffer.data(), buffer.size()).dummy, 13);
+
+	serialize(camera_frame{{14}}, buffer);
+	EXPECT_EQ(deserialize<camera_frame>(buffer.data(), buffer.size()).pixel[0], 14);
+
+	serialize(accel{}, buffer);
+	deserialize<accel>(buffer.data(), buffer.size());
+
+	hmd_physical_info hmd_in {};
+	hmd_in.ipd = 0.064f;
+	hmd_in.K[10] = 3.0f;
+	serialize(hmd_in, buffer);
+	hmd_physical_info hmd_out = deserialize<hmd_physical_info>(buffer.data(), buffer.size());
+	EXPECT_EQ(hmd_out.ipd, hmd_in.ipd);
+	EXPECT_EQ(hmd_out.K[10], hmd_in.K[10]);
+
+	serialize(some_time(999), buffer);
+	EXPECT_EQ(deserialize<time_type>(buffer.data(), buffer.size()), some_time(999));
+
+	using duration_ns = std::chrono::duration<double, std::nano>;
+	serialize(duration_ns{1.5}, buffer);
+	EXPECT_EQ(deserialize<duration_ns>(buffer.data(), buffer.size()).count(), 1.5);
+}
+
+/**
+ * Serializes an imu_cam_type with a 4x6 image, lets @p corrupt change its wire form, and decodes it.
+ */
+template <typename Corrupt>
+static void decode_corrupted(Corrupt corrupt) {
+	cv::Mat img0 {4, 6, CV_8UC1};
+	imu_cam_type in {some_time(42), Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), std::make_optional<cv::Mat*>(&img0), std::nullopt, 0};
+	wire_buffer buffer;
+	serialize(in, buffer);
+	wire_view<imu_cam_type> view {buffer};
+	corrupt(const_cast<serializer<imu_cam_type>::wire_type&>(view.body()));
+	imu_cam_type out = view.decode();
+	delete out.img0.value();
+}
+
+TEST_F(ILLIXRSerializer, RejectsCorruptBlobs) {
+	// Unchanged, it decodes.
+	EXPECT_NO_THROW(decode_corrupted([](auto&) { }));
+	// offset + size wraps around to a small number.
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.data.offset = std::numeric_limits<uint64_t>::max() - 8;
+	}), std::runtime_error);
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.data.size = std::numeric_limits<uint64_t>::max();
+	}), std::runtime_error);
+	// More pixels than the blob holds.
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.rows = 1 << 20;
+	}), std::runtime_error);
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.type = CV_32FC1;
+	}), std::runtime_error);
+	// Dimensions whose product only matches the size once it overflows.
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.rows = std::numeric_limits<int32_t>::max();
+		body.img0.cols = std::numeric_limits<int32_t>::max();
+		body.img0.type = CV_MAKETYPE(CV_32F, 512);
+	}), std::runtime_error);
+	EXPECT_THROW(decode_corrupted([](auto& body) {
+		body.img0.rows = -4;
+		body.img0.cols = -6;
+	}), std::runtime_error);
+
+	// A body that would be read misaligned (there are blob bytes after it, so it is in bounds).
+	cv::Mat img0 {4, 6, CV_8UC1};
+	wire_buffer buffer;
+	serialize(imu_cam_type{some_time(42), Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), std::make_optional<cv::Mat*>(&img0), std::nullopt, 0}, buffer);
+	wire_header header;
+	std::memcpy(&header, buffer.data(), sizeof(header));
+	header.body_offset += 1;
+	ASSERT_LE(uint64_t{header.body_offset} + header.body_size, header.size);
+	std::memcpy(buffer.data(), &header, sizeof(header));
+	EXPECT_THROW((wire_view<imu_cam_type>{buffer}), std::runtime_error);
+}
+
+TEST_F(ILLIXRSerializer, RejectsWrongType) {
+	wire_buffer buffer;
+	serialize(some_pose(), buffer);
+	EXPECT_THROW((wire_view<fast_pose_type>{buffer}), std::runtime_error);
+	EXPECT_THROW((wire_view<pose_type>{buffer.data(), sizeof(wire_header) - 1}), std::runtime_error);
+	EXPECT_THROW((wire_view<pose_type>{buffer.data(), buffer.size() - 1}), std::runtime_error);
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../name_matches.hpp"
+#include "../threadloop.hpp"
+
+namespace ILLIXR {
+
+class discard_record_logger : public record_logger {
+protected:
+	virtual void log(const record& r) override {
+		r.mark_used();
+	}
+
+	virtual void log(const record_header&, const std::byte*, std::size_t) override { }
+};
+
+/**
+ * Runs every task on one thread, in order of submission; each timer sleeps on a thread of its own
+ * and then submits its task, so that the executor's thread stays free.
+ */
+class serial_executor : public executor {
+public:
+	/**
+	 * @param pattern Runs the components whose name matches it (see `name_matches`); all of them by
+	 * default.
+	 */
+	explicit serial_executor(std::string pattern_ = "*")
+		: pattern{std::move(pattern_)}
+		, thread{[this] {
+			std::unique_lock lock {mutex};
+			while (!terminate) {
+				if (tasks.empty()) {
+					cv.wait(lock);
+					continue;
+				}
+				task t = std::move(tasks.front());
+				tasks.pop_front();
+				lock.unlock();
+				t();
+				++executed;
+				lock.lock();
+			}
+		}}
+	{ }
+
+	~serial_executor() override {
+		stop();
+	}
+
+	virtual bool runs(const std::string& name) const override {
+		return name_matches(pattern, name);
+	}
+
+	virtual void submit(task t) override {
+		const std::lock_guard lock {mutex};
+		tasks.push_back(std::move(t));
+		cv.notify_one();
+	}
+
+	virtual void defer(task t) override {
+		submit(std::move(t));
+	}
+
+	virtual void submit_at(time_point when, task t) override {
+		const std::lock_guard lock {mutex};
+		timers.emplace_back([this, when, t] {
+			std::this_thread::sleep_until(when);
+			submit(t);
+		});
+	}
+
+	virtual void stop() override {
+		{
+			const std::lock_guard lock {mutex};
+			terminate = true;
+			cv.notify_one();
+		}
+		if (thread.joinable()) {
+			thread.join();
+		}
+		std::vector<std::thread> started;
+		{
+			const std::lock_guard lock {mutex};
+			started.swap(timers);
+		}
+		for (std::thread& timer : started) {
+			timer.join();
+		}
+	}
+
+	std::atomic<std::size_t> executed {0};
+
+private:
+	const std::string pattern;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<task> tasks;
+	bool terminate = false;
+	std::vector<std::thread> timers;
+	std::thread thread;
+};
+
+/**
+ * Registers what every threadloop looks up: a record_logger (which drops everything), gen_guid and
+ * a metrics_registry.
+ */
+static inline void register_services(phonebook& pb) {
+	auto logger = std::make_shared<discard_record_logger>();
+	pb.register_impl<record_logger>(logger);
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	pb.register_impl<metrics_registry>(std::make_shared<metrics_registry>(logger));
+}
+
+}
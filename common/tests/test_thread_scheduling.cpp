@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "../thread_scheduling.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRThreadScheduling : public ::testing::Test { };
+
+TEST_F(ILLIXRThreadScheduling, AppliesOrFallsBack) {
+	static const std::string spec = "pinned=other@0;realtime*=fifo:10;unpinned=batch";
+
+	std::thread{[] {
+		thread_scheduling::apply("pinned", spec);
+		cpu_set_t cpus;
+		ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+		EXPECT_EQ(CPU_COUNT(&cpus), 1);
+		EXPECT_TRUE(CPU_ISSET(0, &cpus));
+		EXPECT_EQ(sched_getscheduler(0), SCHED_OTHER);
+	}}.join();
+
+	std::thread{[] {
+		// Without CAP_SYS_NICE this cannot be applied, and the thread stays as it was.
+		thread_scheduling::apply("realtime_thread", spec);
+		const int policy = sched_getscheduler(0);
+		EXPECT_TRUE(policy == SCHED_FIFO || policy == SCHED_OTHER);
+	}}.join();
+
+	std::thread{[] {
+		thread_scheduling::apply("unpinned", spec);
+		EXPECT_EQ(sched_getscheduler(0), SCHED_BATCH);
+		thread_scheduling::apply("not configured", spec);
+		EXPECT_EQ(sched_getscheduler(0), SCHED_BATCH);
+	}}.join();
+
+	EXPECT_THROW(thread_scheduling::apply("pinned", "pinned=fifo:1000"), std::runtime_error);
+	EXPECT_THROW(thread_scheduling::apply("pinned", "pinned=other@3-1"), std::runtime_error);
+	EXPECT_THROW(thread_scheduling::apply("pinned", "pinned=deadline:5000/1000/1000"), std::runtime_error);
+}
+
+TEST_F(ILLIXRThreadScheduling, ParsesOnceForManyThreads) {
+	const thread_scheduling::config conf = thread_scheduling::parse_config("pinned=other@0;unpinned=batch");
+	ASSERT_EQ(conf.size(), 2);
+	std::thread{[&conf] {
+		thread_scheduling::apply(conf, "unpinned");
+		EXPECT_EQ(sched_getscheduler(0), SCHED_BATCH);
+	}}.join();
+
+	// The error names the variable it came from.
+	try {
+		thread_scheduling::parse_config("probe=rr:0", "ILLIXR_TIMER_PROBE");
+		ADD_FAILURE();
+	} catch (const std::runtime_error& e) {
+		EXPECT_EQ(std::string{e.what()}.rfind("ILLIXR_TIMER_PROBE ", 0), 0);
+	}
+}
+
+}
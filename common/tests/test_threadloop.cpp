@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "../threadloop.hpp"
+#include "test_services.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRThreadloop : public ::testing::Test { };
+
+/**
+ * Notes the deadline it was given and the time each iteration actually started.
+ */
+class ticker : public periodic_threadloop {
+public:
+	ticker(phonebook* pb_, std::chrono::nanoseconds period_, std::size_t iterations_, std::size_t slow_every_ = 0)
+		: periodic_threadloop{"ticker", pb_, period_}
+		, iterations{iterations_}
+		, slow_every{slow_every_}
+	{ }
+
+	std::vector<time_point> deadlines;
+	std::vector<time_point> starts;
+	std::atomic<std::size_t> done {0};
+
+protected:
+	virtual std::optional<time_point> _p_next_deadline(time_point last) override {
+		std::optional<time_point> next = periodic_threadloop::_p_next_deadline(last);
+		deadlines.push_back(*next);
+		return next;
+	}
+
+	virtual skip_option _p_should_skip_at_deadline() override {
+		return starts.size() < iterations ? skip_option::run : skip_option::skip_and_yield;
+	}
+
+	virtual void _p_one_iteration() override {
+		starts.push_back(std::chrono::high_resolution_clock::now());
+		if (slow_every && starts.size() % slow_every == 0) {
+			std::this_thread::sleep_for(period * 3 / 2);
+		}
+		++done;
+	}
+
+private:
+	const std::size_t iterations;
+	const std::size_t slow_every;
+};
+
+/**
+ * Waits for `wake()` between iterations, or for a deadline if it has one.
+ */
+class waiter : public threadloop {
+public:
+	waiter(phonebook* pb_, std::optional<std::chrono::milliseconds> timeout_ = std::nullopt)
+		: threadloop{"waiter", pb_}
+		, timeout{timeout_}
+	{ }
+
+	std::atomic<std::size_t> wanted {0};
+	std::atomic<std::size_t> done {0};
+	std::atomic<std::size_t> skips {0};
+
+protected:
+	virtual skip_option _p_should_skip() override {
+		if (done.load() < wanted.load()) {
+			return skip_option::run;
+		}
+		++skips;
+		return skip_option::skip_and_wait;
+	}
+
+	virtual std::optional<time_point> _p_wait_deadline() override {
+		if (timeout) {
+			return std::chrono::high_resolution_clock::now() + *timeout;
+		}
+		return std::nullopt;
+	}
+
+	virtual void _p_one_iteration() override {
+		++done;
+	}
+
+private:
+	const std::optional<std::chrono::milliseconds> timeout;
+};
+
+/**
+ * Keeps the heartbeats it hands out, and checks none of them.
+ */
+class keeping_stall_watchdog : public stall_watchdog {
+public:
+	virtual std::shared_ptr<heartbeat> watch(const std::string& name, std::chrono::nanoseconds budget) override {
+		heartbeats.push_back(std::make_shared<heartbeat>(name, budget));
+		return heartbeats.back();
+	}
+
+	virtual void stop() override { }
+
+	std::vector<std::shared_ptr<heartbeat>> heartbeats;
+};
+
+TEST_F(ILLIXRThreadloop, PeriodicDeadlinesAreAbsolute) {
+	phonebook pb;
+	register_services(pb);
+
+	const std::chrono::milliseconds period {2};
+	ticker t {&pb, period, 20};
+	t.start();
+	while (t.done.load() < 20) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	t.stop();
+
+	// However late an iteration runs, the next deadline is one period after the last deadline.
+	for (std::size_t i = 1; i < 20; ++i) {
+		EXPECT_EQ(t.deadlines[i] - t.deadlines[i - 1], period);
+	}
+	// And the iteration never starts before its deadline.
+	for (std::size_t i = 0; i < 20; ++i) {
+		EXPECT_GE(t.starts[i], t.deadlines[i]);
+	}
+	// The sleeps before the deadlines count how late the scheduler woke the thread.
+	EXPECT_GT(pb.lookup_impl<metrics_registry>()->totals("threadloop/ticker/timer_latency").count, 0);
+	// But not as part of the iterations, which take next to no time.
+	const histogram::snapshot wall_time = pb.lookup_impl<metrics_registry>()->totals("threadloop/ticker/wall_time");
+	EXPECT_EQ(wall_time.count, 20);
+	EXPECT_LT(wall_time.quantile(0.5), std::chrono::nanoseconds{period}.count() / 2);
+}
+
+TEST_F(ILLIXRThreadloop, DeadlineMissesAreCounted) {
+	phonebook pb;
+	register_services(pb);
+
+	// Every fifth iteration takes one and a half periods, and so misses its budget of one period.
+	ticker t {&pb, std::chrono::milliseconds{2}, 20, 5};
+	t.start();
+	while (t.done.load() < 20) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	t.stop();
+
+	auto metrics = pb.lookup_impl<metrics_registry>();
+	// At least those four; a busy machine can make others late as well.
+	EXPECT_GE(metrics->totals("threadloop/ticker/overrun").count, 4);
+	EXPECT_EQ(metrics->totals("threadloop/ticker/lateness").count, 20);
+	EXPECT_EQ(metrics->totals("threadloop/ticker/jitter").count, 19);
+}
+
+TEST_F(ILLIXRThreadloop, LoopsWithoutAPeriodDoNotWait) {
+	class unpaced : public periodic_threadloop {
+	public:
+		unpaced(phonebook* pb_)
+			: periodic_threadloop{"unpaced", pb_}
+		{ }
+
+		std::atomic<std::size_t> done {0};
+
+	protected:
+		virtual void _p_one_iteration() override {
+			++done;
+		}
+	};
+
+	phonebook pb;
+	register_services(pb);
+
+	unpaced u {&pb};
+	u.start();
+	while (u.done.load() < 100) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	u.stop();
+	// No deadlines, so nothing was timed.
+	EXPECT_EQ(pb.lookup_impl<metrics_registry>()->totals("threadloop/unpaced/wake_error").count, 0);
+}
+
+TEST_F(ILLIXRThreadloop, WaitingThreadloopsSleepUntilWoken) {
+	phonebook pb;
+	register_services(pb);
+
+	waiter w {&pb};
+	w.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds{50});
+	// Asleep the whole time, rather than polling.
+	EXPECT_LE(w.skips.load(), 2);
+
+	for (std::size_t i = 1; i <= 5; ++i) {
+		w.wanted = i;
+		w.wake();
+		while (w.done.load() < i) {
+			std::this_thread::sleep_for(std::chrono::microseconds{100});
+		}
+	}
+	EXPECT_LE(w.skips.load(), 8);
+
+	// Stopping wakes it too.
+	const auto stop_start = std::chrono::steady_clock::now();
+	w.stop();
+	EXPECT_LT(std::chrono::steady_clock::now() - stop_start, std::chrono::milliseconds{50});
+}
+
+TEST_F(ILLIXRThreadloop, WaitingThreadloopsWakeAtTheirDeadline) {
+	phonebook pb;
+	register_services(pb);
+
+	waiter w {&pb, std::chrono::milliseconds{5}};
+	w.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds{100});
+	w.stop();
+	// About 20 wake-ups; far fewer than polling would make, and more than none.
+	EXPECT_GE(w.skips.load(), 5);
+	EXPECT_LE(w.skips.load(), 25);
+	// Each of them was a timer's.
+	EXPECT_GE(pb.lookup_impl<metrics_registry>()->totals("threadloop/waiter/timer_latency").count, 4);
+}
+
+TEST_F(ILLIXRThreadloop, ThreadloopsCanRunOnTheExecutor) {
+	phonebook pb;
+	register_services(pb);
+	auto exec = std::make_shared<serial_executor>("waiter");
+	pb.register_impl<executor>(exec);
+
+	waiter w {&pb};
+	w.start();
+	for (std::size_t i = 1; i <= 5; ++i) {
+		w.wanted = i;
+		w.wake();
+		while (w.done.load() < i) {
+			std::this_thread::sleep_for(std::chrono::microseconds{100});
+		}
+	}
+	w.stop();
+	// One task per pass of the loop: parked between wake-ups, not polling.
+	EXPECT_EQ(w.done.load(), 5);
+	EXPECT_LE(exec->executed.load(), 5 + w.skips.load() + 1);
+	EXPECT_LE(w.skips.load(), 8);
+}
+
+TEST_F(ILLIXRThreadloop, IterationsBeatTheirHeartbeat) {
+	phonebook pb;
+	register_services(pb);
+	auto watchdog = std::make_shared<keeping_stall_watchdog>();
+	pb.register_impl<stall_watchdog>(watchdog);
+
+	ticker t {&pb, std::chrono::milliseconds{2}, 5};
+	t.start();
+	while (t.done.load() < 5) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	t.stop();
+
+	ASSERT_EQ(watchdog->heartbeats.size(), 1);
+	const stall_watchdog::heartbeat& hb = *watchdog->heartbeats[0];
+	EXPECT_EQ(hb.name, "ticker");
+	EXPECT_EQ(hb.limit, std::chrono::milliseconds{2});
+	// Beaten on the threadloop's thread, and stopped after its last iteration.
+	EXPECT_NE(hb.thread_id(), 0);
+	EXPECT_NE(hb.thread_id(), kernel_thread_id());
+	EXPECT_EQ(hb.started(), 0);
+}
+
+TEST_F(ILLIXRThreadloop, WakeupDoesNotMissNotifications) {
+	wakeup w;
+	std::uint32_t seen = w.sequence();
+	w.notify();
+	// The notification came after the sequence was read, so this returns at once.
+	EXPECT_TRUE(w.wait(seen));
+
+	seen = w.sequence();
+	EXPECT_FALSE(w.wait(seen, std::chrono::high_resolution_clock::now() + std::chrono::milliseconds{1}));
+
+	std::thread notifier {[&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{5});
+		w.notify();
+	}};
+	EXPECT_TRUE(w.wait(seen));
+	notifier.join();
+}
+
+}
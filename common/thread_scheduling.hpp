@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "name_matches.hpp"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+namespace ILLIXR {
+
+/**
+ * @brief Scheduling policy and CPU affinity for named threads, from `ILLIXR_THREAD_SCHEDULING`.
+ *
+ * The variable is a `;`-separated list of `thread=[policy][@cpus]`, where thread may end in `*` to
+ * match a prefix (the first matching entry applies), policy is one of
+ * - `other`, `batch` or `idle`;
+ * - `fifo:P` or `rr:P`, with a real-time priority P (1 to 99);
+ * - `deadline:R/D/T`, SCHED_DEADLINE with a runtime R, deadline D and period T in microseconds;
+ *
+ * and cpus is a list such as `2-3,6`. For example,
+ * `ILLIXR_THREAD_SCHEDULING=timewarp_gl=fifo:80@2-3;switchboard=@0-1;sqlite*=idle@4-7`.
+ *
+ * Threads call `apply` with their own name as they start: each threadloop uses its plugin's name;
+ * the runtime's threads are `switchboard`, `collector`, `metrics`, `metrics_endpoint`, `executor`,
+ * `watchdog`, `sqlite` and `sqlite/<table>`. The runner sets this from its `thread_scheduling` config.
+ *
+ * Real-time policies usually need CAP_SYS_NICE (or an rtprio limit). When a setting cannot be
+ * applied, the thread says so on stderr and carries on as it was; it is never fatal. A malformed
+ * variable is: the runtime parses it with `from_env()` on its main thread, before starting any other.
+ */
+class thread_scheduling {
+public:
+	/**
+	 * @brief Applies the settings for @p thread_name, if any, to the calling thread.
+	 */
+	static void apply(const std::string& thread_name) {
+		try {
+			apply(from_env(), thread_name);
+		} catch (const std::runtime_error& e) {
+			// Only if nothing checked the variable beforehand; a thread should not terminate the program over it.
+			std::cerr << "thread_scheduling: " << e.what() << "; leaving " << thread_name << " as it was" << std::endl;
+		}
+	}
+
+	/**
+	 * @brief Applies the settings for @p thread_name in @p spec (in the format above) to the calling thread.
+	 */
+	static void apply(const std::string& thread_name, const std::string& spec) {
+		apply(parse_config(spec), thread_name);
+	}
+
+private:
+	// Not in glibc's headers (before 2.41), but stable kernel ABI.
+	struct sched_attr_t {
+		std::uint32_t size;
+		std::uint32_t sched_policy;
+		std::uint64_t sched_flags;
+		std::int32_t sched_nice;
+		std::uint32_t sched_priority;
+		std::uint64_t sched_runtime;
+		std::uint64_t sched_deadline;
+		std::uint64_t sched_period;
+	};
+
+	struct setting {
+		std::optional<int> policy;
+		int priority = 0;
+		std::uint64_t runtime_ns = 0;
+		std::uint64_t deadline_ns = 0;
+		std::uint64_t period_ns = 0;
+		std::optional<cpu_set_t> cpus;
+		std::string description;
+
+		void apply(const std::string& thread_name) const {
+			bool ok = true;
+			if (policy) {
+				int ret;
+				if (*policy == SCHED_DEADLINE) {
+					sched_attr_t attr {};
+					attr.size = sizeof(attr);
+					attr.sched_policy = SCHED_DEADLINE;
+					attr.sched_runtime = runtime_ns;
+					attr.sched_deadline = deadline_ns;
+					attr.sched_period = period_ns;
+					ret = syscall(SYS_sched_setattr, 0, &attr, 0);
+				} else {
+					const sched_param param {priority};
+					ret = sched_setscheduler(0, *policy, &param);
+				}
+				if (ret != 0) {
+					ok = false;
+					std::cerr << "thread_scheduling: cannot set " << thread_name << " to " << description << " (" << std::strerror(errno)
+							  << "); leaving its policy as it was" << std::endl;
+				}
+			}
+			if (cpus && sched_setaffinity(0, sizeof(*cpus), &*cpus) != 0) {
+				// SCHED_DEADLINE threads, in particular, may not be restricted to fewer CPUs than their root domain.
+				ok = false;
+				std::cerr << "thread_scheduling: cannot pin " << thread_name << " (" << std::strerror(errno) << "); leaving it on all CPUs" << std::endl;
+			}
+			if (ok) {
+				std::cerr << "thread_scheduling: " << thread_name << " is " << description << std::endl;
+			}
+		}
+	};
+
+public:
+	/**
+	 * @brief Parsed settings, which any number of threads can apply without parsing (or failing) again.
+	 */
+	using config = std::vector<std::pair<std::string, setting>>;
+
+	/**
+	 * @brief Parses @p spec (in the format above); throws `std::runtime_error`, naming @p variable, if it is malformed.
+	 */
+	static config parse_config(const std::string& spec, const std::string& variable = "ILLIXR_THREAD_SCHEDULING") {
+		config ret;
+		std::istringstream entries {spec};
+		std::string entry;
+		while (std::getline(entries, entry, ';')) {
+			if (entry.empty()) {
+				continue;
+			}
+			const std::size_t equals = entry.find('=');
+			if (equals == std::string::npos) {
+				throw std::runtime_error{variable + " entries should be thread=policy@cpus, not " + entry};
+			}
+			ret.emplace_back(entry.substr(0, equals), parse(entry.substr(equals + 1), variable));
+		}
+		return ret;
+	}
+
+	/**
+	 * @brief The settings in `ILLIXR_THREAD_SCHEDULING`, parsed on the first call.
+	 *
+	 * Throws `std::runtime_error` if it is malformed, until it is fixed, so call it first on the main thread.
+	 */
+	static const config& from_env() {
+		static const config conf = [] {
+			const char* spec = std::getenv("ILLIXR_THREAD_SCHEDULING");
+			return parse_config(spec ? spec : "");
+		}();
+		return conf;
+	}
+
+	/**
+	 * @brief Applies the settings for @p thread_name in @p conf, if any, to the calling thread.
+	 */
+	static void apply(const config& conf, const std::string& thread_name) {
+		for (const auto& [pattern, setting] : conf) {
+			if (name_matches(pattern, thread_name)) {
+				setting.apply(thread_name);
+				return;
+			}
+		}
+	}
+
+private:
+	static setting parse(const std::string& spec, const std::string& variable) {
+		const auto bad = [&] {
+			return std::runtime_error{variable + " has a bad setting: " + spec};
+		};
+		const auto number = [&](const std::string& str) {
+			std::size_t end = 0;
+			unsigned long ret = 0;
+			try {
+				ret = std::stoul(str, &end);
+			} catch (const std::logic_error&) { }
+			if (end != str.size() || str.empty()) {
+				throw bad();
+			}
+			return ret;
+		};
+
+		setting ret;
+		const std::size_t at = spec.find('@');
+		const std::string policy = spec.substr(0, at);
+		const std::size_t colon = policy.find(':');
+		const std::string name = policy.substr(0, colon);
+		const std::string args = colon == std::string::npos ? "" : policy.substr(colon + 1);
+		if (false) {
+		} else if (policy.empty()) {
+		} else if (policy == "other") {
+			ret.policy = SCHED_OTHER;
+		} else if (policy == "batch") {
+			ret.policy = SCHED_BATCH;
+		} else if (policy == "idle") {
+			ret.policy = SCHED_IDLE;
+		} else if ((name == "fifo" || name == "rr") && !args.empty()) {
+			ret.policy = name == "fifo" ? SCHED_FIFO : SCHED_RR;
+			ret.priority = number(args);
+			if (ret.priority < sched_get_priority_min(*ret.policy) || ret.priority > sched_get_priority_max(*ret.policy)) {
+				throw bad();
+			}
+		} else if (name == "deadline") {
+			const std::size_t slash1 = args.find('/');
+			const std::size_t slash2 = slash1 == std::string::npos ? slash1 : args.find('/', slash1 + 1);
+			if (slash2 == std::string::npos) {
+				throw bad();
+			}
+			ret.policy = SCHED_DEADLINE;
+			ret.runtime_ns = number(args.substr(0, slash1)) * 1000;
+			ret.deadline_ns = number(args.substr(slash1 + 1, slash2 - slash1 - 1)) * 1000;
+			ret.period_ns = number(args.substr(slash2 + 1)) * 1000;
+			if (!(ret.runtime_ns <= ret.deadline_ns && ret.deadline_ns <= ret.period_ns) || !ret.runtime_ns) {
+				throw bad();
+			}
+		} else {
+			throw bad();
+		}
+		ret.description = policy;
+
+		if (at != std::string::npos) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			std::istringstream ranges {spec.substr(at + 1)};
+			std::string range;
+			while (std::getline(ranges, range, ',')) {
+				const std::size_t dash = range.find('-');
+				const unsigned long first = number(range.substr(0, dash));
+				const unsigned long last = dash == std::string::npos ? first : number(range.substr(dash + 1));
+				if (last < first || last >= CPU_SETSIZE) {
+					throw bad();
+				}
+				for (unsigned long cpu = first; cpu <= last; ++cpu) {
+					CPU_SET(cpu, &cpus);
+				}
+			}
+			if (!CPU_COUNT(&cpus)) {
+				throw bad();
+			}
+			ret.cpus = cpus;
+			ret.description += (policy.empty() ? "on CPUs " : " on CPUs ") + spec.substr(at + 1);
+		}
+		return ret;
+	}
+};
+
+}
@@ -4,20 +4,170 @@
 #include <iostream>
 #include <future>
 #include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <optional>
+#include <type_traits>
+#include <vector>
 #include "plugin.hpp"
 #include "cpu_timer.hpp"
+#include "executor.hpp"
+#include "metrics.hpp"
+#include "perf_counters.hpp"
+#include "stall_watchdog.hpp"
+#include "switchboard.hpp"
+#include "thread_scheduling.hpp"
+#include "wakeup.hpp"
 
 namespace ILLIXR {
 
-const record_header __threadloop_iteration_header {"threadloop_iteration", {
-	{"plugin_id", typeid(std::size_t)},
-	{"iteration_no", typeid(std::size_t)},
-	{"skips", typeid(std::size_t)},
-	{"cpu_time_start", typeid(std::chrono::nanoseconds)},
-	{"cpu_time_stop" , typeid(std::chrono::nanoseconds)},
-	{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
-	{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
-}};
+const record_type<
+	std::size_t,
+	std::size_t,
+	std::size_t,
+	std::chrono::nanoseconds,
+	std::chrono::nanoseconds,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::size_t,
+	std::size_t,
+	std::size_t,
+	std::size_t,
+	std::size_t,
+	std::size_t
+> __threadloop_iteration_header {"threadloop_iteration", {
+	"plugin_id",
+	"iteration_no",
+	"skips",
+	"cpu_time_start",
+	"cpu_time_stop",
+	"wall_time_start",
+	"wall_time_stop",
+	"thread_id",
+	// From perf_counters, over the iteration; 0 unless ILLIXR_PERF_COUNTERS is set.
+	"cycles",
+	"instructions",
+	"llc_misses",
+	"branch_misses",
+	"context_switches",
+}, record_verbosity::detailed};
+
+const record_type<
+	std::size_t,
+	std::size_t,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::nanoseconds,
+	std::chrono::nanoseconds
+> __threadloop_wakeup_header {"threadloop_wakeup", {
+	"plugin_id",
+	"iteration_no",
+	"deadline",
+	"wake_time",
+	"wake_error",
+	"spin_time",
+}, record_verbosity::detailed};
+
+const record_type<
+	std::size_t,
+	std::size_t,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::nanoseconds
+> __threadloop_deadline_miss_header {"threadloop_deadline_miss", {
+	"plugin_id",
+	"iteration_no",
+	"deadline",
+	"wall_time_start",
+	"wall_time_stop",
+	"overrun",
+}, record_verbosity::normal};
+
+/**
+ * @brief Lateness, jitter and budget overruns of one threadloop's iterations.
+ *
+ * For each iteration:
+ * - lateness: how long after its deadline it started (only for iterations with a deadline);
+ * - jitter: how far the time since the previous start is from the expected interval, which is
+ *   the time between their deadlines if both had one, else the threadloop's period;
+ * - overrun: how far past its deadline (or start, without one) plus the budget it finished. Only
+ *   positive overruns, the deadline misses, are recorded, and each is also logged as a
+ *   `threadloop_deadline_miss` row.
+ */
+class threadloop_timing {
+public:
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	threadloop_timing(metrics_registry& metrics, const std::shared_ptr<record_logger>& logger, const std::string& name_,
+					  std::chrono::nanoseconds period_, std::chrono::nanoseconds budget_)
+		: period{period_}
+		, budget{budget_}
+		, lateness_hist{metrics.get_histogram(histogram_name(name_, "lateness"))}
+		, jitter_hist{metrics.get_histogram(histogram_name(name_, "jitter"))}
+		, overrun_hist{metrics.get_histogram(histogram_name(name_, "overrun"))}
+		, miss_log{logger, __threadloop_deadline_miss_header}
+	{ }
+
+	void account(std::size_t plugin_id, std::size_t iteration_no, std::optional<time_point> deadline, time_point start, time_point stop) {
+		if (deadline) {
+			lateness_hist.record(start - *deadline);
+		}
+		if (last_start) {
+			const std::chrono::nanoseconds expected = deadline && last_deadline ? *deadline - *last_deadline : period;
+			if (expected.count() > 0) {
+				const std::chrono::nanoseconds interval = start - *last_start;
+				jitter_hist.record(interval > expected ? interval - expected : expected - interval);
+			}
+		}
+		if (budget.count() > 0) {
+			const time_point due = deadline.value_or(start) + budget;
+			if (stop > due) {
+				overrun_hist.record(stop - due);
+				miss_log.log(plugin_id, iteration_no, deadline.value_or(start), start, stop, stop - due);
+			}
+		}
+		last_start = start;
+		last_deadline = deadline;
+	}
+
+	static std::string histogram_name(const std::string& name, const std::string& what) {
+		return "threadloop/" + name + "/" + what;
+	}
+
+	/**
+	 * @brief Prints the deadline misses and the lateness, jitter and timer latency percentiles of the whole run.
+	 */
+	static void print_summary(metrics_registry& metrics, const std::string& name, std::chrono::nanoseconds budget) {
+		const histogram::snapshot iterations = metrics.totals(histogram_name(name, "wall_time"));
+		std::cerr << "Timing of " << name << ": " << iterations.count << " iterations";
+		if (budget.count() > 0) {
+			const histogram::snapshot overrun = metrics.totals(histogram_name(name, "overrun"));
+			std::cerr << "; " << overrun.count << " deadline misses (budget " << budget.count() * 1e-3 << "us)";
+			if (overrun.count) {
+				std::cerr << ", overrun p50 " << overrun.quantile(0.5) * 1e-3 << "us max " << overrun.max * 1e-3 << "us";
+			}
+		}
+		for (const char* what : {"lateness", "jitter", "timer_latency"}) {
+			const histogram::snapshot values = metrics.totals(histogram_name(name, what));
+			if (values.count) {
+				std::cerr << "; " << what << " p50 " << values.quantile(0.5) * 1e-3 << "us p99 " << values.quantile(0.99) * 1e-3
+						  << "us p99.9 " << values.quantile(0.999) * 1e-3 << "us max " << values.max * 1e-3 << "us";
+			}
+		}
+		std::cerr << std::endl;
+	}
+
+private:
+	const std::chrono::nanoseconds period;
+	const std::chrono::nanoseconds budget;
+	histogram& lateness_hist;
+	histogram& jitter_hist;
+	histogram& overrun_hist;
+	decltype(__threadloop_deadline_miss_header)::coalescer miss_log;
+	std::optional<time_point> last_start;
+	std::optional<time_point> last_deadline;
+};
 
 /**
  * @brief A reusable threadloop for plugins.
@@ -25,17 +175,38 @@ const record_header __threadloop_iteration_header {"threadloop_iteration", {
  * The thread continuously runs `_p_one_iteration()` and is stopable by `stop()`.
  *
  * This factors out the common code I noticed in many different plugins.
+ *
+ * If `ILLIXR_EXECUTOR` names the plugin, the loop runs as a task on the shared `executor` instead of
+ * a thread of its own: each pass of the loop is one task, which requeues itself behind the others
+ * (or, after `skip_and_wait`, is requeued when woken). Nothing in the subclass changes, except that
+ * consecutive iterations may run on different threads, so thread-local state such as a GL context
+ * does not carry over; such plugins set `own_thread`.
  */
 class threadloop : public plugin {
 public:
-	threadloop(std::string name_, phonebook* pb_) : plugin(name_, pb_) { }
+	threadloop(std::string name_, phonebook* pb_)
+		: plugin(name_, pb_)
+		, metrics_{pb_->lookup_impl<metrics_registry>()}
+	{ }
 
 	/**
 	 * @brief Starts the thread.
 	 */
 	virtual void start() override {
 		plugin::start();
-		_m_thread = std::thread(std::bind(&threadloop::thread_main, this));
+		if (pb->has_impl<stall_watchdog>()) {
+			_m_heartbeat = pb->lookup_impl<stall_watchdog>()->watch(name, budget);
+		}
+		if (!own_thread && pb->has_impl<executor>() && pb->lookup_impl<executor>()->runs(name)) {
+			_m_task = std::make_shared<pooled_task>(this, pb->lookup_impl<executor>());
+			_m_wake_listener = [task = _m_task] {
+				task->resume();
+			};
+			_m_wakeup.set_listener(&_m_wake_listener);
+			_m_task->schedule();
+		} else {
+			_m_thread = std::thread(std::bind(&threadloop::thread_main, this));
+		}
 	}
 
 	/**
@@ -44,8 +215,19 @@ public:
 	virtual void stop() override {
 		if (! _m_terminate.load()) {
 			_m_terminate.store(true);
-			_m_thread.join();
+			_m_wakeup.notify();
+			if (_m_task) {
+				_m_task->finished.wait();
+			} else {
+				_m_thread.join();
+			}
 			std::cerr << "Joined " << name << std::endl;
+			for (const std::string& topic_name : _m_watched) {
+				pb->lookup_impl<switchboard>()->unwatch(topic_name, _m_wakeup);
+			}
+			if (timing) {
+				threadloop_timing::print_summary(*metrics_, name, budget);
+			}
 			plugin::stop();
 		} else {
 			std::cerr << "You called stop() on this plugin twice." << std::endl;
@@ -59,79 +241,285 @@ public:
 		}
 	}
 
+	/**
+	 * @brief Wakes the thread if it is in `skip_and_wait`, so that it checks `_p_should_skip()` again.
+	 * Safe to call from any thread.
+	 */
+	void wake() {
+		_m_wakeup.notify();
+	}
+
 protected:
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	enum class skip_option {
+		/// Run iteration NOW. Only then does CPU timer begin counting.
+		run,
+
+		/// AKA "busy wait". Skip but try again very quickly.
+		skip_and_spin,
+
+		/// Yielding gives up a scheduling quantum, which is determined by the OS, but usually on
+		/// the order of 1-10ms. This is nicer to the other threads in the system.
+		skip_and_yield,
+
+		/// Sleep until a topic from `wake_on()` gets an event, `wake()` is called, the
+		/// `_p_wait_deadline()` passes or the thread is stopped. This uses no CPU while idle, and
+		/// wakes as soon as the event is published.
+		skip_and_wait,
+
+		/// Calls stop.
+		stop,
+	};
+
+	const std::shared_ptr<metrics_registry> metrics_;
 	std::size_t iteration_no = 0;
 	std::size_t skip_no = 0;
 
+	/// How often iterations are expected to start, if regularly; set in the subclass's constructor.
+	std::chrono::nanoseconds period {0};
+
+	/// How long an iteration may take from its deadline (or start) before it counts as a deadline
+	/// miss; set in the subclass's constructor. See `threadloop_timing`.
+	std::chrono::nanoseconds budget {0};
+
+	/// Whether to keep a thread of its own even when `ILLIXR_EXECUTOR` names this plugin; set in the
+	/// subclass's constructor if the iterations need thread-local state or block for long.
+	bool own_thread = false;
+
 private:
+	/**
+	 * @brief What the loop carries from one iteration to the next, on whichever thread it runs.
+	 */
+	struct loop_state {
+		explicit loop_state(threadloop& loop)
+			: it_log{loop.record_logger_, __threadloop_iteration_header}
+			, wall_time_hist{loop.metrics_->get_histogram("threadloop/" + loop.name + "/wall_time")}
+			, cpu_time_hist{loop.metrics_->get_histogram("threadloop/" + loop.name + "/cpu_time")}
+			, raw_rows{loop.metrics_->raw_rows()}
+			, overhead{loop.record_logger_, "threadloop/" + loop.name}
+			, counting{raw_rows && perf_counters::enabled()}
+		{ }
+
+		decltype(__threadloop_iteration_header)::coalescer it_log;
+		histogram& wall_time_hist;
+		histogram& cpu_time_hist;
+		const bool raw_rows;
+		instrumentation_meter overhead;
+		std::chrono::nanoseconds iteration_start_cpu_time = thread_cpu_time();
+		time_point iteration_start_wall_time = tsc_clock::now();
+		const bool counting;
+		// Whether the coming iteration gets a raw row. Decided before it starts, so that iterations
+		// that sampling drops do not read the performance counters at all.
+		bool log_row = raw_rows && it_log.wants_row();
+		perf_counters::values iteration_start_counters = log_row && counting ? perf_counters::this_thread().read() : perf_counters::values{};
+	};
+
+	/**
+	 * @brief The loop as a task on the executor, shared with its wake-up listener and timers.
+	 *
+	 * It is `parked` while the loop waits after `skip_and_wait`; whoever clears that (a wake-up, the
+	 * wait deadline, or the loop itself seeing it was woken meanwhile) requeues it, so it is queued
+	 * at most once. Once `finished`, it is never parked again, so late wake-ups and timers are no-ops.
+	 */
+	struct pooled_task : std::enable_shared_from_this<pooled_task> {
+		pooled_task(threadloop* loop_, std::shared_ptr<executor> exec_)
+			: loop{loop_}
+			, exec{std::move(exec_)}
+		{ }
+
+		threadloop* const loop;
+		const std::shared_ptr<executor> exec;
+		std::atomic<bool> parked {false};
+		std::promise<void> done;
+		std::future<void> finished {done.get_future()};
+
+		void schedule() {
+			exec->defer([task = shared_from_this()] {
+				task->loop->pooled_step();
+			});
+		}
+
+		void resume() {
+			if (parked.exchange(false)) {
+				// Run it next on this thread, if this is one of the pool's: what woke it is cache-hot.
+				exec->submit([task = shared_from_this()] {
+					task->loop->pooled_step();
+				});
+			}
+		}
+	};
+
 	void thread_main() {
-		record_coalescer it_log {record_logger_};
 		std::cout << "thread," << std::this_thread::get_id() << ",threadloop," << name << std::endl;
+		thread_scheduling::apply(name);
 
 		_p_thread_setup();
-
-		auto iteration_start_cpu_time  = thread_cpu_time();
-		auto iteration_start_wall_time = std::chrono::high_resolution_clock::now();
+		_m_loop.emplace(*this);
 
 		while (!should_terminate()) {
-			skip_option s = _p_should_skip();
-
-			switch (s) {
+			// Read before checking, so that a wake-up while _p_should_skip() runs is not missed.
+			const std::uint32_t wake_sequence = _m_wakeup.sequence();
+			switch (loop_once()) {
 			case skip_option::skip_and_yield:
 				std::this_thread::yield();
-				++skip_no;
-				break;
-			case skip_option::skip_and_spin:
-				++skip_no;
 				break;
-			case skip_option::run: {
-				_p_one_iteration();
-				it_log.log(record{__threadloop_iteration_header, {
-					{id},
-					{iteration_no},
-					{skip_no},
-					{iteration_start_cpu_time},
-					{thread_cpu_time()},
-					{iteration_start_wall_time},
-					{std::chrono::high_resolution_clock::now()},
-				}});
-				iteration_start_cpu_time  = thread_cpu_time();
-				iteration_start_wall_time = std::chrono::high_resolution_clock::now();
-				++iteration_no;
-				skip_no = 0;
+			case skip_option::skip_and_wait:
+				if (!should_terminate()) {
+					const std::optional<time_point> wait_deadline = _p_wait_deadline();
+					const bool timed = wait_deadline && *wait_deadline > std::chrono::high_resolution_clock::now();
+					if (!_m_wakeup.wait(wake_sequence, wait_deadline) && timed && !should_terminate()) {
+						record_timer_latency(*wait_deadline);
+					}
+				}
 				break;
-			}
 			case skip_option::stop:
 				stop();
 				break;
+			default:
+				break;
 			}
 		}
+		_m_loop.reset();
 	}
 
-protected:
-
-	enum class skip_option {
-		/// Run iteration NOW. Only then does CPU timer begin counting.
-		run,
-
-		/// AKA "busy wait". Skip but try again very quickly.
-		skip_and_spin,
+	/**
+	 * @brief One pass of the loop, as a task on the executor.
+	 */
+	void pooled_step() {
+		// Stop() may return, and this be destroyed, as soon as the task is done.
+		const std::shared_ptr<pooled_task> task = _m_task;
+		if (should_terminate()) {
+			_m_loop.reset();
+			task->done.set_value();
+			return;
+		}
+		if (!_m_loop) {
+			_p_thread_setup();
+			_m_loop.emplace(*this);
+		}
+		// The pool thread has run other tasks since the last pass; only count this one's CPU time.
+		_m_loop->iteration_start_cpu_time = thread_cpu_time();
+		if (_m_loop->log_row && _m_loop->counting) {
+			_m_loop->iteration_start_counters = perf_counters::this_thread().read();
+		}
 
-		/// Yielding gives up a scheduling quantum, which is determined by the OS, but usually on
-		/// the order of 1-10ms. This is nicer to the other threads in the system.
-		skip_and_yield,
+		const std::uint32_t wake_sequence = _m_wakeup.sequence();
+		const skip_option s = loop_once();
+		if (s == skip_option::stop || should_terminate()) {
+			_m_loop.reset();
+			task->done.set_value();
+		} else if (s == skip_option::skip_and_wait) {
+			// Asked before parking: once parked, another thread may already be running the next pass.
+			const std::optional<time_point> wait_deadline = _p_wait_deadline();
+			task->parked.store(true);
+			if (_m_wakeup.sequence() != wake_sequence || should_terminate()) {
+				task->resume();
+			} else if (wait_deadline) {
+				task->exec->submit_at(*wait_deadline, [task] {
+					task->resume();
+				});
+			}
+		} else {
+			task->schedule();
+		}
+	}
 
-		/// Calls stop.
-		stop,
-	};
+	/**
+	 * @brief Asks `_p_should_skip()`, and runs and accounts for an iteration if it says so.
+	 */
+	skip_option loop_once() {
+		const skip_option s = _p_should_skip();
+		if (s == skip_option::run) {
+			loop_state& state = *_m_loop;
+			const std::optional<time_point> deadline = _p_iteration_deadline();
+			const bool timed = deadline || period.count() > 0 || budget.count() > 0;
+			const time_point run_start = timed ? std::chrono::high_resolution_clock::now() : time_point{};
+			// The histogram counts only the iteration, not _p_should_skip() (a periodic threadloop's
+			// sleep) or, on the executor, the time parked and spent on other tasks.
+			const time_point run_start_wall_time = tsc_clock::now();
+			if (_m_heartbeat) {
+				_m_heartbeat->start();
+			}
+			_p_one_iteration();
+			if (_m_heartbeat) {
+				_m_heartbeat->stop();
+			}
+			{
+				// Everything between one iteration and the next is instrumentation.
+				const instrumentation_meter::scope measure {state.overhead};
+				const std::chrono::nanoseconds iteration_stop_cpu_time = thread_cpu_time();
+				const time_point iteration_stop_wall_time = tsc_clock::now();
+				state.wall_time_hist.record(iteration_stop_wall_time - run_start_wall_time);
+				state.cpu_time_hist.record(iteration_stop_cpu_time - state.iteration_start_cpu_time);
+				const bool logged_row = state.log_row;
+				if (logged_row) {
+					const perf_counters::values iteration_stop_counters = state.counting ? perf_counters::this_thread().read() : perf_counters::values{};
+					const perf_counters::values counts = perf_counters::difference(state.iteration_start_counters, iteration_stop_counters);
+					state.it_log.log(
+						id,
+						iteration_no,
+						skip_no,
+						state.iteration_start_cpu_time,
+						iteration_stop_cpu_time,
+						state.iteration_start_wall_time,
+						iteration_stop_wall_time,
+						kernel_thread_id(),
+						counts[perf_counters::cycles],
+						counts[perf_counters::instructions],
+						counts[perf_counters::llc_misses],
+						counts[perf_counters::branch_misses],
+						counts[perf_counters::context_switches]
+					);
+					state.iteration_start_counters = iteration_stop_counters;
+				}
+				// The next row starts from these counters, if it was just read for this one.
+				state.log_row = state.raw_rows && state.it_log.wants_row();
+				if (state.log_row && state.counting && !logged_row) {
+					state.iteration_start_counters = perf_counters::this_thread().read();
+				}
+				if (timed) {
+					if (!timing) {
+						timing.emplace(*metrics_, record_logger_, name, period, budget);
+					}
+					// Deadlines are on high_resolution_clock, which tsc_clock may have drifted from.
+					timing->account(id, iteration_no, deadline, run_start, std::chrono::high_resolution_clock::now());
+				}
+				// The next iteration starts where this one stopped, which saves reading the CPU clock
+				// (a system call) again; the cheap instrumentation in between is counted in it.
+				state.iteration_start_cpu_time  = iteration_stop_cpu_time;
+				state.iteration_start_wall_time = iteration_stop_wall_time;
+			}
+			++iteration_no;
+			skip_no = 0;
+		} else if (s != skip_option::stop) {
+			++skip_no;
+		}
+		return s;
+	}
 
+protected:
 	/**
 	 * @brief Gets called in a tight loop, to gate the invocation of `_p_one_iteration()`
 	 */
 	virtual skip_option _p_should_skip() { return skip_option::run; }
 
 	/**
-	 * @brief Gets called at setup time, from the new thread.
+	 * @brief The latest time to sleep until after `skip_and_wait`; nullopt (the default) to wait for a wake-up.
+	 *
+	 * Called right after `_p_should_skip()` returns `skip_and_wait`.
+	 */
+	virtual std::optional<time_point> _p_wait_deadline() { return std::nullopt; }
+
+	/**
+	 * @brief When the iteration about to run was due, if this threadloop has deadlines.
+	 *
+	 * Called right after `_p_should_skip()` returns `run`.
+	 */
+	virtual std::optional<time_point> _p_iteration_deadline() const { return std::nullopt; }
+
+	/**
+	 * @brief Gets called at setup time, from the new thread (or the first task on the executor).
 	 */
 	virtual void _p_thread_setup() { }
 
@@ -151,10 +539,214 @@ protected:
 		return _m_terminate.load();
 	}
 
+	/**
+	 * @brief Wakes the thread from `skip_and_wait` whenever an event is published to @p topic_name.
+	 *
+	 * Call this from the constructor (or `_p_thread_setup()`); it lasts until the threadloop stops.
+	 */
+	template <typename event>
+	void wake_on(const std::string& topic_name) {
+		pb->lookup_impl<switchboard>()->watch<event>(topic_name, _m_wakeup);
+		_m_watched.push_back(topic_name);
+	}
+
+	/**
+	 * @brief Stops waking the thread on events on @p topic_name, for once it no longer waits for them.
+	 *
+	 * Every event on a watched topic wakes the thread, even from `sleep_until()` (which then goes
+	 * back to sleep), so a busy topic costs a context switch per event. Call this from the loop
+	 * itself (`_p_should_skip()` or an iteration).
+	 */
+	void stop_waking_on(const std::string& topic_name) {
+		const auto it = std::find(_m_watched.begin(), _m_watched.end(), topic_name);
+		if (it != _m_watched.end()) {
+			pb->lookup_impl<switchboard>()->unwatch(topic_name, _m_wakeup);
+			_m_watched.erase(it);
+		}
+	}
+
+	/**
+	 * @brief Sleeps until @p until or until the thread is stopped, whichever is first.
+	 *
+	 * How late the timer woke the thread goes to the `threadloop/<name>/timer_latency` histogram.
+	 */
+	void sleep_until(time_point until) {
+		bool slept = false;
+		while (!should_terminate()) {
+			const std::uint32_t wake_sequence = _m_wakeup.sequence();
+			if (should_terminate()) {
+				break;
+			}
+			if (std::chrono::high_resolution_clock::now() >= until) {
+				if (slept) {
+					record_timer_latency(until);
+				}
+				break;
+			}
+			// Wake-ups for skip_and_wait do not end this sleep early; it just goes back to sleep.
+			_m_wakeup.wait(wake_sequence, until);
+			slept = true;
+		}
+	}
+
 private:
+	/**
+	 * @brief Records how long after @p requested a timed sleep ended, which is the scheduler's doing.
+	 */
+	void record_timer_latency(time_point requested) {
+		const std::chrono::nanoseconds latency = std::chrono::high_resolution_clock::now() - requested;
+		if (!_m_timer_latency) {
+			_m_timer_latency = &metrics_->get_histogram("threadloop/" + name + "/timer_latency");
+		}
+		_m_timer_latency->record(latency);
+	}
+
 	std::atomic<bool> _m_terminate {false};
+	// Set if the loop runs on the executor; _m_wakeup's listener requeues it when woken.
+	std::shared_ptr<pooled_task> _m_task;
+	std::function<void()> _m_wake_listener;
+	wakeup _m_wakeup;
+	std::vector<std::string> _m_watched;
+	// Only used by the loop's thread (or task), while it runs.
+	std::optional<loop_state> _m_loop;
+
+	// Created by the thread on the first iteration that has a deadline, period or budget.
+	std::optional<threadloop_timing> timing;
+	// Looked up by the thread on its first timed sleep.
+	histogram* _m_timer_latency = nullptr;
+	// Set if the stall watchdog is on.
+	std::shared_ptr<stall_watchdog::heartbeat> _m_heartbeat;
 
 	std::thread _m_thread;
 };
 
+/**
+ * @brief A threadloop whose iterations start at absolute deadlines.
+ *
+ * Each deadline comes from `_p_next_deadline()`; by default it is one `period` after the last, so a
+ * late iteration does not push back the ones after it. A subclass without a period overrides
+ * `_p_next_deadline()`; otherwise, it runs without waiting, and says so. The thread sleeps on a futex with an absolute timeout
+ * (`sleep_until()`) until a margin before the deadline, then spins the rest of the way, which avoids
+ * most of the scheduler's wake-up slop. The margin adapts to how late the sleeps have actually been
+ * on this machine, but is at most a tenth of the time between deadlines, so a fast loop does not
+ * spend much of its time spinning.
+ *
+ * How late each wake-up was (wake_error, which is only positive if the thread was woken too late to
+ * spin) goes to the `threadloop/<name>/wake_error` histogram, and to `threadloop_wakeup` rows.
+ * The deadlines also feed the lateness and jitter accounting of `threadloop_timing`, with a budget
+ * of one period unless the subclass sets another.
+ */
+class periodic_threadloop : public threadloop {
+public:
+	periodic_threadloop(std::string name_, phonebook* pb_, std::chrono::nanoseconds period_ = std::chrono::nanoseconds{0})
+		: threadloop{name_, pb_}
+		, wakeup_log{record_logger_, __threadloop_wakeup_header}
+		, wake_error_hist{metrics_->get_histogram("threadloop/" + name + "/wake_error")}
+		, raw_rows{metrics_->raw_rows()}
+	{
+		// By default, an iteration should be done by the time the next one is due.
+		period = period_;
+		budget = period_;
+		// The loop sleeps and spins until each deadline, which would hold up a pool thread.
+		own_thread = true;
+	}
+
+protected:
+	/**
+	 * @brief The time at which the next iteration should start, or nullopt to not wait at all.
+	 *
+	 * @p last is the previous deadline (the time of the first call, on the first call). By default,
+	 * one `period` later; without a period, nullopt, so the loop runs unpaced (and says so once).
+	 */
+	virtual std::optional<time_point> _p_next_deadline(time_point last) {
+		if (period.count() <= 0) {
+			if (!warned_unpaced) {
+				warned_unpaced = true;
+				std::cerr << "periodic_threadloop " << name << " has no period and does not override _p_next_deadline(); "
+						  << "it runs without waiting" << std::endl;
+			}
+			return std::nullopt;
+		}
+		return last + period;
+	}
+
+	/**
+	 * @brief Takes the place of `_p_should_skip()`, and is called once the deadline has passed.
+	 */
+	virtual skip_option _p_should_skip_at_deadline() { return skip_option::run; }
+
+	virtual std::optional<time_point> _p_iteration_deadline() const override {
+		return current_deadline;
+	}
+
+private:
+	virtual skip_option _p_should_skip() override final {
+		if (!last_deadline) {
+			last_deadline = std::chrono::high_resolution_clock::now();
+		}
+		current_deadline = _p_next_deadline(*last_deadline);
+		// A deadline that was already waited for (e.g. after a skip) has passed; it is not counted twice.
+		if (current_deadline && current_deadline != last_deadline) {
+			wait_until(*current_deadline, *current_deadline - *last_deadline);
+			last_deadline = current_deadline;
+		}
+		return _p_should_skip_at_deadline();
+	}
+
+	/**
+	 * @brief Sleeps and spins until @p deadline, which is @p interval after the previous one.
+	 */
+	void wait_until(time_point deadline, std::chrono::nanoseconds interval) {
+		const time_point sleep_until = deadline - std::min(spin_margin, std::max(interval / 10, std::chrono::nanoseconds{0}));
+		time_point now = std::chrono::high_resolution_clock::now();
+		if (now < sleep_until) {
+			threadloop::sleep_until(sleep_until);
+			now = std::chrono::high_resolution_clock::now();
+			// Only whole sleeps tell us how late the scheduler wakes this thread.
+			if (!should_terminate()) {
+				calibrate(now - sleep_until);
+			}
+		}
+		const time_point spin_start = now;
+		while (now < deadline && !should_terminate()) {
+			now = std::chrono::high_resolution_clock::now();
+		}
+
+		const std::chrono::nanoseconds wake_error = now - deadline;
+		wake_error_hist.record(std::max(wake_error, std::chrono::nanoseconds{0}));
+		if (raw_rows) {
+			wakeup_log.log(id, iteration_no, deadline, now, wake_error, now - spin_start);
+		}
+	}
+
+	/**
+	 * @brief Moves the spin margin towards how late a sleep woke up.
+	 *
+	 * It jumps up to a late wake-up at once, so that the next deadline is not missed too, and decays
+	 * slowly, so the margin stays near the worst recent case rather than the typical one.
+	 */
+	void calibrate(std::chrono::nanoseconds oversleep) {
+		const std::chrono::nanoseconds wanted = std::clamp(oversleep * 5 / 4, min_spin_margin, max_spin_margin);
+		spin_margin = wanted > spin_margin ? wanted : spin_margin - (spin_margin - wanted) / 64;
+	}
+
+	static constexpr std::chrono::nanoseconds min_spin_margin {std::chrono::microseconds{20}};
+	static constexpr std::chrono::nanoseconds max_spin_margin {std::chrono::milliseconds{2}};
+
+	std::chrono::nanoseconds spin_margin {std::chrono::microseconds{200}};
+	bool warned_unpaced = false;
+	std::optional<time_point> last_deadline;
+	std::optional<time_point> current_deadline;
+	typed_record_coalescer<
+		std::size_t,
+		std::size_t,
+		time_point,
+		time_point,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds
+	> wakeup_log;
+	histogram& wake_error_hist;
+	const bool raw_rows;
+};
+
 }
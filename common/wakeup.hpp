@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <linux/futex.h>
+#include <optional>
+#include <sys/syscall.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace ILLIXR {
+
+/**
+ * @brief Something a thread can sleep on until another thread notifies it, backed by a futex.
+ *
+ * To wait without missing a notification, read `sequence()` first, then check whatever condition
+ * is being waited for, then `wait()` with that sequence number: a `notify()` since the read makes
+ * `wait()` return at once.
+ *
+ * `notify()` only makes a system call when a thread is actually asleep, so notifying a wakeup that
+ * nobody is waiting on costs a few atomic operations.
+ *
+ * Waiters that are not threads (such as a task on an `executor`) can set a listener instead.
+ */
+class wakeup {
+public:
+	using time_point = std::chrono::high_resolution_clock::time_point;
+
+	/**
+	 * @brief The number of notifications so far (wrapping around).
+	 */
+	std::uint32_t sequence() const {
+		return _m_sequence.load();
+	}
+
+	/**
+	 * @brief Wakes every thread in `wait()`. Safe to call from any thread.
+	 */
+	void notify() {
+		notify(INT_MAX);
+	}
+
+	/**
+	 * @brief Wakes one thread in `wait()`, for when any one of them can handle what it was woken for.
+	 */
+	void notify_one() {
+		notify(1);
+	}
+
+	/**
+	 * @brief Calls @p fn, from the notifying thread, on every notification from now on.
+	 *
+	 * @p fn must outlive this object (or be replaced by nullptr first), and should be quick.
+	 */
+	void set_listener(const std::function<void()>* fn) {
+		_m_listener.store(fn);
+	}
+
+	/**
+	 * @brief Sleeps until there was a notification after @p seen, or until @p until passes.
+	 *
+	 * @return Whether there was a notification.
+	 */
+	bool wait(std::uint32_t seen, std::optional<time_point> until = std::nullopt) {
+		++_m_waiters;
+		bool notified = true;
+		while (_m_sequence.load() == seen) {
+			timespec ts;
+			if (until) {
+				const std::chrono::nanoseconds target = until->time_since_epoch();
+				if (target <= std::chrono::high_resolution_clock::now().time_since_epoch()) {
+					notified = false;
+					break;
+				}
+				ts = {
+					static_cast<time_t>(target.count() / 1000000000),
+					static_cast<long>(target.count() % 1000000000),
+				};
+			}
+			// Returns at once (EAGAIN) if the sequence has moved on since it was read above.
+			futex(FUTEX_WAIT_BITSET_PRIVATE | clock_flag, seen, until ? &ts : nullptr);
+		}
+		--_m_waiters;
+		return notified;
+	}
+
+private:
+	void notify(int count) {
+		_m_sequence.fetch_add(1);
+		if (_m_waiters.load()) {
+			futex(FUTEX_WAKE_PRIVATE, count, nullptr);
+		}
+		if (const std::function<void()>* listener = _m_listener.load()) {
+			(*listener)();
+		}
+	}
+
+	// FUTEX_WAIT_BITSET takes an absolute time on CLOCK_MONOTONIC, or CLOCK_REALTIME with this flag;
+	// it has to be the clock behind high_resolution_clock.
+	static constexpr int clock_flag = std::is_same_v<std::chrono::high_resolution_clock, std::chrono::system_clock>
+		? FUTEX_CLOCK_REALTIME
+		: 0;
+
+	void futex(int op, std::uint32_t val, const timespec* ts) {
+		static_assert(sizeof(_m_sequence) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free);
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_m_sequence), op, val, ts, nullptr, FUTEX_BITSET_MATCH_ANY);
+	}
+
+	std::atomic<std::uint32_t> _m_sequence {0};
+	std::atomic<std::uint32_t> _m_waiters {0};
+	std::atomic<const std::function<void()>*> _m_listener {nullptr};
+};
+
+}
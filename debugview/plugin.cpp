@@ -3,6 +3,7 @@
 #include <iostream>
 #include <thread>
 #include <functional>
+#include <map>
 
 // IMGUI Immediate-mode GUI library
 #include "imgui/imgui.h"
@@ -17,6 +18,7 @@
 #include "common/shader_util.hpp"
 #include "common/math_util.hpp"
 #include "common/pose_prediction.hpp"
+#include "common/recent_records.hpp"
 #include "block_i.hpp"
 #include "demo_model.hpp"
 #include "headset_model.hpp"
@@ -60,9 +62,13 @@ public:
 		: threadloop{name_, pb_}
 		, sb{pb->lookup_impl<switchboard>()}
 		, pp{pb->lookup_impl<pose_prediction>()}
+		, recent{pb->lookup_impl<recent_records>()}
 		, _m_slow_pose{sb->subscribe_latest<pose_type>("slow_pose")}
 		//, glfw_context{pb->lookup_impl<global_config>()->glfw_context}
-	{}
+	{
+		// Its GL context is current on its own thread only.
+		own_thread = true;
+	}
 
 	// Struct for drawable debug objects (scenery, headset visualization, etc)
 	struct DebugDrawable {
@@ -215,9 +221,39 @@ public:
 		ImGui::Image((void*)(intptr_t)camera_textures[1], ImVec2(windowSize.x/2,windowSize.y - verticalOffset * 2));
 		ImGui::End();
 
+		draw_timing_GUI();
+
 		ImGui::Render();
 	}
 
+	// Plots the wall time of each threadloop's recent iterations, from the runtime's recent_records.
+	void draw_timing_GUI() {
+		using time_point = std::chrono::high_resolution_clock::time_point;
+
+		// Plugins log their name once, when they start.
+		for (const record& r : recent->query("plugin_name", 256)) {
+			plugin_names[r.get_value<std::size_t>(0)] = r.get_value<std::string>(1);
+		}
+
+		std::map<std::size_t, std::vector<float>> wall_times;
+		for (const record& r : recent->query("threadloop_iteration", 256)) {
+			const auto wall_time = r.get_value<time_point>(6) - r.get_value<time_point>(5);
+			wall_times[r.get_value<std::size_t>(0)].push_back(std::chrono::duration<float, std::milli>{wall_time}.count());
+		}
+
+		ImGui::Begin("Plugin timing");
+		if (wall_times.empty()) {
+			ImGui::Text("No threadloop_iteration records (see ILLIXR_RECENT_RECORDS and ILLIXR_RECORD_VERBOSITY).");
+		}
+		for (const auto& [plugin_id, times] : wall_times) {
+			const auto name = plugin_names.find(plugin_id);
+			const std::string label = name == plugin_names.end() ? std::to_string(plugin_id) : name->second;
+			const float last = times.back();
+			ImGui::PlotLines(label.c_str(), times.data(), times.size(), 0, std::to_string(last).append(" ms").c_str(), 0.0f, FLT_MAX, ImVec2(0, 40));
+		}
+		ImGui::End();
+	}
+
 	void draw_scene() {
 
 		// OBJ exporter is having winding order issues currently.
@@ -393,6 +429,8 @@ private:
 	//GLFWwindow * const glfw_context;
 	const std::shared_ptr<switchboard> sb;
 	const std::shared_ptr<pose_prediction> pp;
+	const std::shared_ptr<recent_records> recent;
+	std::map<std::size_t, std::string> plugin_names;
 
 	std::unique_ptr<reader_latest<pose_type>> _m_slow_pose;
 	// std::unique_ptr<reader_latest<imu_cam_type>> _m_imu_cam_data;
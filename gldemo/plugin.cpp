@@ -38,7 +38,7 @@ static constexpr std::chrono::milliseconds VSYNC_DELAY_TIME {std::size_t{2}};
 // If this is defined, gldemo will use Monado-style eyebuffers
 //#define USE_ALT_EYE_FORMAT
 
-class gldemo : public threadloop {
+class gldemo : public periodic_threadloop {
 public:
 	// Public constructor, create_component passes Switchboard handles ("plugs")
 	// to this constructor. In turn, the constructor fills in the private
@@ -46,7 +46,7 @@ public:
 	// data whenever it needs to.
 
 	gldemo(std::string name_, phonebook* pb_)
-		: threadloop{name_, pb_}
+		: periodic_threadloop{name_, pb_}
 		, xwin{new xlib_gl_extended_window{1, 1, pb->lookup_impl<xlib_gl_extended_window>()->glc}}
 		, sb{pb->lookup_impl<switchboard>()}
 		//, xwin{pb->lookup_impl<xlib_gl_extended_window>()}
@@ -57,7 +57,10 @@ public:
 #else
 		, _m_eyebuffer{sb->publish<rendered_frame>("eyebuffer")}
 #endif
-	{ }
+	{
+		// One frame per vsync.
+		budget = vsync_period;
+	}
 
 
 	// Struct for drawable debug objects (scenery, headset visualization, etc)
@@ -118,7 +121,8 @@ public:
 	}
 
 	// Essentially, a crude equivalent of XRWaitFrame.
-	void wait_vsync()
+	// periodic_threadloop sleeps until just before the deadline and spins the rest.
+	std::optional<time_point> _p_next_deadline(time_point) override
 	{
 		using namespace std::chrono_literals;
 		const time_type* next_vsync = vsync->get_latest_ro();
@@ -130,8 +134,7 @@ public:
 		{
 			// If no vsync data available, just sleep for roughly a vsync period.
 			// We'll get synced back up later.
-			std::this_thread::sleep_for(vsync_period);
-			return;
+			return now + vsync_period;
 		}
 
 #ifndef NDEBUG
@@ -162,13 +165,10 @@ public:
 #ifndef NDEBUG
 			printf("\033[1;32m[GL DEMO APP]\033[0m We haven't rendered yet, rendering immediately.");
 #endif
-			return;
+			return std::nullopt;
 		}
 
-		// Perform the sleep.
-		// TODO: Consider using Monado-style sleeping, where we nanosleep for
-		// most of the wait, and then spin-wait for the rest?
-		std::this_thread::sleep_until(wait_time);
+		return wait_time;
 	}
 
 	void _p_thread_setup() override {
@@ -180,9 +180,6 @@ public:
 		{
 			using namespace std::chrono_literals;
 
-			// Essentially, XRWaitFrame.
-			wait_vsync();
-
 			glUseProgram(demoShaderProgram);
 
 			glBindFramebuffer(GL_FRAMEBUFFER, eyeTextureFBO);
@@ -531,7 +528,7 @@ public:
 
 		lastTime = glfwGetTime();
 
-		threadloop::start();
+		periodic_threadloop::start();
 	}
 };
 
@@ -6,43 +6,47 @@
 
 using namespace ILLIXR;
 
-const record_header imu_cam_record {
+const record_type<std::size_t, bool> imu_cam_record {
 	"imu_cam",
 	{
-		{"iteration_no", typeid(std::size_t)},
-		{"has_camera", typeid(bool)},
+		"iteration_no",
+		"has_camera",
 	},
+	record_verbosity::detailed,
 };
 
-class offline_imu_cam : public ILLIXR::threadloop {
+class offline_imu_cam : public ILLIXR::periodic_threadloop {
 public:
 	offline_imu_cam(std::string name_, phonebook* pb_)
-		: threadloop{name_, pb_}
+		: periodic_threadloop{name_, pb_}
 		, _m_sensor_data{load_data()}
 		, _m_sensor_data_it{_m_sensor_data.cbegin()}
 		, _m_sb{pb->lookup_impl<switchboard>()}
 		, _m_imu_cam{_m_sb->publish<imu_cam_type>("imu_cam")}
 		, dataset_first_time{_m_sensor_data_it->first}
-		, imu_cam_log{record_logger_}
+		, imu_cam_log{record_logger_, imu_cam_record}
 		, camera_cvtfmt_log{record_logger_}
 	{ }
 
 protected:
-	virtual skip_option _p_should_skip() override {
+	virtual std::optional<time_point> _p_next_deadline(time_point) override {
 		if (_m_sensor_data_it != _m_sensor_data.end()) {
 			dataset_now = _m_sensor_data_it->first;
-			// Sleep for the difference between the current IMU vs 1st IMU and current UNIX time vs UNIX time the component was init
-			std::this_thread::sleep_for(
-				std::chrono::nanoseconds{dataset_now - dataset_first_time}
-				+ real_first_time
-				- std::chrono::high_resolution_clock::now()
-			);
+			// The current IMU is as far from the 1st IMU as its deadline is from when the component was init
+			return real_first_time + std::chrono::nanoseconds{dataset_now - dataset_first_time};
+		} else {
+			return std::nullopt;
+		}
+	}
 
+	virtual skip_option _p_should_skip_at_deadline() override {
+		if (_m_sensor_data_it != _m_sensor_data.end()) {
 			if (_m_sensor_data_it->second.imu0) {
 				return skip_option::run;
 			} else {
 				++_m_sensor_data_it;
-				return skip_option::skip_and_yield;
+				// Nothing to yield for: the next call sleeps until the next entry is due.
+				return skip_option::skip_and_spin;
 			}
 
 		} else {
@@ -57,10 +61,7 @@ protected:
 		const sensor_types& sensor_datum = _m_sensor_data_it->second;
 		++_m_sensor_data_it;
 
-		imu_cam_log.log(record{imu_cam_record, {
-			{iteration_no},
-			{bool(sensor_datum.cam0)},
-		}});
+		imu_cam_log.log(iteration_no, bool(sensor_datum.cam0));
 
 
 		std::optional<cv::Mat*> cam0 = sensor_datum.cam0
@@ -103,7 +104,7 @@ private:
 	// Current IMU timestamp
 	ullong dataset_now;
 
-	record_coalescer imu_cam_log;
+	typed_record_coalescer<std::size_t, bool> imu_cam_log;
 	record_coalescer camera_cvtfmt_log;
 };
 
@@ -141,6 +141,61 @@ async def build_runtime(config: Dict[str, Any], suffix: str, test: bool = False)
     return runtime_path / "runtime" / runtime_name
 
 
+def thread_scheduling_spec(settings: Dict[str, Dict[str, Any]]) -> str:
+    """Formats the thread_scheduling (or timer_probe) config as ILLIXR_THREAD_SCHEDULING (or
+    ILLIXR_TIMER_PROBE; see common/thread_scheduling.hpp)."""
+    entries = []
+    for thread, setting in settings.items():
+        policy = setting.get("policy", "")
+        if policy in ("fifo", "rr"):
+            policy += f":{setting.get('priority', 0)}"
+        elif policy == "deadline":
+            policy += f":{setting.get('runtime_us', 0)}/{setting.get('deadline_us', 0)}/{setting.get('period_us', 0)}"
+        cpus = setting.get("cpus", "")
+        entries.append(f"{thread}={policy}" + (f"@{cpus}" if cpus else ""))
+    return ";".join(entries)
+
+
+def record_logger_env(config: Dict[str, Any]) -> Dict[str, str]:
+    """Translates the record_logger, record_verbosity, record_sampling, metrics_port,
+    thread_scheduling, executor, executor_threads, perf_counters, timer_probe,
+    timer_probe_interval_us, watchdog and watchdog_timeout_ms config into environment variables
+    for the runtime, except those already set."""
+    env = {}
+    if config["record_logger"]:
+        sinks = []
+        for sink in config["record_logger"]:
+            if sink["only"]:
+                sinks.append(sink["backend"] + ":" + ",".join(sink["only"]))
+            elif sink["except"]:
+                sinks.append(sink["backend"] + ":!" + ",".join(sink["except"]))
+            else:
+                sinks.append(sink["backend"])
+        env["ILLIXR_RECORD_LOGGER"] = "+".join(sinks)
+    env["ILLIXR_RECORD_VERBOSITY"] = config["record_verbosity"]
+    if config["record_sampling"]:
+        env["ILLIXR_RECORD_SAMPLING"] = ",".join(
+            f"{table}={policy}" for table, policy in config["record_sampling"].items()
+        )
+    if config["metrics_port"]:
+        env["ILLIXR_METRICS_PORT"] = str(config["metrics_port"])
+    if config["thread_scheduling"]:
+        env["ILLIXR_THREAD_SCHEDULING"] = thread_scheduling_spec(config["thread_scheduling"])
+    if config["executor"]:
+        env["ILLIXR_EXECUTOR"] = ",".join(config["executor"])
+    if config["executor_threads"]:
+        env["ILLIXR_EXECUTOR_THREADS"] = str(config["executor_threads"])
+    if config["perf_counters"]:
+        env["ILLIXR_PERF_COUNTERS"] = "1"
+    if config["timer_probe"]:
+        env["ILLIXR_TIMER_PROBE"] = thread_scheduling_spec(config["timer_probe"])
+        env["ILLIXR_TIMER_PROBE_INTERVAL_US"] = str(config["timer_probe_interval_us"])
+    if config["watchdog"]:
+        env["ILLIXR_WATCHDOG"] = str(config["watchdog"])
+        env["ILLIXR_WATCHDOG_TIMEOUT_MS"] = str(config["watchdog_timeout_ms"])
+    return {key: val for key, val in env.items() if key not in os.environ}
+
+
 async def load_native(config: Dict[str, Any]) -> None:
     runtime_exe_path, plugin_paths = await gather_aws(
         build_runtime(config, "exe"),
@@ -156,6 +211,7 @@ async def load_native(config: Dict[str, Any]) -> None:
         check=True,
         env=dict(
             ILLIXR_DATA=config["data"],
+            **record_logger_env(config),
             **os.environ,
         ),
     )
@@ -191,6 +247,7 @@ async def load_gdb(config: Dict[str, Any]) -> None:
         check=True,
         env=dict(
             ILLIXR_DATA=config["data"],
+            **record_logger_env(config),
             **os.environ,
         ),
     )
@@ -268,6 +325,7 @@ async def load_monado(config: Dict[str, Any]) -> None:
             ILLIXR_PATH=str(runtime_path / "runtime" / f"plugin.{profile}.so"),
             ILLIXR_COMP=":".join(map(str, plugin_paths)),
             ILLIXR_DATA=config["data"],
+            **record_logger_env(config),
             **os.environ,
         ),
     )
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "../common/bench/bench_util.hpp"
+#include "../common/threadloop.hpp"
+#include "../switchboard_impl.hpp"
+#include "../noop_record_logger.hpp"
+#include "../work_stealing_executor.hpp"
+
+/*
+  Thread per plugin against the shared work-stealing executor: a chain of threadloops, each waiting
+  for an event from the previous one (skip_and_wait), doing a little work and passing a token on; a
+  switchboard callback at the end wakes the first for the next token. So every token wakes every
+  stage once, which is the worst case for context switches.
+
+  - wall_ns_per_token is the time for a token to go around the chain;
+  - cpu_ns_per_token is the whole process's CPU time per token;
+  - context_switches_per_token counts both voluntary and involuntary ones.
+
+  Usage: `make bench/run` in runtime/, or `./bench/bench_executor.exe`.
+*/
+
+using namespace ILLIXR;
+using namespace ILLIXR::bench;
+using bench_clock = std::chrono::steady_clock;
+
+struct token {
+	std::size_t seq;
+};
+
+static void busy_work(std::size_t iterations) {
+	std::size_t x = 1;
+	for (std::size_t i = 0; i < iterations; ++i) {
+		x = x * 6364136223846793005u + 1442695040888963407u;
+	}
+	do_not_optimize(x);
+}
+
+static constexpr std::size_t WORK_ITERATIONS = 2000;
+
+/**
+ * Passes each token from the topic `stage_<n>` to `stage_<n + 1>`. Stage 0 starts a token whenever
+ * the previous one has come back, until it has sent `tokens`.
+ */
+class stage : public threadloop {
+public:
+	stage(phonebook* pb_, std::size_t n_, std::size_t tokens_, const std::atomic<std::size_t>& returned_)
+		: threadloop{"stage_" + std::to_string(n_), pb_}
+		, n{n_}
+		, tokens{tokens_}
+		, returned{returned_}
+		, input{n_ ? pb->lookup_impl<switchboard>()->subscribe_latest<token>("stage_" + std::to_string(n_)) : nullptr}
+		, output{pb->lookup_impl<switchboard>()->publish<token>("stage_" + std::to_string(n_ + 1))}
+		, pool(tokens_)
+	{
+		if (n) {
+			wake_on<token>("stage_" + std::to_string(n));
+		}
+	}
+
+protected:
+	virtual skip_option _p_should_skip() override {
+		if (n == 0) {
+			return sent < tokens && returned.load() == sent ? skip_option::run : skip_option::skip_and_wait;
+		}
+		const token* latest = input->get_latest_ro();
+		return latest && latest->seq + 1 > sent ? skip_option::run : skip_option::skip_and_wait;
+	}
+
+	virtual void _p_one_iteration() override {
+		busy_work(WORK_ITERATIONS);
+		pool[sent].seq = sent;
+		output->put(&pool[sent]);
+		++sent;
+	}
+
+private:
+	const std::size_t n;
+	const std::size_t tokens;
+	const std::atomic<std::size_t>& returned;
+	std::unique_ptr<reader_latest<token>> input;
+	std::unique_ptr<writer<token>> output;
+	std::vector<token> pool;
+	std::size_t sent = 0;
+};
+
+static std::size_t context_switches() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static std::chrono::nanoseconds process_cpu_time() {
+	return cpp_clock_gettime(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static void bench_chain(std::size_t stages, std::size_t tokens, bool pooled, std::size_t threads) {
+	std::atomic<std::size_t> returned {0};
+
+	const std::size_t switches_start = context_switches();
+	const auto cpu_start = process_cpu_time();
+	const auto wall_start = bench_clock::now();
+	{
+		phonebook pb;
+		pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+		pb.register_impl<metrics_registry>(std::make_shared<metrics_registry>(pb.lookup_impl<record_logger>()));
+		pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+		auto exec = std::make_shared<work_stealing_executor>(pooled ? std::vector<std::string>{"stage_*", "switchboard"} : std::vector<std::string>{}, threads);
+		pb.register_impl<executor>(exec);
+		auto sb = std::make_shared<switchboard_impl>(&pb);
+		pb.register_impl<switchboard>(sb);
+
+		std::vector<std::unique_ptr<stage>> chain;
+		for (std::size_t i = 0; i < stages; ++i) {
+			chain.push_back(std::make_unique<stage>(&pb, i, tokens, returned));
+		}
+		sb->schedule<token>(pb.lookup_impl<gen_guid>()->get(), "stage_" + std::to_string(stages), [&](const token*) {
+			returned++;
+			chain.front()->wake();
+		});
+		for (const auto& s : chain) {
+			s->start();
+		}
+		while (returned.load() < tokens) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+		sb->stop();
+		for (const auto& s : chain) {
+			s->stop();
+		}
+		exec->stop();
+	}
+	const double wall_ns = std::chrono::duration<double, std::nano>{bench_clock::now() - wall_start}.count();
+	const double cpu_ns = (process_cpu_time() - cpu_start).count();
+
+	report r {"executor/chain"};
+	r.field("mode", std::string{pooled ? "executor" : "threads"})
+		.field("threads", pooled ? threads : stages + 1)
+		.field("stages", stages)
+		.field("tokens", tokens)
+		.field("wall_ns_per_token", wall_ns / tokens)
+		.field("cpu_ns_per_token", cpu_ns / tokens)
+		.field("context_switches_per_token", static_cast<double>(context_switches() - switches_start) / tokens);
+}
+
+int main() {
+	// Logs nothing per event, so that only the scheduling is measured.
+	setenv("ILLIXR_METRICS_RAW_ROWS", "0", true);
+
+	const std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	const std::size_t tokens = 5000;
+	for (std::size_t stages : {2, 8}) {
+		bench_chain(stages, tokens, false, 0);
+		bench_chain(stages, tokens, true, 1);
+		if (cores > 1) {
+			bench_chain(stages, tokens, true, cores);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/bench/bench_util.hpp"
+#include "../common/threadloop.hpp"
+#include "../switchboard_impl.hpp"
+#include "../record_logger_spec.hpp"
+#include "../collector_record_logger.hpp"
+
+/*
+  The observer effect: the same small pipeline (a threadloop publishing to a switchboard callback,
+  each doing a fixed amount of work per event) run with the full instrumentation and with a noop
+  record_logger that has the per-event rows turned off.
+
+  - cpu_ns_per_event is the whole process's CPU time per event, including the collector and the
+    backend's threads; overhead_ns_per_event is its difference from the first (noop) scenario.
+  - self_accounted_ns_per_event is what the instrumentation_overhead rows of the run add up to
+    (threadloop, switchboard and collector sites; coalescer sites are nested in those, so they are
+    not added again). It should roughly agree with overhead_ns_per_event, minus backend threads.
+
+  The instrumentation is a few percent of the work here, which is about as much as the process CPU
+  time varies between runs on a busy or single-core machine; overhead_ns_per_event is only
+  meaningful when it is well above that, and self_accounted_ns_per_event is the steadier figure.
+
+  Backends write to metrics/ in the working directory, and print their own summaries to stderr.
+  Usage: `make bench/run` in runtime/, or `./bench/bench_instrumentation.exe`.
+*/
+
+using namespace ILLIXR;
+using namespace ILLIXR::bench;
+using bench_clock = std::chrono::steady_clock;
+
+struct work_event {
+	std::size_t seq;
+};
+
+/**
+ * A fixed amount of arithmetic, so that slower instrumentation shows up as more time, not less work.
+ */
+static void busy_work(std::size_t iterations) {
+	std::size_t x = 1;
+	for (std::size_t i = 0; i < iterations; ++i) {
+		x = x * 6364136223846793005u + 1442695040888963407u;
+	}
+	do_not_optimize(x);
+}
+
+static constexpr std::size_t WORK_ITERATIONS = 20000;
+
+class producer : public threadloop {
+public:
+	producer(std::string name_, phonebook* pb_, std::size_t events_)
+		: threadloop{name_, pb_}
+		, events{events_}
+		, _m_events{pb->lookup_impl<switchboard>()->publish<work_event>("bench_events")}
+		, pool(events_)
+	{ }
+
+protected:
+	virtual skip_option _p_should_skip() override {
+		return sent < events ? skip_option::run : skip_option::skip_and_yield;
+	}
+
+	virtual void _p_one_iteration() override {
+		busy_work(WORK_ITERATIONS);
+		pool[sent].seq = sent;
+		_m_events->put(&pool[sent]);
+		++sent;
+	}
+
+private:
+	const std::size_t events;
+	std::unique_ptr<writer<work_event>> _m_events;
+	std::vector<work_event> pool;
+	std::size_t sent = 0;
+};
+
+/**
+ * Adds up the estimated_time of the top-level instrumentation_overhead sites.
+ */
+class overhead_sum_record_logger : public record_logger {
+public:
+	std::atomic<std::int64_t> total_ns {0};
+
+protected:
+	virtual void log(const record& r) override {
+		if (r.get_record_header() == __instrumentation_overhead_header) {
+			const std::string site = r.get_value<std::string>(1);
+			if (site.rfind("record/", 0) != 0) {
+				total_ns += r.get_value<std::chrono::nanoseconds>(5).count();
+			}
+		}
+		r.mark_used();
+	}
+
+	virtual void log(const record_header&, const std::byte*, std::size_t) override { }
+};
+
+static std::chrono::nanoseconds process_cpu_time() {
+	return cpp_clock_gettime(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static double bench_pipeline(const std::string& spec, bool raw_rows, std::size_t events, double baseline_cpu_ns) {
+	setenv("ILLIXR_METRICS_RAW_ROWS", raw_rows ? "1" : "0", true);
+	auto overhead_sum = std::make_shared<overhead_sum_record_logger>();
+	std::atomic<std::size_t> received {0};
+
+	const auto cpu_start = process_cpu_time();
+	const auto wall_start = bench_clock::now();
+	{
+		phonebook pb;
+		std::shared_ptr<tee_record_logger> backends = create_record_logger(spec);
+		backends->add("overhead_sum", overhead_sum);
+		pb.register_impl<record_logger>(std::make_shared<collector_record_logger>(backends));
+		pb.register_impl<metrics_registry>(std::make_shared<metrics_registry>(pb.lookup_impl<record_logger>()));
+		pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+		auto sb = std::make_shared<switchboard_impl>(&pb);
+		pb.register_impl<switchboard>(sb);
+
+		const std::size_t consumer_id = pb.lookup_impl<gen_guid>()->get();
+		sb->schedule<work_event>(consumer_id, "bench_events", [&](const work_event*) {
+			busy_work(WORK_ITERATIONS);
+			received++;
+		});
+		{
+			producer p {"bench_producer", &pb, events};
+			p.start();
+			while (received.load() < events) {
+				std::this_thread::sleep_for(std::chrono::milliseconds{1});
+			}
+			p.stop();
+		}
+		sb->stop();
+	}
+	const double wall_ns = std::chrono::duration<double, std::nano>{bench_clock::now() - wall_start}.count();
+	const double cpu_ns = (process_cpu_time() - cpu_start).count();
+
+	report r {"instrumentation/pipeline"};
+	r.field("backend", spec)
+		.field("raw_rows", std::size_t{raw_rows})
+		.field("events", events)
+		.field("wall_ns_per_event", wall_ns / events)
+		.field("cpu_ns_per_event", cpu_ns / events)
+		.field("self_accounted_ns_per_event", static_cast<double>(overhead_sum->total_ns.load()) / events);
+	if (baseline_cpu_ns > 0) {
+		r.field("overhead_ns_per_event", (cpu_ns - baseline_cpu_ns) / events);
+	}
+	return cpu_ns;
+}
+
+int main() {
+	// Otherwise sqlite would drop what it cannot keep up with, and look cheaper than it is.
+	setenv("ILLIXR_SQLITE_OVERFLOW", "block", false);
+
+	const std::size_t events = 50000;
+	const double baseline = bench_pipeline("noop", false, events, 0);
+	bench_pipeline("noop", true, events, baseline);
+	bench_pipeline("mmap", true, events, baseline);
+	bench_pipeline("sqlite", true, events, baseline);
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/bench/bench_util.hpp"
+#include "../record_logger_spec.hpp"
+#include "../collector_record_logger.hpp"
+
+/*
+  The cost of each record_logger backend (as spelled in ILLIXR_RECORD_LOGGER), measured two ways:
+
+  - record_logger/direct: one thread hands the backend batches of rows, as the collector does.
+    ns_per_row includes shutting the backend down, so asynchronous backends (sqlite, sqlite_wal) pay for
+    everything they queued.
+  - record_logger/collected: N threads log through typed_record_coalescer and the collector, as
+    plugins do. log_ns_per_row is what a logging thread pays; drain_ms is how long shutdown
+    takes after the last row.
+
+  Backends write to metrics/ in the working directory, and print their own summaries to stderr.
+  Usage: `make bench/run` in runtime/, or `./bench/bench_record_logger.exe`.
+*/
+
+using namespace ILLIXR;
+using namespace ILLIXR::bench;
+using bench_clock = std::chrono::steady_clock;
+using time_point = std::chrono::high_resolution_clock::time_point;
+
+// Shaped like threadloop_iteration.
+static const record_type<std::size_t, std::size_t, std::size_t, std::chrono::nanoseconds, std::chrono::nanoseconds, time_point, time_point, std::size_t> bench_iteration {
+	"bench_iteration",
+	{
+		"plugin_id",
+		"iteration_no",
+		"skips",
+		"cpu_time_start",
+		"cpu_time_stop",
+		"wall_time_start",
+		"wall_time_stop",
+		"thread_id",
+	},
+};
+
+static double elapsed_ns(bench_clock::time_point start, bench_clock::time_point stop = bench_clock::now()) {
+	return std::chrono::duration<double, std::nano>{stop - start}.count();
+}
+
+static void bench_direct(const std::string& spec, std::size_t rows, std::size_t batch) {
+	decltype(bench_iteration)::row row {0, 0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, time_point{}, time_point{}, 0};
+	std::vector<decltype(bench_iteration)::row> batch_rows (batch, row);
+
+	auto start = bench_clock::now();
+	{
+		std::shared_ptr<record_logger> logger = create_record_logger(spec);
+		for (std::size_t i = 0; i < rows; i += batch) {
+			logger->log(bench_iteration, reinterpret_cast<const std::byte*>(batch_rows.data()), batch);
+		}
+	}
+	report{"record_logger/direct"}
+		.field("backend", spec)
+		.field("rows", rows)
+		.field("batch", batch)
+		.field("ns_per_row", elapsed_ns(start) / rows);
+}
+
+static void bench_collected(const std::string& spec, std::size_t threads, std::size_t rows_per_thread) {
+	std::vector<double> log_ns (threads);
+	bench_clock::time_point logged;
+	auto start = bench_clock::now();
+	{
+		auto logger = std::make_shared<collector_record_logger>(create_record_logger(spec));
+		std::atomic<bool> go {false};
+		std::vector<std::thread> workers;
+		for (std::size_t t = 0; t < threads; ++t) {
+			workers.emplace_back([&, t] {
+				decltype(bench_iteration)::coalescer it_log {logger, bench_iteration};
+				const time_point now = std::chrono::high_resolution_clock::now();
+				while (!go.load()) { }
+				auto thread_start = bench_clock::now();
+				for (std::size_t i = 0; i < rows_per_thread; ++i) {
+					it_log.log(t, i, 0, std::chrono::nanoseconds{i}, std::chrono::nanoseconds{i + 1}, now, now, t);
+				}
+				it_log.flush();
+				log_ns[t] = elapsed_ns(thread_start);
+			});
+		}
+		go.store(true);
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		logged = bench_clock::now();
+	}
+	double total_log_ns = 0;
+	for (double ns : log_ns) {
+		total_log_ns += ns;
+	}
+	report{"record_logger/collected"}
+		.field("backend", spec)
+		.field("threads", threads)
+		.field("rows", threads * rows_per_thread)
+		.field("log_ns_per_row", total_log_ns / (threads * rows_per_thread))
+		.field("drain_ms", elapsed_ns(logged) * 1e-6)
+		.field("total_ns_per_row", elapsed_ns(start) / (threads * rows_per_thread));
+}
+
+int main() {
+	// Otherwise sqlite would drop what it cannot keep up with, and look faster than it is.
+	setenv("ILLIXR_SQLITE_OVERFLOW", "block", false);
+
+	const std::vector<std::string> specs {
+		"noop",
+		"mmap",
+		"sqlite",
+		"sqlite_wal",
+		"mmap+sqlite",
+		"mmap+sqlite:!bench_*",
+	};
+	for (const std::string& spec : specs) {
+		bench_direct(spec, 1000000, 1024);
+	}
+	for (const std::string& spec : specs) {
+		for (std::size_t threads : {1, 4}) {
+			bench_collected(spec, threads, 250000);
+		}
+	}
+	return 0;
+}
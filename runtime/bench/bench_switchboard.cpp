@@ -0,0 +1,268 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/bench/bench_util.hpp"
+#include "../switchboard_impl.hpp"
+#include "../noop_record_logger.hpp"
+
+/*
+  Microbenchmarks for switchboard_impl, with a noop_record_logger so that only the messaging layer
+  is measured. Usage: `make bench/run` in runtime/, or `./bench/bench_switchboard.exe`.
+
+  Every scenario builds a fresh switchboard, so that topics and queues do not leak between them.
+  Switchboard also prints its own `thread,...` lines; results are the lines starting with `{`.
+*/
+
+using namespace ILLIXR;
+using namespace ILLIXR::bench;
+using bench_clock = std::chrono::steady_clock;
+
+struct stamped_event {
+	bench_clock::time_point sent;
+	std::size_t seq;
+};
+
+static std::size_t elapsed_ns(bench_clock::time_point start, bench_clock::time_point stop = bench_clock::now()) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+}
+
+class bench_runtime {
+public:
+	bench_runtime() {
+		pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+		pb.register_impl<metrics_registry>(std::make_shared<metrics_registry>(pb.lookup_impl<record_logger>()));
+		sb = std::make_shared<switchboard_impl>(&pb);
+	}
+	~bench_runtime() {
+		sb->stop();
+	}
+	phonebook pb;
+	std::shared_ptr<switchboard_impl> sb;
+};
+
+/**
+ * Wait (bounded) until the switchboard worker has run @p expected callbacks.
+ */
+static void wait_for(const std::atomic<std::size_t>& counter, std::size_t expected) {
+	auto deadline = bench_clock::now() + std::chrono::seconds{10};
+	while (counter.load() < expected && bench_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+/**
+ * put() throughput and per-call latency, with 1..N concurrent writers each on its own topic.
+ */
+static void bench_put(std::size_t writers, std::size_t puts_per_writer) {
+	static const stamped_event event {};
+	bench_runtime rt;
+
+	std::vector<std::unique_ptr<writer<stamped_event>>> handles;
+	for (std::size_t i = 0; i < writers; ++i) {
+		handles.push_back(rt.sb->publish<stamped_event>("put_" + std::to_string(i)));
+	}
+
+	std::vector<std::vector<std::size_t>> latencies (writers);
+	std::atomic<bool> go {false};
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < writers; ++i) {
+		latencies[i].reserve(puts_per_writer);
+		threads.emplace_back([&, i] {
+			while (!go.load()) { }
+			for (std::size_t j = 0; j < puts_per_writer; ++j) {
+				auto start = bench_clock::now();
+				handles[i]->put(&event);
+				latencies[i].push_back(elapsed_ns(start));
+			}
+		});
+	}
+
+	auto start = bench_clock::now();
+	go.store(true);
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	double total_ns = elapsed_ns(start);
+
+	std::vector<std::size_t> all;
+	for (const auto& l : latencies) {
+		all.insert(all.end(), l.begin(), l.end());
+	}
+	report r {"switchboard/put"};
+	r.field("writers", writers)
+		.field("iterations", all.size())
+		.field("puts_per_s", all.size() / total_ns * 1e9);
+	percentiles(r, all);
+}
+
+/**
+ * get_latest_ro() latency with N readers contending against one writer spinning on put().
+ */
+static void bench_get_latest_ro(std::size_t readers, std::size_t reads_per_reader) {
+	static const stamped_event event {};
+	bench_runtime rt;
+	auto w = rt.sb->publish<stamped_event>("latest");
+	w->put(&event);
+
+	std::atomic<bool> done {false};
+	std::thread writer_thread {[&] {
+		while (!done.load()) {
+			w->put(&event);
+		}
+	}};
+
+	std::vector<std::vector<std::size_t>> latencies (readers);
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < readers; ++i) {
+		latencies[i].reserve(reads_per_reader);
+		threads.emplace_back([&, i] {
+			auto r = rt.sb->subscribe_latest<stamped_event>("latest");
+			for (std::size_t j = 0; j < reads_per_reader; ++j) {
+				auto start = bench_clock::now();
+				do_not_optimize(r->get_latest_ro());
+				latencies[i].push_back(elapsed_ns(start));
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	done.store(true);
+	writer_thread.join();
+
+	std::vector<std::size_t> all;
+	for (const auto& l : latencies) {
+		all.insert(all.end(), l.begin(), l.end());
+	}
+	report r {"switchboard/get_latest_ro"};
+	r.field("readers", readers).field("iterations", all.size());
+	percentiles(r, all);
+}
+
+/**
+ * Latency from put() to the start of the scheduled callback.
+ *
+ * @p period of zero means back-to-back puts (queueing delay dominates); otherwise puts are paced.
+ */
+static void bench_dispatch(std::size_t events, std::chrono::nanoseconds period) {
+	std::vector<stamped_event> pool (events);
+	std::vector<std::size_t> latencies (events);
+	std::atomic<std::size_t> received {0};
+	{
+		bench_runtime rt;
+		rt.sb->schedule<stamped_event>(0, "dispatch", [&](const stamped_event* ev) {
+			latencies[ev->seq] = elapsed_ns(ev->sent);
+			received++;
+		});
+		auto w = rt.sb->publish<stamped_event>("dispatch");
+
+		auto next = bench_clock::now();
+		for (std::size_t i = 0; i < events; ++i) {
+			while (bench_clock::now() < next) { }
+			next += period;
+			pool[i] = stamped_event{bench_clock::now(), i};
+			w->put(&pool[i]);
+		}
+		wait_for(received, events);
+	}
+	latencies.resize(received.load());
+	report r {"switchboard/dispatch"};
+	r.field("period_ns", static_cast<std::size_t>(period.count())).field("iterations", latencies.size());
+	percentiles(r, latencies);
+}
+
+/**
+ * Cost of delivering one event to N callbacks on the same topic.
+ */
+static void bench_fan_out(std::size_t callbacks, std::size_t events) {
+	static const stamped_event event {};
+	std::atomic<std::size_t> received {0};
+	double total_ns;
+	{
+		bench_runtime rt;
+		for (std::size_t i = 0; i < callbacks; ++i) {
+			rt.sb->schedule<stamped_event>(i, "fan_out", [&](const stamped_event*) {
+				received++;
+			});
+		}
+		auto w = rt.sb->publish<stamped_event>("fan_out");
+
+		auto start = bench_clock::now();
+		for (std::size_t i = 0; i < events; ++i) {
+			w->put(&event);
+		}
+		wait_for(received, events * callbacks);
+		total_ns = elapsed_ns(start);
+	}
+	report{"switchboard/fan_out"}
+		.field("callbacks", callbacks)
+		.field("iterations", events)
+		.field("ns_per_event", total_ns / events)
+		.field("ns_per_callback", total_ns / (events * callbacks));
+}
+
+/**
+ * Setup cost and dispatch latency with many topics, each with one callback, written round-robin
+ * every @p period.
+ */
+static void bench_many_topics(std::size_t topics, std::size_t events, std::chrono::nanoseconds period) {
+	std::vector<stamped_event> pool (events);
+	std::vector<std::size_t> latencies (events);
+	std::atomic<std::size_t> received {0};
+	double setup_ns;
+	{
+		bench_runtime rt;
+		std::vector<std::unique_ptr<writer<stamped_event>>> handles;
+		auto setup_start = bench_clock::now();
+		for (std::size_t i = 0; i < topics; ++i) {
+			// Long enough to defeat std::string's small-string optimization, like real topic names.
+			std::string name = "many_topics_benchmark_topic_" + std::to_string(i);
+			rt.sb->schedule<stamped_event>(i, name, [&](const stamped_event* ev) {
+				latencies[ev->seq] = elapsed_ns(ev->sent);
+				received++;
+			});
+			handles.push_back(rt.sb->publish<stamped_event>(name));
+		}
+		setup_ns = elapsed_ns(setup_start);
+
+		auto next = bench_clock::now();
+		for (std::size_t i = 0; i < events; ++i) {
+			while (bench_clock::now() < next) { }
+			next += period;
+			pool[i] = stamped_event{bench_clock::now(), i};
+			handles[i % topics]->put(&pool[i]);
+		}
+		wait_for(received, events);
+	}
+	latencies.resize(received.load());
+	report r {"switchboard/many_topics"};
+	r.field("topics", topics)
+		.field("period_ns", static_cast<std::size_t>(period.count()))
+		.field("iterations", latencies.size())
+		.field("setup_ns_per_topic", setup_ns / topics);
+	percentiles(r, latencies);
+}
+
+int main() {
+	const std::size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+
+	for (std::size_t writers = 1; writers <= max_threads; writers *= 2) {
+		bench_put(writers, 200000);
+	}
+	for (std::size_t readers = 1; readers <= max_threads; readers *= 2) {
+		bench_get_latest_ro(readers, 1000000);
+	}
+	bench_dispatch(20000, std::chrono::microseconds{50});
+	bench_dispatch(200000, std::chrono::nanoseconds{0});
+	for (std::size_t callbacks : {1, 4, 16, 64}) {
+		bench_fan_out(callbacks, 100000);
+	}
+	for (std::size_t topics : {10, 1000, 4000}) {
+		bench_many_topics(topics, 50000, std::chrono::microseconds{20});
+	}
+	return 0;
+}
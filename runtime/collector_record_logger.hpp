@@ -0,0 +1,250 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "common/record_logger.hpp"
+#include "common/thread_scheduling.hpp"
+#include "sink_registry.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief A bounded single-producer, single-consumer ring buffer.
+ *
+ * Each side caches the other's index, so in the steady state a push or pop touches only its own
+ * cache line.
+ */
+template <typename T>
+class spsc_ring {
+public:
+	explicit spsc_ring(std::size_t capacity)
+		: slots(round_up_to_power_of_2(capacity))
+		, mask{slots.size() - 1}
+	{ }
+
+	/**
+	 * @brief Producer side. Returns false (and leaves @p value alone) if the ring is full.
+	 */
+	bool try_push(T&& value) {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head_cache == slots.size()) {
+			head_cache = head.load(std::memory_order_acquire);
+			if (t - head_cache == slots.size()) {
+				return false;
+			}
+		}
+		slots[t & mask] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Consumer side. Returns false if the ring is empty.
+	 */
+	bool try_pop(T& value) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail_cache) {
+			tail_cache = tail.load(std::memory_order_acquire);
+			if (h == tail_cache) {
+				return false;
+			}
+		}
+		value = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static std::size_t round_up_to_power_of_2(std::size_t n) {
+		std::size_t ret = 1;
+		while (ret < n) {
+			ret *= 2;
+		}
+		return ret;
+	}
+
+	std::vector<T> slots;
+	const std::size_t mask;
+	alignas(64) std::atomic<std::size_t> head {0};
+	std::size_t tail_cache = 0;
+	alignas(64) std::atomic<std::size_t> tail {0};
+	std::size_t head_cache = 0;
+};
+
+/**
+ * @brief The logging front end: gives each thread its own lock-free buffer, drained by one collector thread.
+ *
+ * Logging threads never contend with each other or wait on the backend. Each thread's first log
+ * call registers its buffer (see `sink_registry`); after that, a log call is a copy into the
+ * buffer and a release store. The collector wakes every `collect_period`, and hands everything it
+ * finds to the backend, so the backend only ever sees one thread.
+ *
+ * If a thread's buffer is full, its records are dropped (and counted) rather than blocking the
+ * thread; the counts are reported at shutdown.
+ */
+class collector_record_logger : public record_logger {
+private:
+	/**
+	 * @brief One call to `log`, as it travels through a thread's buffer.
+	 */
+	struct log_item {
+		// Set for fixed-layout rows; otherwise `records` holds the batch.
+		const record_header* rh = nullptr;
+		std::size_t count = 0;
+		std::vector<std::byte> rows;
+		std::vector<record> records;
+	};
+
+	struct thread_buffer {
+		explicit thread_buffer(std::size_t capacity)
+			: ring{capacity}
+		{ }
+
+		spsc_ring<log_item> ring;
+		std::atomic<std::size_t> dropped {0};
+	};
+
+public:
+	collector_record_logger(std::shared_ptr<record_logger> backend_,
+							std::size_t buffer_capacity_ = 1024,
+							std::chrono::milliseconds collect_period_ = std::chrono::milliseconds{10})
+		: backend{std::move(backend_)}
+		, buffer_capacity{buffer_capacity_}
+		, collect_period{collect_period_}
+		, collector{std::bind(&collector_record_logger::collect, this)}
+	{ }
+
+	virtual ~collector_record_logger() override {
+		terminate.store(true);
+		collector.join();
+		// The collector thread exists only for instrumentation, so all of its time is overhead.
+		if (__instrumentation_overhead_header.should_log()) {
+			log_overhead(record{__instrumentation_overhead_header, {
+				{collector_thread_id},
+				{std::string{"collector"}},
+				{collect_passes},
+				{collect_passes},
+				{collector_cpu_time},
+				{collector_cpu_time},
+			}});
+		}
+		// Anything logged before this point is in a buffer; get it to the backend.
+		collect_once();
+
+		std::size_t dropped = 0;
+		buffers.for_each([&](thread_buffer& buffer) {
+			dropped += buffer.dropped.load();
+		});
+		std::cerr << "Collected " << collected << " records from " << threads << " threads";
+		if (dropped) {
+			std::cerr << "; " << dropped << " dropped because a thread's log buffer was full";
+		}
+		std::cerr << std::endl;
+	}
+
+protected:
+	virtual void log(const record& r) override {
+		log_item item;
+		item.count = 1;
+		item.records.push_back(r);
+		push(std::move(item));
+	}
+
+	virtual void log(const std::vector<record>& rs) override {
+		if (!rs.empty()) {
+			log_item item;
+			item.count = rs.size();
+			item.records = rs;
+			push(std::move(item));
+		}
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		if (count) {
+			log_item item;
+			item.rh = &rh;
+			item.count = count;
+			item.rows.assign(rows, rows + count * rh.get_row_size());
+			push(std::move(item));
+		}
+	}
+
+	virtual void log_overhead(const record& r) override {
+		log(r);
+	}
+
+private:
+	thread_buffer& local_buffer() {
+		return buffers.get_or_create(std::hash<std::thread::id>{}(std::this_thread::get_id()), [this] {
+			threads++;
+			return std::make_unique<thread_buffer>(buffer_capacity);
+		});
+	}
+
+	void push(log_item&& item) {
+		thread_buffer& buffer = local_buffer();
+		std::size_t count = item.count;
+		if (!buffer.ring.try_push(std::move(item))) {
+			for (const record& r : item.records) {
+				r.mark_used();
+			}
+			buffer.dropped += count;
+		}
+	}
+
+	void collect() {
+		std::cout << "thread," << std::this_thread::get_id() << ",record_logger collector," << std::endl;
+		thread_scheduling::apply("collector");
+		while (!terminate.load()) {
+			++collect_passes;
+			if (!collect_once()) {
+				std::this_thread::sleep_for(collect_period);
+			}
+		}
+		collector_cpu_time = thread_cpu_time();
+		collector_thread_id = kernel_thread_id();
+	}
+
+	/**
+	 * @brief Drains every thread's buffer into the backend once. Returns whether there was anything.
+	 */
+	bool collect_once() {
+		bool any = false;
+		buffers.for_each([&](thread_buffer& buffer) {
+			while (buffer.ring.try_pop(item)) {
+				any = true;
+				collected += item.count;
+				if (item.rh) {
+					backend->log(*item.rh, item.rows.data(), item.count);
+				} else {
+					backend->log(item.records);
+				}
+				// Keep the allocations out of the ring, but let the consumer own them.
+				item.rows.clear();
+				item.records.clear();
+			}
+		});
+		return any;
+	}
+
+	const std::shared_ptr<record_logger> backend;
+	const std::size_t buffer_capacity;
+	const std::chrono::milliseconds collect_period;
+	sink_registry<thread_buffer> buffers;
+	// Only touched by the collector (and by the destructor, after the collector has stopped).
+	log_item item;
+	std::size_t collected = 0;
+	std::size_t collect_passes = 0;
+	std::chrono::nanoseconds collector_cpu_time {0};
+	std::size_t collector_thread_id = 0;
+	std::atomic<std::size_t> threads {0};
+	std::atomic<bool> terminate {false};
+	std::thread collector;
+};
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "common/record_logger.hpp"
+#include "sink_registry.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Passes only some tables (by record_header name) through to another backend.
+ *
+ * A pattern is a table name, or a prefix followed by `*`. If @p exclude_ is set, the matching
+ * tables are the ones dropped instead. The decision is made once per record_header and cached, so
+ * a log call costs one lock-free lookup.
+ */
+class filter_record_logger : public record_logger {
+public:
+	filter_record_logger(std::shared_ptr<record_logger> backend_, std::vector<std::string> patterns_, bool exclude_ = false)
+		: backend{std::move(backend_)}
+		, patterns{std::move(patterns_)}
+		, exclude{exclude_}
+	{ }
+
+protected:
+	virtual void log(const record& r) override {
+		if (passes(r.get_record_header())) {
+			backend->log(r);
+		} else {
+			r.mark_used();
+		}
+	}
+
+	virtual void log(const std::vector<record>& rs) override {
+		if (rs.empty()) {
+		} else if (passes(rs[0].get_record_header())) {
+			backend->log(rs);
+		} else {
+			for (const record& r : rs) {
+				r.mark_used();
+			}
+		}
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		if (passes(rh)) {
+			backend->log(rh, rows, count);
+		}
+	}
+
+private:
+	bool passes(const record_header& rh) {
+		return decisions.get_or_create(rh.get_id(), [&] {
+			return std::make_unique<bool>(matches(rh.get_name()) != exclude);
+		});
+	}
+
+	bool matches(const std::string& name) const {
+		for (const std::string& pattern : patterns) {
+			if (name_matches(pattern, name)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const std::shared_ptr<record_logger> backend;
+	const std::vector<std::string> patterns;
+	const bool exclude;
+	sink_registry<bool> decisions;
+};
+
+}
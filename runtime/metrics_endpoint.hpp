@@ -0,0 +1,231 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <experimental/filesystem>
+#include "common/metrics.hpp"
+#include "common/thread_scheduling.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Serves the metrics_registry's histograms and gauges while the system runs.
+ *
+ * - If `ILLIXR_METRICS_PORT` is set, `curl localhost:<port>/metrics` returns them in the Prometheus
+ *   text format. The socket is bound to 127.0.0.1 only.
+ * - `kill -USR1 <pid>` writes the same text to `metrics/snapshot_<unix time>.prom`.
+ *
+ * Both read only what the registry's reporter last summarized (see
+ * `metrics_registry::write_prometheus`), from this object's own thread, so neither adds anything to
+ * the components' hot paths. The thread sleeps in `poll` until a request or signal arrives.
+ */
+class metrics_endpoint {
+public:
+	explicit metrics_endpoint(std::shared_ptr<metrics_registry> metrics_, int port = port_from_env())
+		: metrics{std::move(metrics_)}
+	{
+		// Non-blocking, so that neither the handler nor the destructor can block on a full pipe.
+		if (pipe2(_m_wakeup, O_NONBLOCK | O_CLOEXEC) != 0) {
+			throw std::runtime_error{std::string{"metrics_endpoint: pipe: "} + std::strerror(errno)};
+		}
+		if (port) {
+			listen_on(port);
+		}
+
+		// The handler can only do async-signal-safe things, so it just wakes the thread up. If the pipe
+		// is full (EAGAIN), a dump is pending already, and one is enough.
+		signal_pipe = _m_wakeup[1];
+		struct sigaction action {};
+		action.sa_handler = [](int) {
+			// The interrupted code may be about to read errno.
+			const int saved_errno = errno;
+			const char byte = dump_request;
+			[[maybe_unused]] ssize_t ret = write(signal_pipe, &byte, 1);
+			errno = saved_errno;
+		};
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &action, &_m_old_action);
+
+		_m_thread = std::thread{[this] { serve(); }};
+	}
+
+	metrics_endpoint(const metrics_endpoint&) = delete;
+	metrics_endpoint& operator=(const metrics_endpoint&) = delete;
+
+	~metrics_endpoint() {
+		sigaction(SIGUSR1, &_m_old_action, nullptr);
+		// If the pipe is full, the thread wakes up anyway, and sees the flag.
+		_m_stopping.store(true);
+		const char byte = 0;
+		[[maybe_unused]] ssize_t ret = write(_m_wakeup[1], &byte, 1);
+		_m_thread.join();
+		signal_pipe = -1;
+		if (_m_listener != -1) {
+			close(_m_listener);
+		}
+		close(_m_wakeup[0]);
+		close(_m_wakeup[1]);
+	}
+
+	/**
+	 * @brief The port from `ILLIXR_METRICS_PORT`, or 0 (no HTTP) if it is unset.
+	 */
+	static int port_from_env() {
+		const char* port = std::getenv("ILLIXR_METRICS_PORT");
+		return port && *port ? std::stoi(port) : 0;
+	}
+
+private:
+	static constexpr char dump_request = 'd';
+	static inline volatile int signal_pipe = -1;
+
+	void listen_on(int port) {
+		_m_listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		const int reuse = 1;
+		setsockopt(_m_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (_m_listener == -1
+			|| bind(_m_listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0
+			|| listen(_m_listener, 4) != 0) {
+			// Not worth stopping the run for.
+			std::cerr << "metrics_endpoint: cannot listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << std::endl;
+			if (_m_listener != -1) {
+				close(_m_listener);
+				_m_listener = -1;
+			}
+		} else {
+			std::cerr << "metrics_endpoint: serving http://127.0.0.1:" << port << "/metrics" << std::endl;
+		}
+	}
+
+	void serve() {
+		thread_scheduling::apply("metrics_endpoint");
+		pollfd fds[2] {
+			{_m_wakeup[0], POLLIN, 0},
+			{_m_listener, POLLIN, 0},
+		};
+		const nfds_t nfds = _m_listener == -1 ? 1 : 2;
+		while (true) {
+			if (poll(fds, nfds, -1) < 0) {
+				continue;
+			}
+			if (fds[0].revents & POLLIN) {
+				// Drains the pipe: however many signals arrived, one dump covers them.
+				bool dump_requested = false;
+				char bytes[64];
+				ssize_t n;
+				while ((n = read(_m_wakeup[0], bytes, sizeof(bytes))) > 0) {
+					dump_requested |= std::memchr(bytes, dump_request, n) != nullptr;
+				}
+				if (_m_stopping.load()) {
+					return;
+				}
+				if (dump_requested) {
+					dump();
+				}
+			}
+			if (nfds == 2 && (fds[1].revents & POLLIN)) {
+				const int client = accept4(_m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if (client != -1) {
+					respond(client);
+					close(client);
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Writes a snapshot to `metrics/`; a failure is reported, and the endpoint keeps serving.
+	 */
+	void dump() {
+		const std::experimental::filesystem::path dir {"metrics"};
+		const std::experimental::filesystem::path path = dir / ("snapshot_" + std::to_string(std::time(nullptr)) + ".prom");
+		try {
+			std::experimental::filesystem::create_directories(dir);
+			std::ofstream out {path};
+			metrics->write_prometheus(out);
+			out.close();
+			if (!out) {
+				std::cerr << "metrics_endpoint: could not write " << path.string() << std::endl;
+				return;
+			}
+		} catch (const std::exception& e) {
+			std::cerr << "metrics_endpoint: could not write " << path.string() << ": " << e.what() << std::endl;
+			return;
+		}
+		std::cerr << "metrics_endpoint: wrote " << path.string() << std::endl;
+	}
+
+	/**
+	 * @brief Answers one HTTP request; anything but `GET /metrics` (or `GET /`) gets a 404.
+	 */
+	void respond(int client) {
+		// A client that never finishes its request should not hold up the next one for long.
+		const timeval timeout {1, 0};
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		std::string request;
+		char buf[1024];
+		while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+			const ssize_t n = recv(client, buf, sizeof(buf), 0);
+			if (n <= 0) {
+				break;
+			}
+			request.append(buf, n);
+		}
+
+		std::ostringstream body;
+		std::string status = "200 OK";
+		if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0) {
+			metrics->write_prometheus(body);
+		} else {
+			status = "404 Not Found";
+			body << "Try GET /metrics\n";
+		}
+		const std::string content = body.str();
+		std::ostringstream response;
+		response << "HTTP/1.0 " << status << "\r\n"
+				 << "Content-Type: text/plain; version=0.0.4\r\n"
+				 << "Content-Length: " << content.size() << "\r\n"
+				 << "Connection: close\r\n\r\n"
+				 << content;
+		const std::string bytes = response.str();
+		for (std::size_t sent = 0; sent < bytes.size(); ) {
+			const ssize_t n = send(client, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0) {
+				break;
+			}
+			sent += n;
+		}
+	}
+
+	const std::shared_ptr<metrics_registry> metrics;
+	int _m_wakeup[2];
+	int _m_listener = -1;
+	std::atomic<bool> _m_stopping {false};
+	struct sigaction _m_old_action;
+	std::thread _m_thread;
+};
+
+}
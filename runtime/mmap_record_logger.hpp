@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <experimental/filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "common/record_logger.hpp"
+#include "common/cpu_timer.hpp"
+#include "common/columnar_log.hpp"
+#include "sink_registry.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief One table of an `mmap_record_logger`: an append-only columnar file (see common/columnar_log.hpp).
+ *
+ * Appending is lock-free. Each thread appends blocks to its own extent of the file; only claiming
+ * a fresh extent (once per columnar::EXTENT_BYTES) touches shared state, and that is one fetch_add
+ * plus a syscall or two. Encoding a block is a transposition of the rows, so the cost per row is
+ * close to a memcpy.
+ */
+class mmap_table {
+public:
+	/**
+	 * @brief A thread's position in the extent it owns.
+	 */
+	struct cursor {
+		std::byte* pos = nullptr;
+		std::byte* end = nullptr;
+	};
+
+	mmap_table(const record_header& rh_, const std::experimental::filesystem::path& dir)
+		: table_name{rh_.get_name()}
+		, serial{next_serial++}
+		, encoder{column_types(rh_)}
+		, path{dir / (rh_.get_name() + std::string{".ilxc"})}
+	{
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::runtime_error{"Could not open " + path.string() + ": " + std::strerror(errno)};
+		}
+		std::vector<std::pair<std::string, columnar::column_type>> columns;
+		for (unsigned i = 0; i < rh_.get_columns(); ++i) {
+			columns.emplace_back(rh_.get_column_name(i), encoder.get_types()[i]);
+		}
+		std::vector<std::byte> header = columnar::encode_file_header(table_name, columns);
+		if (::pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())
+			|| ::ftruncate(fd, columnar::HEADER_BYTES) != 0) {
+			throw std::runtime_error{"Could not write " + path.string() + ": " + std::strerror(errno)};
+		}
+	}
+
+	mmap_table(const mmap_table&) = delete;
+	mmap_table& operator=(const mmap_table&) = delete;
+
+	~mmap_table() {
+		for (std::byte* extent : extents) {
+			::munmap(extent, columnar::EXTENT_BYTES);
+		}
+		::close(fd);
+		std::cerr << "Closed " << table_name << " (mmap); " << rows.load() << " rows in " << extents.size() << " extents";
+		if (dropped.load()) {
+			std::cerr << "; " << dropped.load() << " dropped";
+		}
+		std::cerr << std::endl;
+	}
+
+	/**
+	 * @brief Appends rows [0, count) of @p src from the calling thread.
+	 *
+	 * `Source` is as in `columnar::block_encoder`.
+	 */
+	template <typename Source>
+	void append(const Source& src, std::size_t count) {
+		thread_local std::vector<uint8_t> widths;
+		cursor& cur = local_cursor();
+		std::size_t first = 0;
+		while (first < count) {
+			std::size_t n = count - first;
+			std::size_t size = encoder.measure(src, first, n, widths);
+			// Shrink the block until it fits in what is left of this extent.
+			while (n > 0 && size > static_cast<std::size_t>(cur.end - cur.pos)) {
+				n = std::min(n - 1, n * static_cast<std::size_t>(cur.end - cur.pos) / size);
+				size = n ? encoder.measure(src, first, n, widths) : 0;
+			}
+			if (n == 0) {
+				if (cur.pos != nullptr && cur.pos == extent_start(cur)) {
+					// Not even one row fits in an empty extent.
+					dropped += 1;
+					++first;
+				} else if (!claim_extent(cur)) {
+					dropped += count - first;
+					return;
+				}
+				continue;
+			}
+			encoder.encode(src, first, n, widths, static_cast<uint32_t>(kernel_thread_id()), cur.pos, size);
+			cur.pos += size;
+			rows += n;
+			first += n;
+		}
+	}
+
+private:
+	cursor& local_cursor() {
+		// Keyed by serial rather than by `this`, so a table allocated where a dead one was does not
+		// inherit its cursors. Serials are never reused.
+		thread_local std::unordered_map<std::uint64_t, cursor> cursors;
+		return cursors[serial];
+	}
+
+	static std::byte* extent_start(const cursor& cur) {
+		return cur.end - columnar::EXTENT_BYTES;
+	}
+
+	/**
+	 * @brief Points @p cur at a fresh extent at the end of the file. Returns false if the disk is full.
+	 */
+	bool claim_extent(cursor& cur) {
+		std::size_t index = next_extent++;
+		off_t offset = columnar::HEADER_BYTES + index * columnar::EXTENT_BYTES;
+		// Unlike ftruncate, this only ever grows the file, so threads claiming extents concurrently
+		// cannot shrink each other's.
+		int err = ::posix_fallocate(fd, offset, columnar::EXTENT_BYTES);
+		if (err != 0) {
+			std::cerr << "Could not grow " << path << ": " << std::strerror(err) << std::endl;
+			return false;
+		}
+		void* extent = ::mmap(nullptr, columnar::EXTENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+		if (extent == MAP_FAILED) {
+			std::cerr << "Could not map " << path << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		{
+			const std::lock_guard lock{_m_extents_lock};
+			extents.push_back(static_cast<std::byte*>(extent));
+		}
+		cur.pos = static_cast<std::byte*>(extent);
+		cur.end = cur.pos + columnar::EXTENT_BYTES;
+		return true;
+	}
+
+	static std::vector<columnar::column_type> column_types(const record_header& rh) {
+		std::vector<columnar::column_type> ret;
+		for (unsigned i = 0; i < rh.get_columns(); ++i) {
+			ret.push_back(columnar::column_type_of(rh.get_column_type(i)));
+		}
+		return ret;
+	}
+
+	static inline std::atomic<std::uint64_t> next_serial {0};
+
+	const std::string table_name;
+	const std::uint64_t serial;
+	const columnar::block_encoder encoder;
+	const std::experimental::filesystem::path path;
+	int fd;
+	std::atomic<std::size_t> next_extent {0};
+	std::atomic<std::size_t> rows {0};
+	std::atomic<std::size_t> dropped {0};
+	std::vector<std::byte*> extents;
+	std::mutex _m_extents_lock;
+};
+
+/**
+ * @brief A record_logger that writes each table to an append-only, mmap'd columnar file.
+ *
+ * Much cheaper per row than `sqlite_record_logger`: there is no writer thread and no queue; the
+ * logging thread encodes its rows straight into the page cache. Files land in `metrics/<table>.ilxc`;
+ * convert them after the run with `tools/metrics_convert`.
+ */
+class mmap_record_logger : public record_logger {
+private:
+	/**
+	 * @brief Rows of a fixed-layout batch, as a `columnar::block_encoder` source.
+	 */
+	struct packed_rows {
+		const record_header& rh;
+		const std::byte* rows;
+
+		template <typename T>
+		T get(std::size_t row, unsigned column) const {
+			if constexpr (std::is_trivially_copyable_v<T>) {
+				return get_row_value<T>(rh, rows + row * rh.get_row_size(), column);
+			} else {
+				throw std::logic_error{"fixed-layout rows have no non-trivial columns"};
+			}
+		}
+	};
+
+	/**
+	 * @brief A run of dynamic records, as a `columnar::block_encoder` source.
+	 */
+	struct dynamic_rows {
+		const record* records;
+
+		template <typename T>
+		T get(std::size_t row, unsigned column) const {
+			return records[row].get_value<T>(column);
+		}
+	};
+
+	mmap_table& get_table(const record_header& rh) {
+		return registered_tables.get_or_create(rh.get_id(), [&] {
+			return std::make_unique<mmap_table>(rh, dir);
+		});
+	}
+
+public:
+	mmap_record_logger()
+		: dir{"metrics"}
+	{
+		if (!std::experimental::filesystem::exists(dir)) {
+			std::experimental::filesystem::create_directory(dir);
+		}
+	}
+
+protected:
+	virtual void log(const record& r) override {
+		get_table(r.get_record_header()).append(dynamic_rows{&r}, 1);
+		r.mark_used();
+	}
+
+	virtual void log(const std::vector<record>& rs) override {
+		if (!rs.empty()) {
+			get_table(rs[0].get_record_header()).append(dynamic_rows{rs.data()}, rs.size());
+			for (const record& r : rs) {
+				r.mark_used();
+			}
+		}
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		if (count) {
+			get_table(rh).append(packed_rows{rh, rows}, count);
+		}
+	}
+
+private:
+	const std::experimental::filesystem::path dir;
+	sink_registry<mmap_table> registered_tables;
+};
+
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <sstream>
 #include "common/record_logger.hpp"
@@ -8,5 +10,7 @@ namespace ILLIXR {
 		virtual void log(const record& r) override {
 			r.mark_used();
 		}
+
+		virtual void log(const record_header&, const std::byte*, std::size_t) override { }
 	};
 }
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/record_logger.hpp"
+#include "common/recent_records.hpp"
+#include "sink_registry.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Keeps the last `capacity` records of each table, for `recent_records` queries.
+ *
+ * This is a record_logger backend; the runtime tees it next to the configured ones, so it sees
+ * everything the collector drains, on the collector's thread. Fixed-layout rows are kept packed,
+ * and only unpacked into `record`s when queried or when a table has subscribers.
+ */
+class recent_records_impl : public record_logger, public recent_records {
+private:
+	/**
+	 * @brief The ring of one table, plus its subscribers. Everything is guarded by `lock`.
+	 */
+	struct table_ring {
+		explicit table_ring(std::size_t capacity_)
+			: capacity{capacity_}
+		{ }
+
+		const std::size_t capacity;
+		mutable std::mutex lock;
+		// Set by the first log call.
+		const record_header* rh = nullptr;
+		// Slot i of the ring is rows[i * row_size] if the table has a fixed layout, else records[i].
+		std::vector<std::byte> rows;
+		std::vector<record> records;
+		// Index of the next slot to write, and how many slots hold records.
+		std::size_t next = 0;
+		std::size_t size = 0;
+		std::vector<std::pair<std::size_t, callback>> subscribers;
+
+		void push_row(const record_header& rh_, const std::byte* row) {
+			set_header(rh_);
+			std::copy_n(row, rh->get_row_size(), rows.data() + next * rh->get_row_size());
+			advance();
+		}
+
+		void push_record(const record& r) {
+			set_header(r.get_record_header());
+			if (rh->has_fixed_layout()) {
+				record_logger::pack_row(r, rows.data() + next * rh->get_row_size());
+			} else {
+				records[next] = r;
+				records[next].mark_used();
+			}
+			advance();
+		}
+
+		/**
+		 * @brief The record in the @p age-th most recent slot (0 is the newest).
+		 */
+		record at(std::size_t age) const {
+			std::size_t slot = (next + capacity - 1 - age) % capacity;
+			record ret = rh->has_fixed_layout()
+				? record_logger::unpack_row(*rh, rows.data() + slot * rh->get_row_size())
+				: records[slot];
+			ret.mark_used();
+			return ret;
+		}
+
+		void notify(const record& r) const {
+			for (const auto& subscriber : subscribers) {
+				subscriber.second(r);
+			}
+		}
+
+	private:
+		void set_header(const record_header& rh_) {
+			if (!rh) {
+				rh = &rh_;
+				if (rh->has_fixed_layout()) {
+					rows.resize(capacity * rh->get_row_size());
+				} else {
+					records.resize(capacity);
+				}
+			}
+		}
+
+		void advance() {
+			next = (next + 1) % capacity;
+			size = std::min(size + 1, capacity);
+		}
+	};
+
+	class subscription_impl : public subscription {
+	public:
+		subscription_impl(table_ring& table_, std::size_t id_)
+			: table{table_}
+			, id{id_}
+		{ }
+
+		virtual ~subscription_impl() override {
+			const std::lock_guard lock{table.lock};
+			table.subscribers.erase(std::find_if(table.subscribers.begin(), table.subscribers.end(), [this](const auto& subscriber) {
+				return subscriber.first == id;
+			}));
+		}
+
+	private:
+		table_ring& table;
+		const std::size_t id;
+	};
+
+public:
+	explicit recent_records_impl(std::size_t capacity_)
+		: capacity{std::max<std::size_t>(capacity_, 1)}
+	{ }
+
+	/**
+	 * @brief Records kept per table, from `ILLIXR_RECENT_RECORDS` (default 256; 0 turns this off).
+	 */
+	static std::size_t capacity_from_env() {
+		const char* capacity = std::getenv("ILLIXR_RECENT_RECORDS");
+		return capacity ? std::stoul(capacity) : 256;
+	}
+
+	virtual std::vector<record> query(const std::string& table_name, std::size_t count) const override {
+		std::vector<record> ret;
+		if (const table_ring* table = tables.find(std::hash<std::string>{}(table_name))) {
+			const std::lock_guard lock{table->lock};
+			ret.reserve(std::min(count, table->size));
+			for (std::size_t age = std::min(count, table->size); age-- > 0; ) {
+				ret.push_back(table->at(age));
+			}
+		}
+		return ret;
+	}
+
+	virtual std::unique_ptr<subscription> subscribe(const std::string& table_name, callback cb) override {
+		// record_header ids are the hash of the name, so this finds the table that log will use.
+		table_ring& table = get_table(std::hash<std::string>{}(table_name));
+		const std::size_t id = ++last_subscription_id;
+		const std::lock_guard lock{table.lock};
+		table.subscribers.emplace_back(id, std::move(cb));
+		return std::make_unique<subscription_impl>(table, id);
+	}
+
+protected:
+	virtual void log(const record& r) override {
+		table_ring& table = get_table(r.get_record_header().get_id());
+		const std::lock_guard lock{table.lock};
+		table.push_record(r);
+		table.notify(r);
+		r.mark_used();
+	}
+
+	virtual void log(const std::vector<record>& rs) override {
+		if (!rs.empty()) {
+			table_ring& table = get_table(rs[0].get_record_header().get_id());
+			const std::lock_guard lock{table.lock};
+			// Only the last `capacity` can survive.
+			for (std::size_t i = rs.size() - std::min(rs.size(), capacity); i < rs.size(); ++i) {
+				table.push_record(rs[i]);
+			}
+			for (const record& r : rs) {
+				table.notify(r);
+				r.mark_used();
+			}
+		}
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		table_ring& table = get_table(rh.get_id());
+		const std::lock_guard lock{table.lock};
+		for (std::size_t i = count - std::min(count, capacity); i < count; ++i) {
+			table.push_row(rh, rows + i * rh.get_row_size());
+		}
+		if (!table.subscribers.empty()) {
+			for (std::size_t i = 0; i < count; ++i) {
+				const record r = unpack_row(rh, rows + i * rh.get_row_size());
+				table.notify(r);
+				r.mark_used();
+			}
+		}
+	}
+
+private:
+	table_ring& get_table(std::size_t id) {
+		return tables.get_or_create(id, [this] {
+			return std::make_unique<table_ring>(capacity);
+		});
+	}
+
+	const std::size_t capacity;
+	sink_registry<table_ring> tables;
+	std::atomic<std::size_t> last_subscription_id {0};
+};
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common/record_logger.hpp"
+#include "stdout_record_logger.hpp"
+#include "noop_record_logger.hpp"
+#include "sqlite_record_logger.hpp"
+#include "mmap_record_logger.hpp"
+#include "filter_record_logger.hpp"
+#include "tee_record_logger.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Constructs one record_logger backend by name.
+ */
+static std::shared_ptr<record_logger> create_record_logger_backend(const std::string& backend) {
+	if (false) {
+	} else if (backend == "sqlite") {
+		return std::make_shared<sqlite_record_logger>();
+	} else if (backend == "sqlite_wal") {
+		return std::make_shared<sqlite_wal_record_logger>();
+	} else if (backend == "mmap") {
+		return std::make_shared<mmap_record_logger>();
+	} else if (backend == "stdout") {
+		return std::make_shared<stdout_record_logger>();
+	} else if (backend == "noop") {
+		return std::make_shared<noop_record_logger>();
+	} else {
+		throw std::runtime_error{"record_logger backend should be sqlite, sqlite_wal, mmap, stdout or noop, not " + backend};
+	}
+}
+
+static std::vector<std::string> split_spec(const std::string& str, char delimiter) {
+	std::vector<std::string> ret;
+	std::size_t begin = 0;
+	for (std::size_t end; (end = str.find(delimiter, begin)) != std::string::npos; begin = end + 1) {
+		ret.push_back(str.substr(begin, end - begin));
+	}
+	ret.push_back(str.substr(begin));
+	return ret;
+}
+
+/**
+ * @brief Builds the record_logger described by @p spec (from `ILLIXR_RECORD_LOGGER`).
+ *
+ * The spec is one or more backends joined by `+`, each of which gets every record. A backend may
+ * be followed by `:` and a comma-separated list of tables (record_header names, or prefixes ending
+ * in `*`) to restrict it to, or `:!` and a list of tables to leave out. For example,
+ * `mmap+sqlite:threadloop_iteration,mtp_record` writes everything to mmap and two tables to SQLite;
+ * `sqlite:!switchboard_*` writes all but the switchboard tables. The runner sets this from the
+ * `record_logger` key of its config.
+ */
+static std::shared_ptr<tee_record_logger> create_record_logger(const std::string& spec) {
+	// Always a tee, even of one backend, so that every run reports what its backends cost.
+	auto tee = std::make_shared<tee_record_logger>();
+	for (const std::string& sink : split_spec(spec, '+')) {
+		const std::size_t colon = sink.find(':');
+		std::shared_ptr<record_logger> backend = create_record_logger_backend(sink.substr(0, colon));
+		if (colon != std::string::npos) {
+			std::string tables = sink.substr(colon + 1);
+			const bool exclude = !tables.empty() && tables[0] == '!';
+			backend = std::make_shared<filter_record_logger>(backend, split_spec(tables.substr(exclude ? 1 : 0), ','), exclude);
+		}
+		tee->add(sink, std::move(backend));
+	}
+	return tee;
+}
+
+}
@@ -4,18 +4,42 @@
 #include "common/extended_window.hpp"
 #include "common/dynamic_lib.hpp"
 #include "common/plugin.hpp"
+#include "common/metrics.hpp"
 #include "switchboard_impl.hpp"
-#include "stdout_record_logger.hpp"
-#include "noop_record_logger.hpp"
-#include "sqlite_record_logger.hpp"
+#include "record_logger_spec.hpp"
+#include "collector_record_logger.hpp"
+#include "recent_records_impl.hpp"
+#include "metrics_endpoint.hpp"
+#include "signal_stall_watchdog.hpp"
+#include "timer_probe.hpp"
+#include "work_stealing_executor.hpp"
 
 using namespace ILLIXR;
 
 class runtime_impl : public runtime {
 public:
 	runtime_impl(GLXContext appGLCtx) {
-		pb.register_impl<record_logger>(std::make_shared<sqlite_record_logger>());
+		// Calibrates the instrumentation clock, and passes the calibration on to the plugins loaded
+		// later; this sets the environment, so it comes before any other thread starts.
+		tsc_clock::export_calibration();
+		// A malformed ILLIXR_THREAD_SCHEDULING stops the runtime here, with its message, rather than
+		// terminating whichever thread applies it first. (ILLIXR_TIMER_PROBE is parsed on this thread too.)
+		thread_scheduling::from_env();
+		const char* record_logger_spec = std::getenv("ILLIXR_RECORD_LOGGER");
+		std::shared_ptr<tee_record_logger> backends = create_record_logger(record_logger_spec && *record_logger_spec ? record_logger_spec : "sqlite");
+		const std::size_t recent_capacity = recent_records_impl::capacity_from_env();
+		auto recent = std::make_shared<recent_records_impl>(recent_capacity);
+		if (recent_capacity) {
+			backends->add("recent_records", recent);
+		}
+		pb.register_impl<recent_records>(recent);
+		pb.register_impl<record_logger>(std::make_shared<collector_record_logger>(backends));
+		pb.register_impl<metrics_registry>(std::make_shared<metrics_registry>(pb.lookup_impl<record_logger>()));
+		endpoint = std::make_unique<metrics_endpoint>(pb.lookup_impl<metrics_registry>());
+		probe = timer_probe::from_env(pb.lookup_impl<metrics_registry>());
 		pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+		pb.register_impl<executor>(work_stealing_executor::from_env());
+		pb.register_impl<stall_watchdog>(signal_stall_watchdog::from_env(pb.lookup_impl<record_logger>()));
 		pb.register_impl<switchboard>(create_switchboard(&pb));
 		pb.register_impl<xlib_gl_extended_window>(std::make_shared<xlib_gl_extended_window>(448*2, 320*2, appGLCtx));
 	}
@@ -42,6 +66,10 @@ public:
 		for (const std::unique_ptr<plugin>& plugin : plugins) {
 			plugin->stop();
 		}
+		// Only once nothing runs on it anymore.
+		pb.lookup_impl<executor>()->stop();
+		pb.lookup_impl<stall_watchdog>()->stop();
+		probe.reset();
 		terminate.store(true);
 	}
 
@@ -56,6 +84,9 @@ private:
 	// I have to keep the dynamic libs in scope until the program is dead
 	std::vector<dynamic_lib> libs;
 	phonebook pb;
+	// Declared after pb, so it stops reading the metrics_registry first.
+	std::unique_ptr<metrics_endpoint> endpoint;
+	std::unique_ptr<timer_probe> probe;
 	std::vector<std::unique_ptr<plugin>> plugins;
 	std::atomic<bool> terminate {false};
 };
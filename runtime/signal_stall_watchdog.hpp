@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "common/record_logger.hpp"
+#include "common/stall_watchdog.hpp"
+#include "common/thread_scheduling.hpp"
+
+namespace ILLIXR {
+
+const record_header __thread_stall_header {"thread_stall", {
+	{"component", typeid(std::string)},
+	{"thread_id", typeid(std::size_t)},
+	{"started", typeid(std::chrono::high_resolution_clock::time_point)},
+	{"stalled_for", typeid(std::chrono::nanoseconds)},
+	{"stack", typeid(std::string)},
+}, record_verbosity::essential};
+
+/**
+ * @brief A stall_watchdog that captures the stuck thread's stack by sending it a signal.
+ *
+ * `ILLIXR_WATCHDOG` turns it on, and is how many times its budget an iteration may take before it
+ * counts as stalled (e.g. `4`); `ILLIXR_WATCHDOG_TIMEOUT_MS` (default 1000) is the limit for those
+ * without a budget, such as switchboard callbacks. Every 10ms, the watchdog thread checks each
+ * heartbeat. For a stall, it sends the thread `SIGRTMIN + 5`, whose handler records the thread's
+ * stack with `backtrace()`; then it logs the stall once as a `thread_stall` record and on stderr.
+ *
+ * Symbols come from `backtrace_symbols`, so functions in the runtime executable only have names if
+ * it is linked with `-rdynamic`; plugins' do.
+ */
+class signal_stall_watchdog : public stall_watchdog {
+public:
+	signal_stall_watchdog(std::shared_ptr<record_logger> logger_, double multiple_, std::chrono::nanoseconds timeout_)
+		: logger{std::move(logger_)}
+		, multiple{multiple_}
+		, timeout{timeout_}
+	{
+		if (multiple <= 0) {
+			return;
+		}
+		// The first backtrace() loads libgcc, which must not happen in the signal handler.
+		void* frame;
+		backtrace(&frame, 1);
+
+		struct sigaction action {};
+		action.sa_handler = on_signal;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+		sigaction(signal_number(), &action, &old_action);
+
+		_m_thread = std::thread{[this] {
+			std::cout << "thread," << std::this_thread::get_id() << ",watchdog," << std::endl;
+			thread_scheduling::apply("watchdog");
+			run();
+		}};
+	}
+
+	static std::shared_ptr<signal_stall_watchdog> from_env(std::shared_ptr<record_logger> logger) {
+		const char* multiple = std::getenv("ILLIXR_WATCHDOG");
+		const char* timeout_ms = std::getenv("ILLIXR_WATCHDOG_TIMEOUT_MS");
+		return std::make_shared<signal_stall_watchdog>(
+			std::move(logger),
+			multiple && *multiple ? std::stod(multiple) : 0.0,
+			std::chrono::milliseconds{timeout_ms && *timeout_ms ? std::stol(timeout_ms) : 1000}
+		);
+	}
+
+	virtual std::shared_ptr<heartbeat> watch(const std::string& name, std::chrono::nanoseconds budget) override {
+		if (multiple <= 0) {
+			return nullptr;
+		}
+		const std::chrono::nanoseconds limit = budget.count() > 0
+			? std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(budget.count() * multiple)}
+			: timeout;
+		auto hb = std::make_shared<heartbeat>(name, limit);
+		const std::lock_guard lock{_m_lock};
+		watched.push_back(entry{hb, 0});
+		return hb;
+	}
+
+	virtual void stop() override {
+		{
+			const std::lock_guard lock{_m_lock};
+			if (terminate) {
+				return;
+			}
+			terminate = true;
+		}
+		_m_cv.notify_all();
+		if (_m_thread.joinable()) {
+			_m_thread.join();
+			sigaction(signal_number(), &old_action, nullptr);
+		}
+	}
+
+	virtual ~signal_stall_watchdog() override {
+		stop();
+	}
+
+private:
+	struct entry {
+		std::weak_ptr<heartbeat> hb;
+		// The start of the last iteration reported, so that each stall is reported once.
+		std::int64_t reported;
+	};
+
+	static int signal_number() {
+		return SIGRTMIN + 5;
+	}
+
+	void run() {
+		std::unique_lock lock{_m_lock};
+		while (!_m_cv.wait_for(lock, check_period, [this] { return terminate; })) {
+			watched.remove_if([](const entry& e) {
+				return e.hb.expired();
+			});
+			// Copied, so that components can start watching while this captures a stack.
+			std::vector<std::pair<std::shared_ptr<heartbeat>, std::int64_t*>> live;
+			for (entry& e : watched) {
+				live.emplace_back(e.hb.lock(), &e.reported);
+			}
+			lock.unlock();
+			const std::int64_t now = tsc_clock::now().time_since_epoch().count();
+			for (const auto& [hb, reported] : live) {
+				const std::int64_t started = hb ? hb->started() : 0;
+				if (started && started != *reported && std::chrono::nanoseconds{now - started} > hb->limit) {
+					if (report(*hb, started)) {
+						*reported = started;
+					}
+				}
+			}
+			lock.lock();
+		}
+	}
+
+	/**
+	 * @brief Captures and logs the stack of @p hb's thread, if it is still in the iteration that
+	 * started at @p started.
+	 */
+	bool report(const heartbeat& hb, std::int64_t started) {
+		const std::size_t thread_id = hb.thread_id();
+		const std::string stack = capture_stack(static_cast<pid_t>(thread_id));
+		if (hb.started() != started) {
+			// It finished after all; the stack is of whatever it does now.
+			return false;
+		}
+		const std::chrono::nanoseconds stalled_for {tsc_clock::now().time_since_epoch().count() - started};
+		std::cerr << "Stall: " << hb.name << " (thread " << thread_id << ") has been in one iteration for "
+				  << std::chrono::duration_cast<std::chrono::milliseconds>(stalled_for).count() << "ms (limit "
+				  << std::chrono::duration_cast<std::chrono::milliseconds>(hb.limit).count() << "ms):\n" << stack << std::flush;
+		logger->log(record{__thread_stall_header, {
+			{hb.name},
+			{thread_id},
+			{tsc_clock::time_point{std::chrono::nanoseconds{started}}},
+			{stalled_for},
+			{stack},
+		}});
+		return true;
+	}
+
+	std::string capture_stack(pid_t thread_id) {
+		captured.store(false);
+		pending.store(true);
+		if (syscall(SYS_tgkill, getpid(), thread_id, signal_number()) != 0) {
+			pending.store(false);
+			return "(no stack: the thread is gone)\n";
+		}
+		for (int waited_ms = 0; !captured.load(std::memory_order_acquire); ++waited_ms) {
+			// If the handler has not taken the request by now, take it back; if it has, it is almost done.
+			if (waited_ms >= 100 && pending.exchange(false)) {
+				return "(no stack: the thread did not handle the signal)\n";
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+
+		std::string stack;
+		// The first two frames are the handler and the kernel's signal trampoline.
+		const int skipped = std::min(depth, 2);
+		char** symbols = backtrace_symbols(frames + skipped, depth - skipped);
+		for (int i = 0; symbols && i < depth - skipped; ++i) {
+			stack += "  " + demangle(symbols[i]) + "\n";
+		}
+		free(symbols);
+		return stack;
+	}
+
+	/**
+	 * @brief Demangles the function in a line from `backtrace_symbols`, `object(function+offset) [address]`.
+	 */
+	static std::string demangle(const std::string& line) {
+		const std::size_t open = line.find('(');
+		const std::size_t plus = line.find('+', open);
+		if (open == std::string::npos || plus == std::string::npos || plus == open + 1) {
+			return line;
+		}
+		int status = -1;
+		char* name = abi::__cxa_demangle(line.substr(open + 1, plus - open - 1).c_str(), nullptr, nullptr, &status);
+		const std::string ret = status == 0 ? line.substr(0, open + 1) + name + line.substr(plus) : line;
+		free(name);
+		return ret;
+	}
+
+	static void on_signal(int) {
+		// Only one capture at a time, and none after the watchdog gave up on this one.
+		if (!pending.exchange(false)) {
+			return;
+		}
+		const int saved_errno = errno;
+		depth = backtrace(frames, max_frames);
+		errno = saved_errno;
+		captured.store(true, std::memory_order_release);
+	}
+
+	static constexpr std::chrono::milliseconds check_period {10};
+	static constexpr int max_frames = 64;
+	static inline std::atomic<bool> pending {false};
+	static inline std::atomic<bool> captured {false};
+	static inline void* frames[max_frames];
+	static inline int depth = 0;
+
+	const std::shared_ptr<record_logger> logger;
+	const double multiple;
+	const std::chrono::nanoseconds timeout;
+	std::mutex _m_lock;
+	std::condition_variable _m_cv;
+	bool terminate = false;
+	// A list, so that run() can update entries without the lock while watch() adds more.
+	std::list<entry> watched;
+	struct sigaction old_action {};
+	std::thread _m_thread;
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ILLIXR {
+
+/**
+ * @brief A map from record_header id to the backend's per-table sink, safe to read from any thread.
+ *
+ * The map is published immutably: readers do one atomic load and search a map that nobody will
+ * modify, so lookups never lock and never race with inserts. Inserting (once per table) copies the
+ * map under a lock and publishes the copy. Superseded copies are kept until the registry dies,
+ * because a reader may still be searching one; there is one per table, so this is cheap.
+ */
+template <typename Sink>
+class sink_registry {
+private:
+	using map = std::unordered_map<std::size_t, Sink*>;
+
+public:
+	sink_registry() {
+		versions.push_back(std::make_unique<const map>());
+		current.store(versions.back().get());
+	}
+
+	sink_registry(const sink_registry&) = delete;
+	sink_registry& operator=(const sink_registry&) = delete;
+
+	/**
+	 * @brief Returns the sink for @p id, constructing it with @p make() if this is the first use.
+	 */
+	template <typename Factory>
+	Sink& get_or_create(std::size_t id, Factory make) {
+		const map& sinks = *current.load(std::memory_order_acquire);
+		auto it = sinks.find(id);
+		if (it != sinks.cend()) {
+			return *it->second;
+		}
+
+		const std::lock_guard lock{_m_insert_lock};
+		// Someone may have inserted it while we waited.
+		const map& latest = *current.load(std::memory_order_acquire);
+		it = latest.find(id);
+		if (it != latest.cend()) {
+			return *it->second;
+		}
+		owned.push_back(make());
+		auto next = std::make_unique<map>(latest);
+		next->emplace(id, owned.back().get());
+		versions.push_back(std::move(next));
+		current.store(versions.back().get(), std::memory_order_release);
+		return *owned.back();
+	}
+
+	/**
+	 * @brief Returns the sink for @p id, or null if it has not been created.
+	 */
+	Sink* find(std::size_t id) const {
+		const map& sinks = *current.load(std::memory_order_acquire);
+		auto it = sinks.find(id);
+		return it == sinks.cend() ? nullptr : it->second;
+	}
+
+	/**
+	 * @brief Calls @p fn on every sink created so far.
+	 */
+	template <typename Fn>
+	void for_each(Fn fn) const {
+		for (const auto& pair : *current.load(std::memory_order_acquire)) {
+			fn(*pair.second);
+		}
+	}
+
+private:
+	std::atomic<const map*> current;
+	// Sinks are destroyed in reverse order of creation.
+	std::vector<std::unique_ptr<Sink>> owned;
+	std::vector<std::unique_ptr<const map>> versions;
+	std::mutex _m_insert_lock;
+};
+
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <memory>
 #include <iostream>
 #include <cassert>
@@ -5,10 +7,16 @@
 #include <chrono>
 #include <atomic>
 #include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <unordered_map>
 #include <experimental/filesystem>
 #include "concurrentqueue/blockingconcurrentqueue.hpp"
 #include "sqlite3pp/sqlite3pp.hpp"
 #include "common/record_logger.hpp"
+#include "common/thread_scheduling.hpp"
+#include "sink_registry.hpp"
 
 /**
  * There are many SQLite3 wrapper libraries.
@@ -18,18 +26,74 @@
 
 namespace ILLIXR {
 
-class sqlite_thread {
-public:
-	sqlite3pp::database prep_db() {
-		if (!std::experimental::filesystem::exists(dir)) {
-			std::experimental::filesystem::create_directory(dir);
-		}
+/**
+ * @brief How each sqlite_thread buffers records between the logging threads and the database.
+ *
+ * Configured once, from the environment:
+ * - `ILLIXR_SQLITE_MAX_QUEUE`: records buffered per table before the overflow policy kicks in.
+ * - `ILLIXR_SQLITE_OVERFLOW`: `drop` (default) discards records and reports the count at shutdown;
+ *   `block` makes the logging thread wait for the writer (backpressure).
+ * - `ILLIXR_SQLITE_BATCH`: records per transaction. Fixed-layout tables (see `record_type`) instead
+ *   commit whole coalescer flushes, up to 64 at a time.
+ * - `ILLIXR_SQLITE_SYNCHRONOUS`: `off`, `normal` (default) or `full`; SQLite's `synchronous` pragma
+ *   for the single WAL database of `sqlite_wal_record_logger`.
+ */
+struct sqlite_queue_policy {
+	enum class overflow_t {
+		drop,
+		block,
+	};
 
-		std::string path = dir / (table_name + std::string{".sqlite"});
-		return sqlite3pp::database{path.c_str()};
+	std::size_t max_queued = 1024 * 1024;
+	overflow_t overflow = overflow_t::drop;
+	std::size_t batch_size = 4096;
+	std::chrono::microseconds max_batch_wait {100 * 1000};
+	std::string synchronous = "NORMAL";
+
+	static sqlite_queue_policy from_env() {
+		sqlite_queue_policy policy;
+		if (const char* max_queued = std::getenv("ILLIXR_SQLITE_MAX_QUEUE")) {
+			policy.max_queued = std::max(std::stoul(max_queued), 1ul);
+		}
+		if (const char* batch_size = std::getenv("ILLIXR_SQLITE_BATCH")) {
+			policy.batch_size = std::max(std::stoul(batch_size), 1ul);
+		}
+		if (const char* overflow = std::getenv("ILLIXR_SQLITE_OVERFLOW")) {
+			if (std::string{overflow} == "block") {
+				policy.overflow = overflow_t::block;
+			} else if (std::string{overflow} == "drop") {
+				policy.overflow = overflow_t::drop;
+			} else {
+				throw std::runtime_error{std::string{"ILLIXR_SQLITE_OVERFLOW should be drop or block, not "} + overflow};
+			}
+		}
+		if (const char* synchronous = std::getenv("ILLIXR_SQLITE_SYNCHRONOUS")) {
+			if (std::string{synchronous} == "off" || std::string{synchronous} == "normal" || std::string{synchronous} == "full") {
+				policy.synchronous = synchronous;
+			} else {
+				throw std::runtime_error{std::string{"ILLIXR_SQLITE_SYNCHRONOUS should be off, normal or full, not "} + synchronous};
+			}
+		}
+		return policy;
 	}
+};
+
+/**
+ * @brief One table of a SQLite database: (re)creates it, and inserts records or packed rows into it.
+ *
+ * The insert statement is prepared once; the caller owns the transaction.
+ */
+class sqlite_table {
+public:
+	sqlite_table(sqlite3pp::database& db_, const record_header& rh_)
+		: rh{rh_}
+		, db{db_}
+		, insert_str{prep_insert_str()}
+		, insert_cmd{db, insert_str.c_str()}
+	{ }
 
 	std::string prep_insert_str() {
+		const std::string& table_name = rh.get_name();
 		std::string drop_table_string = std::string{"DROP TABLE IF EXISTS "} + table_name + std::string{";"};
 		db.execute(drop_table_string.c_str());
 
@@ -67,90 +131,267 @@ public:
 		return insert_string;
 	}
 
-	sqlite_thread(const record_header& rh_)
+	void insert(const record& r) {
+		for (unsigned i = 0; i < rh.get_columns(); ++i) {
+			/*
+			  If you get a `std::bad_any_cast` here, make sure the user didn't lie about record.get_record_header().
+			  The types there should be the same as those in record.get_values().
+			*/
+			if (false) {
+			} else if (rh.get_column_type(i) == typeid(std::size_t)) {
+				insert_cmd.bind(i+1, static_cast<long long>(r.get_value<std::size_t>(i)));
+			} else if (rh.get_column_type(i) == typeid(bool)) {
+				insert_cmd.bind(i+1, static_cast<long long>(r.get_value<bool>(i)));
+			} else if (rh.get_column_type(i) == typeid(double)) {
+				insert_cmd.bind(i+1, r.get_value<double>(i));
+			} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
+				insert_cmd.bind(i+1, static_cast<long long>(r.get_value<std::chrono::nanoseconds>(i).count()));
+			} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
+				auto val = r.get_value<std::chrono::high_resolution_clock::time_point>(i).time_since_epoch();
+				insert_cmd.bind(i+1, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(val).count()));
+			} else if (rh.get_column_type(i) == typeid(std::string)) {
+				// r.get_value<std::string>(i) returns a std::string temporary
+				// c_str() returns a pointer into that std::string temporary
+				// Therefore, need to copy.
+				insert_cmd.bind(i+1, r.get_value<std::string>(i).c_str(), sqlite3pp::copy);
+			} else {
+				throw std::runtime_error{std::string{"type "} + std::string{rh.get_column_type(i).name()} + std::string{" not implemented"}};
+			}
+		}
+		// The statement is prepared once (in the constructor); reset() readies it for the next row.
+		insert_cmd.execute();
+		insert_cmd.reset();
+	}
+
+	/**
+	 * @brief Inserts the packed row @p row (see `record_type`).
+	 */
+	void insert(const std::byte* row) {
+		for (unsigned i = 0; i < rh.get_columns(); ++i) {
+			if (false) {
+			} else if (rh.get_column_type(i) == typeid(std::size_t)) {
+				insert_cmd.bind(i+1, static_cast<long long>(get_row_value<std::size_t>(rh, row, i)));
+			} else if (rh.get_column_type(i) == typeid(bool)) {
+				insert_cmd.bind(i+1, static_cast<long long>(get_row_value<bool>(rh, row, i)));
+			} else if (rh.get_column_type(i) == typeid(double)) {
+				insert_cmd.bind(i+1, get_row_value<double>(rh, row, i));
+			} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
+				insert_cmd.bind(i+1, static_cast<long long>(get_row_value<std::chrono::nanoseconds>(rh, row, i).count()));
+			} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
+				auto val = get_row_value<std::chrono::high_resolution_clock::time_point>(rh, row, i).time_since_epoch();
+				insert_cmd.bind(i+1, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(val).count()));
+			} else {
+				throw std::runtime_error{std::string{"type "} + std::string{rh.get_column_type(i).name()} + std::string{" not implemented"}};
+			}
+		}
+		insert_cmd.execute();
+		insert_cmd.reset();
+	}
+
+private:
+	const record_header& rh;
+	sqlite3pp::database& db;
+	std::string insert_str;
+	sqlite3pp::command insert_cmd;
+};
+
+/**
+ * @brief Counts what is queued for a writer thread, and applies the overflow policy to new records.
+ */
+class sqlite_admission {
+public:
+	explicit sqlite_admission(const sqlite_queue_policy& policy_)
+		: policy{policy_}
+	{ }
+
+	/**
+	 * @brief Applies the queue-capacity policy to @p count incoming records.
+	 *
+	 * Returns how many of them may be enqueued; the rest are counted as dropped.
+	 */
+	std::size_t admit(std::size_t count, const std::atomic<bool>& terminate) {
+		if (policy.overflow == sqlite_queue_policy::overflow_t::block) {
+			// Backpressure: wait for the writer thread to make room.
+			// A batch larger than the whole queue is let through once the queue is empty.
+			while (queued.load() + count > policy.max_queued && queued.load() != 0 && !terminate.load()) {
+				std::this_thread::sleep_for(std::chrono::microseconds{100});
+			}
+			queued += count;
+			return count;
+		} else {
+			std::size_t before = queued.fetch_add(count);
+			std::size_t accepted = before >= policy.max_queued ? 0 : std::min(count, policy.max_queued - before);
+			if (accepted != count) {
+				queued -= count - accepted;
+				dropped += count - accepted;
+			}
+			return accepted;
+		}
+	}
+
+	/**
+	 * @brief Called by the writer thread once it has dequeued @p count records.
+	 */
+	void release(std::size_t count) {
+		queued -= count;
+	}
+
+	std::size_t get_dropped() const {
+		return dropped.load();
+	}
+
+private:
+	const sqlite_queue_policy& policy;
+	std::atomic<std::size_t> queued {0};
+	std::atomic<std::size_t> dropped {0};
+};
+
+class sqlite_thread {
+public:
+	sqlite3pp::database prep_db() {
+		if (!std::experimental::filesystem::exists(dir)) {
+			std::experimental::filesystem::create_directory(dir);
+		}
+
+		std::string path = dir / (table_name + std::string{".sqlite"});
+		return sqlite3pp::database{path.c_str()};
+	}
+
+	sqlite_thread(const record_header& rh_, const sqlite_queue_policy& policy_)
 		: rh{rh_}
 		, table_name{rh.get_name()}
+		, policy{policy_}
 		, db{prep_db()}
-		, insert_str{prep_insert_str()}
-		, insert_cmd{db, insert_str.c_str()}
+		, table{db, rh}
 		, thread{std::bind(&sqlite_thread::pull_queue, this)}
 	{ }
 
 	void pull_queue() {
-		const std::size_t max_record_batch_size = 1024 * 256;
-		std::vector<record> record_batch {max_record_batch_size};
-		std::size_t actual_batch_size;
-
 		std::cout << "thread," << std::this_thread::get_id() << ",sqlite thread," << table_name << std::endl;
+		thread_scheduling::apply("sqlite/" + table_name);
 
 		std::size_t processed = 0;
+		std::size_t post_processed = 0;
+		if (rh.has_fixed_layout()) {
+			pull_row_queue(processed, post_processed);
+		} else {
+			pull_record_queue(processed, post_processed);
+		}
+
+		std::cerr << "Drained " << table_name << " (sqlite); " << post_processed << " / " << (processed + post_processed) << " done post real time"
+				  << "; " << std::chrono::duration_cast<std::chrono::milliseconds>(thread_cpu_time()).count() << "ms CPU";
+		if (admission.get_dropped()) {
+			std::cerr << "; " << admission.get_dropped() << " dropped because the queue was full";
+		}
+		std::cerr << std::endl;
+	}
+
+	void pull_record_queue(std::size_t& processed, std::size_t& post_processed) {
+		// Bounded, so that each transaction (and the time the queue waits on it) stays short.
+		std::vector<record> record_batch {policy.batch_size};
+		std::size_t actual_batch_size;
+
 		while (!terminate.load()) {
-			std::this_thread::sleep_for(std::chrono::seconds{1});
-			// Uncomment this block to log in "real time";
-			// Otherwise, everything gets loged "post real time".
-			/*
-			const std::chrono::seconds max_record_match_wait_time {10};
-			actual_batch_size = queue.wait_dequeue_bulk_timed(record_batch.begin(), record_batch.size(), max_record_match_wait_time);
-			process(record_batch, actual_batch_size);
-			processed += actual_batch_size;
-			*/
+			actual_batch_size = queue.wait_dequeue_bulk_timed(record_batch.begin(), record_batch.size(), policy.max_batch_wait);
+			if (actual_batch_size) {
+				admission.release(actual_batch_size);
+				process(record_batch, actual_batch_size);
+				processed += actual_batch_size;
+			}
 		}
 
 		// We got the terminate commnad,
 		// So drain whatever is left in the queue.
 		// But don't wait around once it is empty.
-		std::size_t post_processed = 0;
 		while ((actual_batch_size = queue.try_dequeue_bulk(record_batch.begin(), record_batch.size()))) {
+			admission.release(actual_batch_size);
 			process(record_batch, actual_batch_size);
 			post_processed += actual_batch_size;
 		}
-		std::cerr << "Drained " << table_name << " (sqlite); " << post_processed << " / " << (processed + post_processed) << " done post real time" << std::endl;
+	}
+
+	void pull_row_queue(std::size_t& processed, std::size_t& post_processed) {
+		// Each chunk is one coalescer flush, so a handful of them already makes a large transaction.
+		std::vector<std::vector<std::byte>> chunk_batch {row_chunk_batch_size};
+		std::size_t actual_batch_size;
+
+		while (!terminate.load()) {
+			actual_batch_size = row_queue.wait_dequeue_bulk_timed(chunk_batch.begin(), chunk_batch.size(), policy.max_batch_wait);
+			if (actual_batch_size) {
+				processed += process(chunk_batch, actual_batch_size);
+			}
+		}
+
+		while ((actual_batch_size = row_queue.try_dequeue_bulk(chunk_batch.begin(), chunk_batch.size()))) {
+			post_processed += process(chunk_batch, actual_batch_size);
+		}
 	}
 
 	void process(const std::vector<record>& record_batch, std::size_t batch_size) {
 		sqlite3pp::transaction xct{db};
 		for (std::size_t i = 0; i < batch_size; ++i) {
-			// TODO(performance): reuse the sqlite3pp statement
-			// This currently has to be 'reinterpreted' for every iteration.
-			sqlite3pp::command cmd{db, insert_str.c_str()};
-			const record& r = record_batch[i];
-			for (unsigned i = 0; i < rh.get_columns(); ++i) {
-				/*
-				  If you get a `std::bad_any_cast` here, make sure the user didn't lie about record.get_record_header().
-				  The types there should be the same as those in record.get_values().
-				*/
-				if (false) {
-				} else if (rh.get_column_type(i) == typeid(std::size_t)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<std::size_t>(i)));
-				} else if (rh.get_column_type(i) == typeid(bool)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<bool>(i)));
-				} else if (rh.get_column_type(i) == typeid(double)) {
-					cmd.bind(i+1, r.get_value<double>(i));
-				} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<std::chrono::nanoseconds>(i).count()));
-				} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
-					auto val = r.get_value<std::chrono::high_resolution_clock::time_point>(i).time_since_epoch();
-					cmd.bind(i+1, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(val).count()));
-				} else if (rh.get_column_type(i) == typeid(std::string)) {
-					// r.get_value<std::string>(i) returns a std::string temporary
-					// c_str() returns a pointer into that std::string temporary
-					// Therefore, need to copy.
-					cmd.bind(i+1, r.get_value<std::string>(i).c_str(), sqlite3pp::copy);
-				} else {
-					throw std::runtime_error{std::string{"type "} + std::string{rh.get_column_type(i).name()} + std::string{" not implemented"}};
-				}
+			table.insert(record_batch[i]);
+		}
+		xct.commit();
+	}
+
+	/**
+	 * @brief Inserts every row of the first @p batch_size chunks; returns the number of rows.
+	 */
+	std::size_t process(const std::vector<std::vector<std::byte>>& chunk_batch, std::size_t batch_size) {
+		std::size_t rows = 0;
+		sqlite3pp::transaction xct{db};
+		for (std::size_t chunk = 0; chunk < batch_size; ++chunk) {
+			const std::vector<std::byte>& bytes = chunk_batch[chunk];
+			for (std::size_t offset = 0; offset < bytes.size(); offset += rh.get_row_size()) {
+				table.insert(bytes.data() + offset);
+				++rows;
 			}
-			cmd.execute();
 		}
 		xct.commit();
+		admission.release(rows);
+		return rows;
 	}
 
 	void put_queue(const std::vector<record>& buffer_in) {
-		queue.enqueue_bulk(buffer_in.begin(), buffer_in.size());
+		if (rh.has_fixed_layout()) {
+			for (const record& r : buffer_in) {
+				put_queue(r);
+			}
+			return;
+		}
+		std::size_t accepted = admission.admit(buffer_in.size(), terminate);
+		queue.enqueue_bulk(buffer_in.begin(), accepted);
+		for (std::size_t i = accepted; i < buffer_in.size(); ++i) {
+			buffer_in[i].mark_used();
+		}
 	}
 
 	void put_queue(const record& record_in) {
-		queue.enqueue(record_in);
+		if (rh.has_fixed_layout()) {
+			// A dynamic record for a fixed-layout table; pack it so the writer only deals in rows.
+			if (admission.admit(1, terminate)) {
+				std::vector<std::byte> chunk (rh.get_row_size());
+				record_logger::pack_row(record_in, chunk.data());
+				row_queue.enqueue(std::move(chunk));
+			}
+			record_in.mark_used();
+		} else if (admission.admit(1, terminate)) {
+			queue.enqueue(record_in);
+		} else {
+			record_in.mark_used();
+		}
+	}
+
+	/**
+	 * @brief Enqueues @p count packed rows as one chunk (one allocation for the whole flush).
+	 */
+	void put_queue(const std::byte* rows, std::size_t count) {
+		assert(rh.has_fixed_layout());
+		std::size_t accepted = admission.admit(count, terminate);
+		if (accepted) {
+			row_queue.enqueue(std::vector<std::byte>(rows, rows + accepted * rh.get_row_size()));
+		}
 	}
 
 	~sqlite_thread() {
@@ -158,14 +399,19 @@ public:
 		thread.join();
 	}
 
-private:
 	static const std::experimental::filesystem::path dir;
+
+private:
 	const record_header& rh;
 	std::string table_name;
+	const sqlite_queue_policy policy;
 	sqlite3pp::database db;
-	std::string insert_str;
-	sqlite3pp::command insert_cmd;
+	sqlite_table table;
 	moodycamel::BlockingConcurrentQueue<record> queue;
+	// Used instead of `queue` when `rh.has_fixed_layout()`. Each element is a run of packed rows.
+	moodycamel::BlockingConcurrentQueue<std::vector<std::byte>> row_queue;
+	static constexpr std::size_t row_chunk_batch_size = 64;
+	sqlite_admission admission {policy};
 	std::atomic<bool> terminate {false};
 	std::thread thread;
 };
@@ -175,15 +421,13 @@ const std::experimental::filesystem::path sqlite_thread::dir {"metrics"};
 class sqlite_record_logger : public record_logger {
 private:
 	sqlite_thread& get_sqlite_thread(const record& r) {
-		const record_header& rh = r.get_record_header();
-		auto result = registered_tables.find(rh.get_id());
-		if (result != registered_tables.cend()) {
-			return result->second;
-		} else {
-			const std::lock_guard lock{_m_registry_lock};
-			auto pair = registered_tables.try_emplace(rh.get_id(), rh);
-			return pair.first->second;
-		}
+		return get_sqlite_thread(r.get_record_header());
+	}
+
+	sqlite_thread& get_sqlite_thread(const record_header& rh) {
+		return registered_tables.get_or_create(rh.get_id(), [&] {
+			return std::make_unique<sqlite_thread>(rh, policy);
+		});
 	}
 
 protected:
@@ -197,9 +441,204 @@ protected:
 		get_sqlite_thread(r).put_queue(r);
 	}
 
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		if (count) {
+			get_sqlite_thread(rh).put_queue(rows, count);
+		}
+	}
+
+private:
+	const sqlite_queue_policy policy {sqlite_queue_policy::from_env()};
+	sink_registry<sqlite_thread> registered_tables;
+};
+
+/**
+ * @brief Writes every table to one SQLite database, `metrics/illixr.sqlite`, from one thread.
+ *
+ * Where `sqlite_record_logger` has a database, a writer thread and a commit per table, this has one
+ * of each for the whole run: the database is in WAL mode, with `synchronous` from
+ * `ILLIXR_SQLITE_SYNCHRONOUS` (default `normal`, which does not fsync on commit), and each
+ * transaction takes whatever arrived for any table in the last 100ms (or `ILLIXR_SQLITE_BATCH`
+ * records, if that comes first). The queue limit and overflow policy are as in `sqlite_queue_policy`,
+ * but shared by all tables. Since the tables share a file, they can be joined directly, and the
+ * database can be read while the run is writing it.
+ */
+class sqlite_wal_record_logger : public record_logger {
+private:
+	/**
+	 * @brief What one log call enqueued: packed rows if the table has a fixed layout, else records.
+	 */
+	struct chunk {
+		const record_header* rh = nullptr;
+		std::vector<std::byte> rows;
+		std::vector<record> records;
+
+		std::size_t size() const {
+			return rh->has_fixed_layout() ? rows.size() / rh->get_row_size() : records.size();
+		}
+	};
+
+public:
+	sqlite_wal_record_logger()
+		: db{prep_db()}
+		, thread{std::bind(&sqlite_wal_record_logger::pull_queue, this)}
+	{ }
+
+	virtual ~sqlite_wal_record_logger() override {
+		terminate.store(true);
+		thread.join();
+	}
+
+	static const std::string file_name;
+
+protected:
+	virtual void log(const std::vector<record>& rs) override {
+		if (!rs.empty()) {
+			if (rs[0].get_record_header().has_fixed_layout()) {
+				for (const record& r : rs) {
+					log(r);
+				}
+				return;
+			}
+			const std::size_t accepted = admission.admit(rs.size(), terminate);
+			if (accepted) {
+				queue.enqueue(chunk{&rs[0].get_record_header(), {}, {rs.begin(), rs.begin() + accepted}});
+			}
+			for (const record& r : rs) {
+				r.mark_used();
+			}
+		}
+	}
+
+	virtual void log(const record& r) override {
+		if (admission.admit(1, terminate)) {
+			const record_header& rh = r.get_record_header();
+			if (rh.has_fixed_layout()) {
+				// Packed, so that the writer only deals in rows for this table.
+				std::vector<std::byte> row (rh.get_row_size());
+				pack_row(r, row.data());
+				queue.enqueue(chunk{&rh, std::move(row), {}});
+			} else {
+				queue.enqueue(chunk{&rh, {}, {r}});
+			}
+		}
+		r.mark_used();
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		const std::size_t accepted = count ? admission.admit(count, terminate) : 0;
+		if (accepted) {
+			queue.enqueue(chunk{&rh, std::vector<std::byte>(rows, rows + accepted * rh.get_row_size()), {}});
+		}
+	}
+
 private:
-	std::unordered_map<std::size_t, sqlite_thread> registered_tables;
-	std::mutex _m_registry_lock;
+	sqlite3pp::database prep_db() {
+		namespace fs = std::experimental::filesystem;
+		fs::create_directories(sqlite_thread::dir);
+		const fs::path path = sqlite_thread::dir / file_name;
+		// Tables from an earlier run would otherwise survive next to this run's.
+		for (const char* suffix : {"", "-wal", "-shm"}) {
+			fs::remove(path.string() + suffix);
+		}
+		sqlite3pp::database ret {path.c_str()};
+		ret.execute("PRAGMA journal_mode=WAL;");
+		ret.execute(("PRAGMA synchronous=" + policy.synchronous + ";").c_str());
+		return ret;
+	}
+
+	void pull_queue() {
+		std::cout << "thread," << std::this_thread::get_id() << ",sqlite thread," << file_name << std::endl;
+		thread_scheduling::apply("sqlite");
+
+		std::size_t processed = 0;
+		std::size_t post_processed = 0;
+		std::size_t transactions = 0;
+		while (!terminate.load()) {
+			if (std::size_t rows = process(policy.max_batch_wait)) {
+				processed += rows;
+				++transactions;
+			}
+		}
+		// Drain whatever is left, but don't wait around once it is empty.
+		while (std::size_t rows = process(std::chrono::microseconds{0})) {
+			post_processed += rows;
+			++transactions;
+		}
+
+		std::cerr << "Drained " << file_name << " (sqlite_wal); " << post_processed << " / " << (processed + post_processed) << " done post real time"
+				  << "; " << transactions << " transactions"
+				  << "; " << std::chrono::duration_cast<std::chrono::milliseconds>(thread_cpu_time()).count() << "ms CPU";
+		if (admission.get_dropped()) {
+			std::cerr << "; " << admission.get_dropped() << " dropped because the queue was full";
+		}
+		std::cerr << std::endl;
+	}
+
+	/**
+	 * @brief Writes what arrives within @p window (or the first `batch_size` rows) in one transaction.
+	 *
+	 * Returns the number of rows written. With a zero window, writes only what is already queued.
+	 */
+	std::size_t process(std::chrono::microseconds window) {
+		const auto deadline = std::chrono::steady_clock::now() + window;
+		std::optional<sqlite3pp::transaction> xct;
+		std::size_t rows = 0;
+		while (rows < policy.batch_size) {
+			const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+			const std::size_t count = left.count() > 0
+				? queue.wait_dequeue_bulk_timed(chunk_batch.begin(), chunk_batch.size(), left)
+				: queue.try_dequeue_bulk(chunk_batch.begin(), chunk_batch.size());
+			if (!count) {
+				break;
+			}
+			if (!xct) {
+				xct.emplace(db);
+			}
+			for (std::size_t i = 0; i < count; ++i) {
+				rows += insert(chunk_batch[i]);
+				chunk_batch[i] = chunk{};
+			}
+		}
+		if (xct) {
+			xct->commit();
+			admission.release(rows);
+		}
+		return rows;
+	}
+
+	std::size_t insert(const chunk& c) {
+		auto it = tables.find(c.rh->get_id());
+		if (it == tables.end()) {
+			// Only this thread touches `tables`, and the DDL becomes part of the current transaction.
+			it = tables.emplace(c.rh->get_id(), std::make_unique<sqlite_table>(db, *c.rh)).first;
+		}
+		sqlite_table& table = *it->second;
+		if (c.rh->has_fixed_layout()) {
+			for (std::size_t offset = 0; offset < c.rows.size(); offset += c.rh->get_row_size()) {
+				table.insert(c.rows.data() + offset);
+			}
+		} else {
+			for (const record& r : c.records) {
+				table.insert(r);
+				r.mark_used();
+			}
+		}
+		return c.size();
+	}
+
+	const sqlite_queue_policy policy {sqlite_queue_policy::from_env()};
+	sqlite_admission admission {policy};
+	sqlite3pp::database db;
+	// Only used by the writer thread.
+	std::unordered_map<std::size_t, std::unique_ptr<sqlite_table>> tables;
+	std::vector<chunk> chunk_batch = std::vector<chunk>(chunk_batch_size);
+	static constexpr std::size_t chunk_batch_size = 64;
+	moodycamel::BlockingConcurrentQueue<chunk> queue;
+	std::atomic<bool> terminate {false};
+	std::thread thread;
 };
 
+const std::string sqlite_wal_record_logger::file_name {"illixr.sqlite"};
+
 }
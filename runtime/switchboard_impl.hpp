@@ -1,9 +1,17 @@
 #include "common/switchboard.hpp"
+#include "common/executor.hpp"
+#include "common/stall_watchdog.hpp"
 #include "common/data_format.hpp"
+#include "common/record_logger.hpp"
+#include "common/metrics.hpp"
+#include "common/perf_counters.hpp"
+#include "common/thread_scheduling.hpp"
+#include <algorithm>
 #include <atomic>
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <deque>
 #include <mutex>
 
 #include "concurrentqueue/blockingconcurrentqueue.hpp"
@@ -14,37 +22,98 @@ using queue = moodycamel::BlockingConcurrentQueue<T>;
 Proof of thread-safety:
 - Since all instance members are private, proving each method is datarace-free implies the class is.
     - I prove this by showing every access is guarded by a lock, implemented atomically, or uses concurrent primitives (AKA the concurrentqueue.hpp implementatoin).
-- All code in this module acquires _m_registry_lock before _m_callbacks_lock, and does not call any external code which could acquire a lock, therefore this is deadlock-free.
+- All code in this module acquires _m_registry_lock before _m_callbacks_lock or _m_watchers_lock, and does not call any external code which could acquire a lock, therefore this is deadlock-free.
 - (Bonus) none of the locks are contended in steady-state.
 
 Caveat:
 - See caveat on invoke_callbacks()
 - See caveat on put()
+
+On the executor:
+If ILLIXR_EXECUTOR names switchboard, there is no switchboard thread. Each topic has its own queue
+instead, and a task on the executor runs its callbacks. At most one such task per topic is queued or
+running at a time, so each topic's events are still handled in order. However, callbacks on different
+topics may now run at the same time.
 */
 
 namespace ILLIXR {
-	const record_header __switchboard_callback_header {"switchboard_callback", {
-		{"plugin_id", typeid(std::size_t)},
-		{"iteration_no", typeid(std::size_t)},
-		{"cpu_time_start", typeid(std::chrono::nanoseconds)},
-		{"cpu_time_stop" , typeid(std::chrono::nanoseconds)},
-		{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
-		{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
-	}};
+	using __switchboard_callback_record = record_type<
+		std::size_t,
+		std::size_t,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::high_resolution_clock::time_point,
+		std::size_t,
+		std::size_t,
+		std::size_t,
+		std::chrono::high_resolution_clock::time_point,
+		std::size_t,
+		std::size_t,
+		std::size_t,
+		std::size_t,
+		std::size_t
+	>;
+
+	/*
+	  topic_id, put_thread_id and put_wall_time identify the edge along which the event travelled
+	  (which thread published it to which topic, and when), so that tools can draw it. The counts
+	  after them are from perf_counters, over the callback; 0 unless ILLIXR_PERF_COUNTERS is set.
+	*/
+	const __switchboard_callback_record __switchboard_callback_header {"switchboard_callback", {
+		"plugin_id",
+		"iteration_no",
+		"cpu_time_start",
+		"cpu_time_stop",
+		"wall_time_start",
+		"wall_time_stop",
+		"thread_id",
+		"topic_id",
+		"put_thread_id",
+		"put_wall_time",
+		"cycles",
+		"instructions",
+		"llc_misses",
+		"branch_misses",
+		"context_switches",
+	}, record_verbosity::detailed};
+
+	const record_header __switchboard_topic_header {"switchboard_topic", {
+		{"topic_id", typeid(std::size_t)},
+		{"topic_name", typeid(std::string)},
+	}, record_verbosity::essential};
 
 	const record_header __switchboard_topic_stop_header {"switchboard_topic_stop", {
 		{"topic_name", typeid(std::string)},
 		{"processed", typeid(std::size_t)},
 		{"unprocessed", typeid(std::size_t)},
-	}};
-
-	const record_header __switchboard_check_queues_header {"switchboard_check_queues", {
-		{"iteration_no", typeid(std::size_t)},
-		{"cpu_time_start", typeid(std::chrono::nanoseconds)},
-		{"cpu_time_stop" , typeid(std::chrono::nanoseconds)},
-		{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
-		{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
-	}};
+	}, record_verbosity::essential};
+
+	const record_type<
+		std::size_t,
+		std::chrono::nanoseconds,
+		std::chrono::nanoseconds,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::high_resolution_clock::time_point,
+		std::size_t
+	> __switchboard_check_queues_header {"switchboard_check_queues", {
+		"iteration_no",
+		"cpu_time_start",
+		"cpu_time_stop",
+		"wall_time_start",
+		"wall_time_stop",
+		"thread_id",
+	}, record_verbosity::detailed};
+
+	/**
+	 * @brief An event in flight from `put` to `check_queues`.
+	 */
+	struct queued_event {
+		std::string topic_name;
+		const void* event;
+		std::chrono::high_resolution_clock::time_point put_wall_time;
+		std::size_t put_thread_id;
+	};
 
 	class topic {
 	public:
@@ -114,9 +183,26 @@ namespace ILLIXR {
 				// delete old;
 				/* TODO: (feature:allocate) Free old.*/
 				/* TODO: (optimization:free-list) return to free-list. */
-				[[maybe_unused]] int ret = _m_topic->_m_queue.enqueue(std::make_pair(_m_topic->_m_name, contents));
-				// Unused if the assert is not on.
-				assert(ret);
+				queued_event event {
+					_m_topic->_m_name,
+					contents,
+					tsc_clock::now(),
+					kernel_thread_id(),
+				};
+				if (_m_topic->_m_executor) {
+					_m_topic->post(std::move(event));
+				} else {
+					[[maybe_unused]] int ret = _m_topic->_m_queue.enqueue(std::move(event));
+					// Unused if the assert is not on.
+					assert(ret);
+				}
+
+				if (_m_topic->_m_watcher_count.load()) {
+					const std::lock_guard<std::mutex> lock{_m_topic->_m_watchers_lock};
+					for (wakeup* w : _m_topic->_m_watchers) {
+						w->notify();
+					}
+				}
 			}
 
 			topic_writer(topic* topic) : _m_topic{topic} {
@@ -156,25 +242,92 @@ namespace ILLIXR {
 			_m_callbacks.push_back({component_id, callback});
 		}
 
+		void watch(wakeup* w) {
+			const std::lock_guard<std::mutex> lock{_m_watchers_lock};
+			_m_watchers.push_back(w);
+			_m_watcher_count.store(_m_watchers.size());
+		}
+
+		void unwatch(wakeup* w) {
+			/* Proof of thread-safety: put() only notifies watchers while holding _m_watchers_lock, so
+			   once this returns, no put() is still using w. */
+			const std::lock_guard<std::mutex> lock{_m_watchers_lock};
+			_m_watchers.erase(std::remove(_m_watchers.begin(), _m_watchers.end(), w), _m_watchers.end());
+			_m_watcher_count.store(_m_watchers.size());
+		}
+
 		std::size_t ty() {
 			/* Proof of thread-safety: ty is immutable*/
 			return _m_ty;
 		}
 
-		topic(std::shared_ptr<record_logger> record_logger_, std::size_t ty, const std::string name, queue<std::pair<std::string, const void*>>& queue)
+		topic(std::shared_ptr<record_logger> record_logger_, metrics_registry& metrics, std::size_t ty, const std::string name, queue<queued_event>& queue,
+			  executor* executor_, stall_watchdog* watchdog, const std::atomic<bool>& terminate)
 			: _m_record_logger{record_logger_}
-			, _m_cb_log {_m_record_logger}
+			, _m_cb_log {_m_record_logger, __switchboard_callback_header}
+			, _m_raw_rows{metrics.raw_rows()}
+			, _m_counting{_m_raw_rows && perf_counters::enabled()}
+			, _m_cb_wall_time{metrics.get_histogram("switchboard/" + name + "/callback_wall_time")}
+			, _m_dispatch_latency{metrics.get_histogram("switchboard/" + name + "/dispatch_latency")}
+			, _m_overhead{_m_record_logger, "switchboard/" + name}
+			, _m_heartbeat{watchdog ? watchdog->watch("switchboard/" + name, std::chrono::nanoseconds{0}) : nullptr}
 			, _m_ty{ty}
 			, _m_name{name}
+			, _m_id{std::hash<std::string>{}(name)}
 			, _m_queue{queue}
+			, _m_executor{executor_}
+			, _m_terminate{terminate}
 		{
 			/* No need for thread-safety, constructor is only called from one thread. */
+			if (__switchboard_topic_header.should_log()) {
+				_m_record_logger->log(record{__switchboard_topic_header, {
+					{_m_id},
+					{_m_name},
+				}});
+			}
 		}
 
 		void mark_unprocessed(const void*) {
 			_m_unprocessed++;
 		}
 
+		/**
+		 * @brief Queues @p event for this topic's task on the executor, and queues the task if it is not already.
+		 */
+		void post(queued_event&& event) {
+			/* Proof of thread-safety: _m_strand and _m_strand_scheduled are only accessed under
+			   _m_strand_lock, which is never held while calling out. */
+			bool schedule = false;
+			{
+				const std::lock_guard<std::mutex> lock{_m_strand_lock};
+				_m_strand.push_back(std::move(event));
+				schedule = !_m_strand_scheduled;
+				_m_strand_scheduled = true;
+			}
+			if (schedule) {
+				_m_executor->submit([this] {
+					drain();
+				});
+			}
+		}
+
+		/**
+		 * @brief Waits until this topic's task is neither queued nor running.
+		 *
+		 * Once the switchboard is stopping, later tasks only count their events as unprocessed.
+		 */
+		void wait_for_drain() {
+			while (true) {
+				{
+					const std::lock_guard<std::mutex> lock{_m_strand_lock};
+					if (!_m_strand_scheduled) {
+						return;
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds{1});
+			}
+		}
+
 		~topic() {
 			/*
 			 * No need for thread-safety:
@@ -184,16 +337,19 @@ namespace ILLIXR {
 			if (latest) {
 				/* TODO: (feature:allocate) Free old.*/
 			}
+			_m_unprocessed += _m_strand.size();
 			/* TODO: (optimization:free-list) free the elements of free-list. */
 
-			_m_record_logger->log(record{__switchboard_topic_stop_header, {
-				{_m_name},
-				{_m_iteration_no},
-				{_m_unprocessed},
-			}});
+			if (__switchboard_topic_stop_header.should_log()) {
+				_m_record_logger->log(record{__switchboard_topic_stop_header, {
+					{_m_name},
+					{_m_iteration_no},
+					{_m_unprocessed},
+				}});
+			}
 		}
 
-		void invoke_callbacks(const void* event) {
+		void invoke_callbacks(const queued_event& event) {
 			/*
 			 * Proof of thread-safety:
 			 * - All reads _m_callbacks occur after acquiring its lock.
@@ -207,33 +363,119 @@ namespace ILLIXR {
 			 */
 			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
 			for (const auto& pair : _m_callbacks) {
-				auto cb_start_cpu_time  = thread_cpu_time();
-				auto cb_start_wall_time = std::chrono::high_resolution_clock::now();
-				pair.second(event);
-				_m_cb_log.log(record{__switchboard_callback_header, {
-					{pair.first},
-					{_m_iteration_no},
-					{cb_start_cpu_time},
-					{thread_cpu_time()},
-					{cb_start_wall_time},
-					{std::chrono::high_resolution_clock::now()},
-				}});
+				// CPU time is a system call to read, and only goes in the raw rows, so it is only read
+				// for the rows that sampling keeps.
+				std::chrono::nanoseconds cb_start_cpu_time {0};
+				perf_counters::values cb_start_counters {};
+				tsc_clock::time_point cb_start_wall_time;
+				bool log_row = false;
+				{
+					const instrumentation_meter::scope measure {_m_overhead};
+					log_row = _m_raw_rows && _m_cb_log.wants_row();
+					if (log_row) {
+						cb_start_cpu_time = thread_cpu_time();
+					}
+					if (log_row && _m_counting) {
+						cb_start_counters = perf_counters::this_thread().read();
+					}
+					cb_start_wall_time = tsc_clock::now();
+				}
+				if (_m_heartbeat) {
+					_m_heartbeat->start();
+				}
+				pair.second(event.event);
+				if (_m_heartbeat) {
+					_m_heartbeat->stop();
+				}
+				const instrumentation_meter::scope measure {_m_overhead};
+				const tsc_clock::time_point cb_stop_wall_time = tsc_clock::now();
+				_m_dispatch_latency.record(cb_start_wall_time - event.put_wall_time);
+				_m_cb_wall_time.record(cb_stop_wall_time - cb_start_wall_time);
+				if (log_row) {
+					const perf_counters::values counts = _m_counting
+						? perf_counters::difference(cb_start_counters, perf_counters::this_thread().read())
+						: perf_counters::values{};
+					_m_cb_log.log(
+						pair.first,
+						_m_iteration_no,
+						cb_start_cpu_time,
+						thread_cpu_time(),
+						cb_start_wall_time,
+						cb_stop_wall_time,
+						kernel_thread_id(),
+						_m_id,
+						event.put_thread_id,
+						event.put_wall_time,
+						counts[perf_counters::cycles],
+						counts[perf_counters::instructions],
+						counts[perf_counters::llc_misses],
+						counts[perf_counters::branch_misses],
+						counts[perf_counters::context_switches]
+					);
+				}
 			}
 			_m_iteration_no++;
 		}
 
 	private:
+		/**
+		 * @brief The topic's task on the executor: runs the callbacks of the queued events, in order.
+		 */
+		void drain() {
+			// A batch at a time, so that a busy topic takes turns with the other tasks.
+			static constexpr std::size_t max_batch = 16;
+			for (std::size_t i = 0; i < max_batch; ++i) {
+				queued_event event;
+				{
+					const std::lock_guard<std::mutex> lock{_m_strand_lock};
+					if (_m_strand.empty()) {
+						_m_strand_scheduled = false;
+						return;
+					}
+					event = std::move(_m_strand.front());
+					_m_strand.pop_front();
+				}
+				if (_m_terminate.load()) {
+					mark_unprocessed(event.event);
+				} else {
+					invoke_callbacks(event);
+				}
+			}
+			_m_executor->defer([this] {
+				drain();
+			});
+		}
 
 		const std::shared_ptr<record_logger> _m_record_logger;
-		record_coalescer _m_cb_log;
+		__switchboard_callback_record::coalescer _m_cb_log;
+		const bool _m_raw_rows;
+		const bool _m_counting;
+		histogram& _m_cb_wall_time;
+		histogram& _m_dispatch_latency;
+		// Only used by the switchboard thread.
+		instrumentation_meter _m_overhead;
+		// Set if the stall watchdog is on; beats around each callback.
+		const std::shared_ptr<stall_watchdog::heartbeat> _m_heartbeat;
 		const std::size_t _m_ty;
 		std::atomic<const void*> _m_latest {nullptr};
 		std::vector<std::pair<std::size_t, std::function<void(const void*)>>> _m_callbacks;
 		std::mutex _m_callbacks_lock;
+		/* Separate from _m_callbacks_lock, which is held while callbacks run. put() only takes this
+		   lock when there are watchers, and it is uncontended in steady-state. */
+		std::vector<wakeup*> _m_watchers;
+		std::atomic<std::size_t> _m_watcher_count {0};
+		std::mutex _m_watchers_lock;
 		const std::string _m_name;
+		const std::size_t _m_id;
 		std::size_t _m_iteration_no = 0;
 		std::size_t _m_unprocessed = 0;
-		queue<std::pair<std::string, const void*>>& _m_queue;
+		queue<queued_event>& _m_queue;
+		// Only used on the executor, instead of _m_queue.
+		executor* const _m_executor;
+		const std::atomic<bool>& _m_terminate;
+		std::deque<queued_event> _m_strand;
+		bool _m_strand_scheduled = false;
+		std::mutex _m_strand_lock;
 		/* - const because nobody should write to the _m_latest in
 		   place. This is not thread-safe.
 		   - atomic because it will be accessed from different threads. */
@@ -252,10 +494,17 @@ namespace ILLIXR {
 
 		switchboard_impl(phonebook const* pb)
 			: _m_record_logger{pb->lookup_impl<record_logger>()}
+			, _m_metrics{pb->lookup_impl<metrics_registry>()}
+			, _m_executor{pb->has_impl<executor>() && pb->lookup_impl<executor>()->runs("switchboard") ? pb->lookup_impl<executor>() : nullptr}
+			, _m_watchdog{pb->has_impl<stall_watchdog>() ? pb->lookup_impl<stall_watchdog>() : nullptr}
 		{
+			if (_m_executor) {
+				return;
+			}
 			for (size_t i = 0; i < MAX_THREADS; ++i) {
 				_m_threads.push_back(std::thread{[i, this]() {
 					std::cout << "thread," << std::this_thread::get_id() << ",switchboard worker," << i << std::endl;
+					thread_scheduling::apply("switchboard");
 					this->check_queues();
 				}});
 			}
@@ -267,6 +516,13 @@ namespace ILLIXR {
 				for (std::thread& thread : _m_threads) {
 					thread.join();
 				}
+				if (_m_executor) {
+					const std::lock_guard lock{_m_registry_lock};
+					for (auto& pair : _m_registry) {
+						pair.second.wait_for_drain();
+					}
+					std::cerr << "Drained switchboard (on the executor)" << std::endl;
+				}
 			}
 		}
 
@@ -276,6 +532,9 @@ namespace ILLIXR {
 
 	private:
 		const std::shared_ptr<record_logger> _m_record_logger;
+		const std::shared_ptr<metrics_registry> _m_metrics;
+		const std::shared_ptr<executor> _m_executor;
+		const std::shared_ptr<stall_watchdog> _m_watchdog;
 
 		void check_queues() {
 			/*
@@ -290,38 +549,55 @@ namespace ILLIXR {
 			// TODO(performance): use timed deque
 			std::size_t iteration_no = 0;
 
-			record_coalescer check_queues {_m_record_logger};
-			std::pair<std::string, const void*> t;
-
-			auto check_queues_start_cpu_time  = thread_cpu_time();
-			auto check_queues_start_wall_time = std::chrono::high_resolution_clock::now();
+			typed_record_coalescer check_queues {_m_record_logger, __switchboard_check_queues_header};
+			const bool raw_rows = _m_metrics->raw_rows();
+			gauge& queue_depth = _m_metrics->get_gauge("switchboard/queue_depth");
+			queued_event t;
+
+			// CPU time is a system call to read, and only goes in the raw rows, so it is only read for
+			// the rows that sampling keeps (decided before each one starts).
+			bool log_row = false;
+			std::chrono::nanoseconds check_queues_start_cpu_time {0};
+			tsc_clock::time_point check_queues_start_wall_time;
+			const auto start_row = [&] {
+				log_row = raw_rows && check_queues.wants_row();
+				check_queues_start_cpu_time  = log_row ? thread_cpu_time() : std::chrono::nanoseconds{0};
+				check_queues_start_wall_time = tsc_clock::now();
+			};
+			start_row();
 			while (!_m_terminate.load()) {
 				const std::chrono::milliseconds max_wait_time {50};
 				if (_m_queue.wait_dequeue_timed(t, std::chrono::duration_cast<std::chrono::microseconds>(max_wait_time).count())) {
+					queue_depth.set(_m_queue.size_approx());
 					const std::lock_guard lock{_m_registry_lock};
-					check_queues.log(record{__switchboard_check_queues_header, {
-						{iteration_no},
-						{check_queues_start_cpu_time},
-						{thread_cpu_time()},
-						{check_queues_start_wall_time},
-						{std::chrono::high_resolution_clock::now()},
-					}});
+					if (log_row) {
+						check_queues.log(
+							iteration_no,
+							check_queues_start_cpu_time,
+							thread_cpu_time(),
+							check_queues_start_wall_time,
+							tsc_clock::now(),
+							kernel_thread_id()
+						);
+					}
 					iteration_no++;
-					_m_registry.at(t.first).invoke_callbacks(t.second);
-					check_queues_start_cpu_time  = thread_cpu_time();
-					check_queues_start_wall_time = std::chrono::high_resolution_clock::now();
+					_m_registry.at(t.topic_name).invoke_callbacks(t);
+					start_row();
 				}
 			}
-			check_queues.log(record{__switchboard_check_queues_header, {
-				{iteration_no},
-				{check_queues_start_cpu_time},
-				{thread_cpu_time()},
-				{check_queues_start_wall_time},
-				{std::chrono::high_resolution_clock::now()},
-			}});
+			if (log_row) {
+				check_queues.log(
+					iteration_no,
+					check_queues_start_cpu_time,
+					thread_cpu_time(),
+					check_queues_start_wall_time,
+					tsc_clock::now(),
+					kernel_thread_id()
+				);
+			}
 
 			while (_m_queue.try_dequeue(t)) {
-				_m_registry.at(t.first).mark_unprocessed(t.second);
+				_m_registry.at(t.topic_name).mark_unprocessed(t.event);
 			}
 			std::cerr << "Drained switchboard" << std::endl;
 		}
@@ -335,11 +611,31 @@ namespace ILLIXR {
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
+			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, *_m_metrics, ty, topic_name, _m_queue, _m_executor.get(), _m_watchdog.get(), _m_terminate).first->second;
 			assert(topic.ty() == ty);
 			topic.schedule(component_id, callback);
 		}
 
+		virtual void _p_watch(const std::string& topic_name, wakeup* w, std::size_t ty) override {
+			/*
+			  Proof of thread-safety:
+			  - Reads _m_registry after acquiring its lock (it can't change)
+			  - Calls topic.watch, which acquires _m_watchers_lock
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, *_m_metrics, ty, topic_name, _m_queue, _m_executor.get(), _m_watchdog.get(), _m_terminate).first->second;
+			assert(topic.ty() == ty);
+			topic.watch(w);
+		}
+
+		virtual void unwatch(const std::string& topic_name, wakeup& w) override {
+			const std::lock_guard lock{_m_registry_lock};
+			auto it = _m_registry.find(topic_name);
+			if (it != _m_registry.end()) {
+				it->second.unwatch(&w);
+			}
+		}
+
 		virtual std::unique_ptr<writer<void>> _p_publish(const std::string& topic_name, std::size_t ty) override {
 			/*
 			  Proof of thread-safety:
@@ -350,7 +646,7 @@ namespace ILLIXR {
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
+			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, *_m_metrics, ty, topic_name, _m_queue, _m_executor.get(), _m_watchdog.get(), _m_terminate).first->second;
 			assert(topic.ty() == ty);
 			return std::unique_ptr<writer<void>>(topic.get_writer().release());
 			/* TODO: (code beautify) why can't I write
@@ -368,7 +664,7 @@ namespace ILLIXR {
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
+			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, *_m_metrics, ty, topic_name, _m_queue, _m_executor.get(), _m_watchdog.get(), _m_terminate).first->second;
 			assert(topic.ty() == ty);
 			return std::unique_ptr<reader_latest<void>>(topic.get_reader_latest().release());
 			/* TODO: (code beautify) why can't I write
@@ -380,7 +676,7 @@ namespace ILLIXR {
 		std::mutex _m_registry_lock;
 		std::vector<std::thread> _m_threads;
 		std::atomic<bool> _m_terminate {false};
-		queue<std::pair<std::string, const void*>> _m_queue;
+		queue<queued_event> _m_queue;
 
 	};
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common/record_logger.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Sends every record to each of several backends, timing each one.
+ *
+ * The time each backend spends in its log calls is reported at shutdown, so that the cost of, say,
+ * keeping SQLite next to a cheaper backend is visible in every run.
+ */
+class tee_record_logger : public record_logger {
+private:
+	struct branch {
+		branch(std::string name_, std::shared_ptr<record_logger> backend_)
+			: name{std::move(name_)}
+			, backend{std::move(backend_)}
+		{ }
+
+		const std::string name;
+		const std::shared_ptr<record_logger> backend;
+		std::atomic<std::size_t> rows {0};
+		std::atomic<std::size_t> time_ns {0};
+	};
+
+public:
+	void add(std::string name, std::shared_ptr<record_logger> backend) {
+		branches.push_back(std::make_unique<branch>(std::move(name), std::move(backend)));
+	}
+
+	virtual ~tee_record_logger() override {
+		for (const auto& b : branches) {
+			std::cerr << "record_logger " << b->name << ": " << std::fixed << std::setprecision(1)
+					  << b->time_ns * 1e-6 << "ms in log calls for " << b->rows << " rows ("
+					  << (b->rows ? b->time_ns / b->rows : 0) << "ns/row)" << std::endl;
+		}
+	}
+
+protected:
+	virtual void log(const record& r) override {
+		for_each_branch(1, [&](record_logger& backend) {
+			backend.log(r);
+		});
+	}
+
+	virtual void log(const std::vector<record>& rs) override {
+		for_each_branch(rs.size(), [&](record_logger& backend) {
+			backend.log(rs);
+		});
+	}
+
+	virtual void log(const record_header& rh, const std::byte* rows, std::size_t count) override {
+		for_each_branch(count, [&](record_logger& backend) {
+			backend.log(rh, rows, count);
+		});
+	}
+
+private:
+	template <typename Fn>
+	void for_each_branch(std::size_t rows, Fn fn) {
+		for (const auto& b : branches) {
+			auto start = std::chrono::steady_clock::now();
+			fn(*b->backend);
+			b->time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			b->rows += rows;
+		}
+	}
+
+	// Set up before the first log call, then read-only.
+	std::vector<std::unique_ptr<branch>> branches;
+};
+
+}
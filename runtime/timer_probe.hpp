@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/metrics.hpp"
+#include "common/thread_scheduling.hpp"
+#include "common/wakeup.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief Threads that do nothing but sleep, to measure how late the scheduler wakes a thread up.
+ *
+ * A plugin that sleeps until shortly before a deadline (like timewarp before vsync) has to allow for
+ * the wake-up being late, and how late depends on the machine, its load and the thread's scheduling
+ * policy. Each probe thread sleeps for `ILLIXR_TIMER_PROBE_INTERVAL_US` (default 1000) at a time, the
+ * same way threadloops do, and records how late each wake-up was in the
+ * `timer_probe/<probe>/timer_latency` histogram, next to each threadloop's own
+ * `threadloop/<plugin>/timer_latency`.
+ *
+ * `ILLIXR_TIMER_PROBE` lists the probes in the format of `ILLIXR_THREAD_SCHEDULING`, with one thread
+ * per entry, scheduled as that entry says; e.g. `ILLIXR_TIMER_PROBE=normal=;fifo80=fifo:80@2`
+ * compares the default policy with SCHED_FIFO on CPU 2. A policy that cannot be applied is reported,
+ * and that probe measures the default instead. When it stops, it prints each probe's percentiles.
+ */
+class timer_probe {
+public:
+	/**
+	 * @brief Starts the probes in @p spec; throws `std::runtime_error` (before starting any) if it is malformed.
+	 */
+	timer_probe(std::shared_ptr<metrics_registry> metrics_, const std::string& spec, std::chrono::microseconds interval_)
+		: metrics{std::move(metrics_)}
+		, conf{thread_scheduling::parse_config(spec, "ILLIXR_TIMER_PROBE")}
+		, interval{interval_}
+	{
+		for (const auto& entry : conf) {
+			const std::string& name = entry.first;
+			if (name.empty()) {
+				continue;
+			}
+			names.push_back(name);
+			histogram& latency = metrics->get_histogram(histogram_name(name));
+			threads.emplace_back([this, name, &latency] {
+				probe(name, latency);
+			});
+		}
+	}
+
+	/**
+	 * @brief The probes in `ILLIXR_TIMER_PROBE`, or nullptr if it names none.
+	 *
+	 * Throws `std::runtime_error` if either variable is malformed.
+	 */
+	static std::unique_ptr<timer_probe> from_env(std::shared_ptr<metrics_registry> metrics) {
+		const char* spec = std::getenv("ILLIXR_TIMER_PROBE");
+		if (!spec || !*spec) {
+			return nullptr;
+		}
+		const char* interval_us = std::getenv("ILLIXR_TIMER_PROBE_INTERVAL_US");
+		long interval = 1000;
+		if (interval_us && *interval_us) {
+			std::size_t end = 0;
+			try {
+				interval = std::stol(interval_us, &end);
+			} catch (const std::logic_error&) { }
+			if (end != std::strlen(interval_us) || interval < 1) {
+				throw std::runtime_error{std::string{"ILLIXR_TIMER_PROBE_INTERVAL_US should be a positive number of microseconds, not "} + interval_us};
+			}
+		}
+		return std::make_unique<timer_probe>(std::move(metrics), spec, std::chrono::microseconds{interval});
+	}
+
+	timer_probe(const timer_probe&) = delete;
+	timer_probe& operator=(const timer_probe&) = delete;
+
+	~timer_probe() {
+		terminate.store(true);
+		stop_wakeup.notify();
+		for (std::thread& t : threads) {
+			t.join();
+		}
+		for (const std::string& name : names) {
+			const histogram::snapshot latency = metrics->totals(histogram_name(name));
+			std::cerr << "Timer latency of " << name << ": " << latency.count << " wake-ups every " << interval.count() << "us";
+			if (latency.count) {
+				std::cerr << "; p50 " << latency.quantile(0.5) * 1e-3 << "us p99 " << latency.quantile(0.99) * 1e-3 << "us p99.9 "
+						  << latency.quantile(0.999) * 1e-3 << "us max " << latency.max * 1e-3 << "us";
+			}
+			std::cerr << std::endl;
+		}
+	}
+
+private:
+	static std::string histogram_name(const std::string& name) {
+		return "timer_probe/" + name + "/timer_latency";
+	}
+
+	void probe(const std::string& name, histogram& latency) {
+		std::cout << "thread," << std::this_thread::get_id() << ",timer_probe," << name << std::endl;
+		thread_scheduling::apply(conf, name);
+		while (!terminate.load()) {
+			const std::uint32_t seen = stop_wakeup.sequence();
+			const wakeup::time_point requested = std::chrono::high_resolution_clock::now() + interval;
+			if (terminate.load() || stop_wakeup.wait(seen, requested)) {
+				break;
+			}
+			latency.record(std::chrono::high_resolution_clock::now() - requested);
+		}
+	}
+
+	const std::shared_ptr<metrics_registry> metrics;
+	// Parsed by the constructor, so that the probe threads cannot fail to parse it.
+	const thread_scheduling::config conf;
+	const std::chrono::microseconds interval;
+	std::vector<std::string> names;
+	std::vector<std::thread> threads;
+	// Only notified to stop, so the probes' sleeps end on their timers.
+	wakeup stop_wakeup;
+	std::atomic<bool> terminate {false};
+};
+
+}
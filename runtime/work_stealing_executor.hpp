@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/executor.hpp"
+#include "common/name_matches.hpp"
+#include "common/thread_scheduling.hpp"
+#include "common/wakeup.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief An executor with one deque of tasks per thread, from which idle threads steal.
+ *
+ * A thread takes work from, in order:
+ * 1. the back of its own deque (the tasks it submitted, newest first, while they are cache-hot);
+ * 2. the shared queue (tasks from other threads, deferred tasks and timers that are due), oldest first;
+ * 3. the front of another thread's deque (the oldest, coldest task there).
+ *
+ * Each deque has its own lock, which only its owner takes in steady state, so locks are contended
+ * only when stealing. The timers' lock is only taken to add a timer, or once the earliest one is due
+ * (which every thread can tell from an atomic). With nothing to do, threads sleep on a futex until a
+ * task is submitted or the next timer is due.
+ *
+ * `ILLIXR_EXECUTOR` names the components to run here (comma-separated, a trailing `*` matches a
+ * prefix), and `ILLIXR_EXECUTOR_THREADS` sets the number of threads (by default, one per core).
+ */
+class work_stealing_executor : public executor {
+public:
+	work_stealing_executor(std::vector<std::string> patterns_, std::size_t thread_count)
+		: patterns{std::move(patterns_)}
+	{
+		if (patterns.empty()) {
+			return;
+		}
+		for (std::size_t i = 0; i < std::max<std::size_t>(thread_count, 1); ++i) {
+			workers.push_back(std::make_unique<worker>());
+		}
+		for (std::size_t i = 0; i < workers.size(); ++i) {
+			workers[i]->thread = std::thread{[this, i] {
+				std::cout << "thread," << std::this_thread::get_id() << ",executor," << i << std::endl;
+				thread_scheduling::apply("executor");
+				run(*workers[i]);
+			}};
+		}
+	}
+
+	static std::shared_ptr<work_stealing_executor> from_env() {
+		const char* names = std::getenv("ILLIXR_EXECUTOR");
+		const char* threads = std::getenv("ILLIXR_EXECUTOR_THREADS");
+		std::vector<std::string> patterns;
+		std::istringstream names_stream {names ? names : ""};
+		std::string name;
+		while (std::getline(names_stream, name, ',')) {
+			if (!name.empty()) {
+				patterns.push_back(name);
+			}
+		}
+		const std::size_t thread_count = threads && *threads ? std::stoul(threads) : std::thread::hardware_concurrency();
+		return std::make_shared<work_stealing_executor>(std::move(patterns), thread_count);
+	}
+
+	virtual bool runs(const std::string& name) const override {
+		return std::any_of(patterns.cbegin(), patterns.cend(), [&](const std::string& pattern) {
+			return name_matches(pattern, name);
+		});
+	}
+
+	virtual void submit(task t) override {
+		if (terminate.load()) {
+			return;
+		}
+		if (current && current->owner == this) {
+			{
+				const std::lock_guard lock{current->lock};
+				current->tasks.push_back(std::move(t));
+			}
+			// Another thread may be idle, and could take this or what this thread is doing now.
+			idle.notify_one();
+		} else {
+			defer(std::move(t));
+		}
+	}
+
+	virtual void defer(task t) override {
+		if (terminate.load()) {
+			return;
+		}
+		{
+			const std::lock_guard lock{shared_lock};
+			shared.push_back(std::move(t));
+		}
+		idle.notify_one();
+	}
+
+	virtual void submit_at(time_point when, task t) override {
+		if (terminate.load()) {
+			return;
+		}
+		{
+			const std::lock_guard lock{timers_lock};
+			timers.push(timer{when, timer_no++, std::move(t)});
+			next_due.store(timers.top().when.time_since_epoch().count());
+		}
+		// A sleeping thread may have to wake up sooner than it planned.
+		idle.notify_one();
+	}
+
+	virtual void stop() override {
+		if (terminate.exchange(true)) {
+			return;
+		}
+		idle.notify();
+		std::size_t executed = 0;
+		std::size_t stolen = 0;
+		for (const std::unique_ptr<worker>& w : workers) {
+			w->thread.join();
+			executed += w->executed;
+			stolen += w->stolen;
+		}
+		if (!workers.empty()) {
+			std::cerr << "Stopped executor: " << workers.size() << " threads ran " << executed << " tasks, " << stolen << " of them stolen"
+					  << std::endl;
+		}
+	}
+
+	virtual ~work_stealing_executor() override {
+		stop();
+	}
+
+private:
+	struct worker {
+		std::mutex lock;
+		std::deque<task> tasks;
+		std::thread thread;
+		const work_stealing_executor* owner = nullptr;
+		// Only used by this worker's thread.
+		std::size_t executed = 0;
+		std::size_t stolen = 0;
+		std::size_t next_victim = 0;
+	};
+
+	struct timer {
+		time_point when;
+		std::size_t timer_no;
+		task fn;
+
+		// For a min-heap: the earliest (then the first submitted) on top.
+		bool operator<(const timer& other) const {
+			return when != other.when ? when > other.when : timer_no > other.timer_no;
+		}
+	};
+
+	void run(worker& self) {
+		self.owner = this;
+		current = &self;
+		while (!terminate.load()) {
+			// Read before looking for work, so that a task submitted meanwhile is not slept through.
+			const std::uint32_t seen = idle.sequence();
+			if (std::optional<task> t = find_task(self)) {
+				(*t)();
+				++self.executed;
+			} else if (!terminate.load()) {
+				idle.wait(seen, next_timer());
+			}
+		}
+		current = nullptr;
+	}
+
+	std::optional<task> find_task(worker& self) {
+		fire_timers();
+		{
+			const std::lock_guard lock{self.lock};
+			if (!self.tasks.empty()) {
+				task t = std::move(self.tasks.back());
+				self.tasks.pop_back();
+				return t;
+			}
+		}
+		{
+			const std::lock_guard lock{shared_lock};
+			if (!shared.empty()) {
+				task t = std::move(shared.front());
+				shared.pop_front();
+				return t;
+			}
+		}
+		for (std::size_t i = 0; i < workers.size(); ++i) {
+			worker& victim = *workers[(self.next_victim + i) % workers.size()];
+			if (&victim == &self) {
+				continue;
+			}
+			const std::lock_guard lock{victim.lock};
+			if (!victim.tasks.empty()) {
+				task t = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				++self.stolen;
+				// Spread the next steal to the next victim.
+				self.next_victim = (self.next_victim + i + 1) % workers.size();
+				return t;
+			}
+		}
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief Moves the timers that are due to the shared queue.
+	 */
+	void fire_timers() {
+		const time_point now = std::chrono::high_resolution_clock::now();
+		if (now.time_since_epoch().count() < next_due.load()) {
+			return;
+		}
+		std::vector<task> due;
+		{
+			const std::lock_guard lock{timers_lock};
+			while (!timers.empty() && timers.top().when <= now) {
+				due.push_back(std::move(const_cast<timer&>(timers.top()).fn));
+				timers.pop();
+			}
+			next_due.store(timers.empty() ? no_timer : timers.top().when.time_since_epoch().count());
+		}
+		if (!due.empty()) {
+			const std::lock_guard lock{shared_lock};
+			std::move(due.begin(), due.end(), std::back_inserter(shared));
+		}
+	}
+
+	std::optional<time_point> next_timer() const {
+		const time_point::rep due = next_due.load();
+		return due == no_timer ? std::nullopt : std::optional<time_point>{time_point{time_point::duration{due}}};
+	}
+
+	static inline thread_local worker* current = nullptr;
+
+	const std::vector<std::string> patterns;
+	std::vector<std::unique_ptr<worker>> workers;
+	std::mutex shared_lock;
+	std::deque<task> shared;
+	std::mutex timers_lock;
+	std::priority_queue<timer> timers;
+	std::size_t timer_no = 0;
+	static constexpr time_point::rep no_timer = std::numeric_limits<time_point::rep>::max();
+	// When the earliest timer is due (time_since_epoch().count()), or no_timer; written under timers_lock.
+	std::atomic<time_point::rep> next_due {no_timer};
+	wakeup idle;
+	std::atomic<bool> terminate {false};
+};
+
+}
@@ -22,20 +22,32 @@ typedef void (*glXSwapIntervalEXTProc)(Display *dpy, GLXDrawable drawable, int i
 // If this is defined, gldemo will use Monado-style eyebuffers
 //#define USE_ALT_EYE_FORMAT
 
-const record_header timewarp_gpu_record {"timewarp_gpu", {
-	{"iteration_no", typeid(std::size_t)},
-	{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
-	{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
-	{"gpu_time_duration", typeid(std::chrono::nanoseconds)},
+const record_type<
+	std::size_t,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::nanoseconds
+> timewarp_gpu_record {"timewarp_gpu", {
+	"iteration_no",
+	"wall_time_start",
+	"wall_time_stop",
+	"gpu_time_duration",
 }};
 
-const record_header mtp_record {"mtp_record", {
-	{"iteration_no", typeid(std::size_t)},
-	{"vsync", typeid(std::chrono::high_resolution_clock::time_point)},
-	{"imu_time", typeid(std::chrono::high_resolution_clock::time_point)},
+// render_time is when the application finished the frame that was warped, so vsync - render_time is its age.
+const record_type<
+	std::size_t,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point,
+	std::chrono::high_resolution_clock::time_point
+> mtp_record {"mtp_record", {
+	"iteration_no",
+	"vsync",
+	"imu_time",
+	"render_time",
 }};
 
-class timewarp_gl : public threadloop {
+class timewarp_gl : public periodic_threadloop {
 
 public:
 	// Public constructor, create_component passes Switchboard handles ("plugs")
@@ -43,7 +55,7 @@ public:
 	// references to the switchboard plugs, so the component can read the
 	// data whenever it needs to.
 	timewarp_gl(std::string name_, phonebook* pb_)
-		: threadloop{name_, pb_}
+		: periodic_threadloop{name_, pb_}
 		, sb{pb->lookup_impl<switchboard>()}
 		, pp{pb->lookup_impl<pose_prediction>()}
 		, xwin{pb->lookup_impl<xlib_gl_extended_window>()}
@@ -56,9 +68,20 @@ public:
 		, _m_vsync_estimate{sb->publish<time_type>("vsync_estimate")}
 		, _m_mtp{sb->publish<std::chrono::duration<double, std::nano>>("mtp")}
 		, _m_frame_age{sb->publish<std::chrono::duration<double, std::nano>>("warp_frame_age")}
-		, timewarp_gpu_logger{record_logger_}
-		, mtp_logger{record_logger_}
-	{ }
+		, timewarp_gpu_logger{record_logger_, timewarp_gpu_record}
+		, mtp_logger{record_logger_, mtp_record}
+		, _m_gpu_time{metrics_->get_histogram("timewarp/gpu_time")}
+		, _m_mtp_hist{metrics_->get_histogram("timewarp/mtp")}
+	{
+		// The swap returns just after the vsync following the deadline; a whole period after the
+		// deadline, that vsync has certainly been missed.
+		budget = vsync_period;
+	#ifdef USE_ALT_EYE_FORMAT
+		wake_on<rendered_frame_alt>("eyebuffer");
+	#else
+		wake_on<rendered_frame>("eyebuffer");
+	#endif
+	}
 
 private:
 	const std::shared_ptr<switchboard> sb;
@@ -86,6 +109,8 @@ private:
 	#else
 	std::unique_ptr<reader_latest<rendered_frame>> _m_eyebuffer;
 	#endif
+	// Whether the first eye buffer has come, and so the loop no longer waits for one.
+	bool _m_have_eyebuffer = false;
 
 	// Switchboard plug for sending hologram calls
 	std::unique_ptr<writer<hologram_input>> _m_hologram;
@@ -99,8 +124,20 @@ private:
 	// Switchboard plug for publishing frame stale-ness metrics
 	std::unique_ptr<writer<std::chrono::duration<double, std::nano>>> _m_frame_age;
 
-	record_coalescer timewarp_gpu_logger;
-	record_coalescer mtp_logger;
+	typed_record_coalescer<
+		std::size_t,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::nanoseconds
+	> timewarp_gpu_logger;
+	typed_record_coalescer<
+		std::size_t,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::high_resolution_clock::time_point,
+		std::chrono::high_resolution_clock::time_point
+	> mtp_logger;
+	histogram& _m_gpu_time;
+	histogram& _m_mtp_hist;
 
 	GLuint timewarpShaderProgram;
 
@@ -268,30 +305,32 @@ private:
 		return lastSwapTime + vsync_period;
 	}
 
-	// Get the estimated amount of time to put the CPU thread to sleep,
-	// given a specified percentage of the total Vsync period to delay.
-	std::chrono::duration<double, std::nano> EstimateTimeToSleep(double framePercentage){
-		return (GetNextSwapTimeEstimate() - std::chrono::high_resolution_clock::now()) * framePercentage;
-	}
-
 
 public:
 
-	virtual skip_option _p_should_skip() override {
-		using namespace std::chrono_literals;
-		// Sleep for approximately 90% of the time until the next vsync.
-		// Scheduling granularity can't be assumed to be super accurate here,
-		// so don't push your luck (i.e. don't wait too long....) Tradeoff with
-		// MTP here. More you wait, closer to the display sync you sample the pose.
+	virtual std::optional<time_point> _p_next_deadline(time_point) override {
+		// Wake up DELAY_FRACTION of the way from the last swap to the next vsync.
+		// periodic_threadloop spins the last stretch, so this is accurate to well under a
+		// millisecond, but it is still a tradeoff with MTP: the later we wake, the closer to the
+		// display sync we sample the pose, and the likelier we are to miss it.
+		return lastSwapTime + std::chrono::duration_cast<std::chrono::nanoseconds>(vsync_period * DELAY_FRACTION);
+	}
 
+	virtual skip_option _p_should_skip_at_deadline() override {
 		// TODO: poll GLX window events
-		std::this_thread::sleep_for(std::chrono::duration<double>(EstimateTimeToSleep(DELAY_FRACTION)));
 		if(_m_eyebuffer->get_latest_ro()) {
+			// From now on, there is always a frame to warp. Each new one waking this thread (which
+			// only goes back to sleep) would cost a context switch on the display path.
+			if (!_m_have_eyebuffer) {
+				_m_have_eyebuffer = true;
+				stop_waking_on("eyebuffer");
+			}
 			return skip_option::run;
 		} else {
 			// Null means system is nothing has been pushed yet
-			// because not all components are initialized yet
-			return skip_option::skip_and_yield;
+			// because not all components are initialized yet.
+			// Sleep until the first one is.
+			return skip_option::skip_and_wait;
 		}
 	}
 
@@ -566,18 +605,25 @@ public:
 
 		// get the query result
 		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
-		timewarp_gpu_logger.log(record{timewarp_gpu_record, {
-			{iteration_no},
-			{gpu_start_wall_time},
-			{std::chrono::high_resolution_clock::now()},
-			{std::chrono::nanoseconds(elapsed_time)},
-		}});
-
-		mtp_logger.log(record{mtp_record, {
-			{iteration_no},
-			{std::chrono::high_resolution_clock::now()},
-			{latest_pose.pose.sensor_time},
-		}});
+		if (timewarp_gpu_logger.wants_row()) {
+			timewarp_gpu_logger.log(
+				iteration_no,
+				gpu_start_wall_time,
+				std::chrono::high_resolution_clock::now(),
+				std::chrono::nanoseconds(elapsed_time)
+			);
+		}
+
+		if (mtp_logger.wants_row()) {
+			mtp_logger.log(
+				iteration_no,
+				std::chrono::high_resolution_clock::now(),
+				latest_pose.pose.sensor_time,
+				most_recent_frame->render_time
+			);
+		}
+		_m_gpu_time.record(std::chrono::nanoseconds(elapsed_time));
+		_m_mtp_hist.record(lastSwapTime - latest_pose.pose.sensor_time);
 
 #ifndef NDEBUG
 		// TODO (implement-logging): When we have logging infra, delete this code.
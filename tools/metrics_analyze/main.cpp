@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <experimental/filesystem>
+#include "sqlite3pp/sqlite3pp.hpp"
+#include "common/columnar_log.hpp"
+#include "common/metrics.hpp"
+
+/*
+  Summarizes the metrics of one ILLIXR run:
+
+  - per plugin: threadloop iterations, skips, rate, and wall and CPU time per iteration, plus the
+    deadline misses and how far they overran, for threadloops with a budget;
+  - per switchboard topic and subscriber: dispatch latency (put to callback start) and callback
+    duration;
+  - for both, if the run had ILLIXR_PERF_COUNTERS set: instructions per cycle, and LLC misses,
+    branch misses and context switches per iteration or callback;
+  - timewarp GPU time;
+  - motion-to-photon latency and frame age from mtp_record, with the number of missed vsyncs (gaps
+    between warps longer than one refresh period) and stale frames (older than one period).
+
+  Distributions are counted in the runtime's own histogram (common/metrics.hpp), so quantiles are
+  within about 3%, and tables are streamed block by block rather than loaded, so this keeps up with
+  long runs. Tables are read as in tools/trace_export: metrics/<table>.ilxc if present, else
+  metrics/<table>.sqlite, else the table in metrics/illixr.sqlite (the sqlite_wal backend).
+
+  Usage: ./main.opt.exe [metrics_dir [summary.json|summary.csv]]
+  With no output file, the JSON goes to stdout.
+*/
+
+using namespace ILLIXR;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * @brief One table of a run, read a row at a time. Only integer-valued columns can be streamed.
+ */
+class table_source {
+public:
+	static std::optional<table_source> open(const fs::path& dir, const std::string& name) {
+		if (fs::exists(dir / (name + ".ilxc"))) {
+			return table_source{name, std::make_unique<columnar::mapped_file>((dir / (name + ".ilxc")).string())};
+		} else if (fs::exists(dir / (name + ".sqlite"))) {
+			return table_source{name, std::make_unique<sqlite3pp::database>((dir / (name + ".sqlite")).c_str())};
+		} else if (auto db = open_combined(dir, name)) {
+			return table_source{name, std::move(db)};
+		} else {
+			std::cerr << "No " << name << " table in " << dir << "; skipping it." << std::endl;
+			return std::nullopt;
+		}
+	}
+
+	bool has_column(const std::string& column) const {
+		return std::find(column_names.cbegin(), column_names.cend(), column) != column_names.cend();
+	}
+
+	/**
+	 * @brief Calls @p fn with the values of @p columns (an `int64_t` array, in that order) for every row.
+	 */
+	template <typename Fn>
+	void for_each_row(const std::vector<std::string>& columns, Fn fn) const {
+		std::vector<int64_t> values (columns.size());
+		if (file) {
+			const columnar::reader log {file->data, file->size};
+			std::vector<unsigned> indices;
+			for (const std::string& column : columns) {
+				indices.push_back(index_of(column));
+			}
+			std::vector<std::vector<int64_t>> block_columns (columns.size());
+			log.for_each_block([&](const columnar::block_view& block) {
+				for (std::size_t i = 0; i < columns.size(); ++i) {
+					block_columns[i] = block.integers(indices[i]);
+				}
+				for (std::size_t row = 0; row < block.rows(); ++row) {
+					for (std::size_t i = 0; i < columns.size(); ++i) {
+						values[i] = block_columns[i][row];
+					}
+					fn(values.data());
+				}
+			});
+		} else {
+			std::string select;
+			for (const std::string& column : columns) {
+				index_of(column);
+				select += (select.empty() ? "" : ", ") + column;
+			}
+			sqlite3pp::query query {*db, ("SELECT " + select + " FROM " + name).c_str()};
+			for (auto row : query) {
+				for (std::size_t i = 0; i < columns.size(); ++i) {
+					values[i] = row.get<long long>(i);
+				}
+				fn(values.data());
+			}
+		}
+	}
+
+	/**
+	 * @brief Maps the integer column @p key to the string column @p value, for the small name tables.
+	 */
+	std::unordered_map<int64_t, std::string> names(const std::string& key, const std::string& value) const {
+		std::unordered_map<int64_t, std::string> ret;
+		if (file) {
+			const columnar::reader log {file->data, file->size};
+			log.for_each_block([&](const columnar::block_view& block) {
+				const std::vector<int64_t> keys = block.integers(index_of(key));
+				const std::vector<std::string_view> values = block.strings(index_of(value));
+				for (std::size_t row = 0; row < block.rows(); ++row) {
+					ret[keys[row]] = std::string{values[row]};
+				}
+			});
+		} else {
+			sqlite3pp::query query {*db, ("SELECT " + key + ", " + value + " FROM " + name).c_str()};
+			for (auto row : query) {
+				ret[row.get<long long>(0)] = row.get<std::string>(1);
+			}
+		}
+		return ret;
+	}
+
+private:
+	/**
+	 * @brief The single database written by sqlite_wal_record_logger, if it has the table @p name.
+	 */
+	static std::unique_ptr<sqlite3pp::database> open_combined(const fs::path& dir, const std::string& name) {
+		if (fs::exists(dir / "illixr.sqlite")) {
+			auto db = std::make_unique<sqlite3pp::database>((dir / "illixr.sqlite").c_str());
+			sqlite3pp::query query {*db, "SELECT name FROM sqlite_master WHERE type = 'table' AND name = ?"};
+			query.bind(1, name.c_str(), sqlite3pp::nocopy);
+			if (query.begin() != query.end()) {
+				return db;
+			}
+		}
+		return nullptr;
+	}
+
+	table_source(std::string name_, std::unique_ptr<columnar::mapped_file> file_)
+		: name{std::move(name_)}
+		, file{std::move(file_)}
+		, column_names{columnar::reader{file->data, file->size}.get_column_names()}
+	{ }
+
+	table_source(std::string name_, std::unique_ptr<sqlite3pp::database> db_)
+		: name{std::move(name_)}
+		, db{std::move(db_)}
+	{
+		sqlite3pp::query query {*db, ("SELECT * FROM " + name + " LIMIT 0").c_str()};
+		for (int i = 0; i < query.column_count(); ++i) {
+			column_names.emplace_back(query.column_name(i));
+		}
+	}
+
+	unsigned index_of(const std::string& column) const {
+		auto it = std::find(column_names.cbegin(), column_names.cend(), column);
+		if (it == column_names.cend()) {
+			throw std::runtime_error{"Missing column " + column + " in " + name + "; were these metrics written by an older ILLIXR?"};
+		}
+		return it - column_names.cbegin();
+	}
+
+	std::string name;
+	std::unique_ptr<columnar::mapped_file> file;
+	std::unique_ptr<sqlite3pp::database> db;
+	std::vector<std::string> column_names;
+};
+
+/**
+ * @brief A distribution of nanosecond values, summarized at the end.
+ */
+class distribution {
+public:
+	void record(int64_t ns) {
+		hist.record(static_cast<uint64_t>(std::max<int64_t>(ns, 0)));
+	}
+
+	const histogram::snapshot& get() {
+		if (!taken) {
+			hist.take(snap);
+			taken = true;
+		}
+		return snap;
+	}
+
+	/**
+	 * @brief The number of values greater than @p threshold, to the histogram's precision.
+	 */
+	uint64_t count_above(uint64_t threshold) {
+		uint64_t ret = 0;
+		for (std::size_t i = 0; i < histogram::buckets; ++i) {
+			if (histogram::highest_equivalent(i) > threshold) {
+				ret += get().counts[i];
+			}
+		}
+		return ret;
+	}
+
+private:
+	// A few of these are allocated per plugin and topic; the counts are too big for the stack.
+	histogram hist;
+	histogram::snapshot snap;
+	bool taken = false;
+};
+
+/**
+ * @brief Sums of the perf_counters columns of threadloop_iteration or switchboard_callback.
+ */
+struct counter_totals {
+	static inline const std::vector<std::string> columns {"cycles", "instructions", "llc_misses", "branch_misses", "context_switches"};
+	std::array<uint64_t, 5> sums {};
+
+	void add(const int64_t* v) {
+		for (std::size_t i = 0; i < sums.size(); ++i) {
+			sums[i] += v[i];
+		}
+	}
+};
+
+struct plugin_stats {
+	counter_totals counters;
+	uint64_t skips = 0;
+	int64_t first_start = std::numeric_limits<int64_t>::max();
+	int64_t last_stop = std::numeric_limits<int64_t>::min();
+	distribution wall_time;
+	distribution cpu_time;
+	distribution overrun;
+};
+
+struct callback_stats {
+	counter_totals counters;
+	distribution dispatch_latency;
+	distribution duration;
+};
+
+/**
+ * @brief Writes the summary as JSON or CSV.
+ *
+ * JSON is one object per group (`plugins`, `callbacks`, `timewarp`), holding objects per name,
+ * holding counts and distributions. CSV is one line per count or distribution, with the
+ * distribution columns empty for counts.
+ */
+class summary_writer {
+public:
+	summary_writer(std::ostream& out_, bool csv_)
+		: out{out_}
+		, csv{csv_}
+	{
+		// Enough for counts to come out as integers.
+		out << std::setprecision(12);
+		if (csv) {
+			out << "group,name,metric,count,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+		} else {
+			out << "{";
+		}
+	}
+
+	~summary_writer() {
+		if (!csv) {
+			close_group();
+			out << "\n}\n";
+		}
+	}
+
+	void begin(const std::string& group_, const std::string& name_) {
+		if (!csv) {
+			if (group_ != group) {
+				close_group();
+				out << (group.empty() ? "" : ",") << "\n  " << quote(group_) << ": {";
+			} else {
+				out << "\n    },";
+			}
+			out << "\n    " << quote(name_) << ": {";
+			first_field = true;
+		}
+		group = group_;
+		name = name_;
+	}
+
+	void count(const std::string& metric, double value) {
+		if (csv) {
+			out << quote(group) << "," << quote(name) << "," << metric << "," << value << ",,,,,,\n";
+		} else {
+			field(metric) << value;
+		}
+	}
+
+	/**
+	 * @brief Writes what @p c says per event, if anything was counted, over @p events events.
+	 */
+	void counters(const counter_totals& c, uint64_t events) {
+		const auto& [cycles, instructions, llc_misses, branch_misses, context_switches] = c.sums;
+		if (cycles) {
+			count("instructions_per_cycle", static_cast<double>(instructions) / cycles);
+		}
+		if (events && (cycles || context_switches)) {
+			count("llc_misses_per_event", static_cast<double>(llc_misses) / events);
+			count("branch_misses_per_event", static_cast<double>(branch_misses) / events);
+			count("context_switches_per_event", static_cast<double>(context_switches) / events);
+		}
+	}
+
+	void dist(const std::string& metric, distribution& d) {
+		const histogram::snapshot& s = d.get();
+		if (csv) {
+			out << quote(group) << "," << quote(name) << "," << metric << "," << s.count << "," << s.mean() << ","
+				<< s.quantile(0.5) << "," << s.quantile(0.9) << "," << s.quantile(0.99) << "," << s.quantile(0.999) << ","
+				<< s.max << "\n";
+		} else {
+			field(metric) << "{\"count\": " << s.count
+						  << ", \"mean_ns\": " << s.mean()
+						  << ", \"p50_ns\": " << s.quantile(0.5)
+						  << ", \"p90_ns\": " << s.quantile(0.9)
+						  << ", \"p99_ns\": " << s.quantile(0.99)
+						  << ", \"p999_ns\": " << s.quantile(0.999)
+						  << ", \"max_ns\": " << s.max << "}";
+		}
+	}
+
+private:
+	std::ostream& field(const std::string& metric) {
+		out << (first_field ? "" : ",") << "\n      " << quote(metric) << ": ";
+		first_field = false;
+		return out;
+	}
+
+	void close_group() {
+		if (!group.empty()) {
+			out << "\n    }\n  }";
+		}
+	}
+
+	std::string quote(const std::string& in) const {
+		std::ostringstream ret;
+		ret << '"';
+		for (char c : in) {
+			if (c == '"' || (!csv && c == '\\')) {
+				// CSV doubles its quotes; JSON escapes them.
+				ret << (csv ? '"' : '\\') << c;
+			} else if (!csv && static_cast<unsigned char>(c) < 0x20) {
+				ret << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			} else {
+				ret << c;
+			}
+		}
+		ret << '"';
+		return ret.str();
+	}
+
+	std::ostream& out;
+	const bool csv;
+	std::string group;
+	std::string name;
+	bool first_field = true;
+};
+
+int main(int argc, char** argv) {
+	const fs::path dir {argc > 1 ? argv[1] : "metrics"};
+	const std::optional<fs::path> out_path = argc > 2 ? std::optional<fs::path>{argv[2]} : std::nullopt;
+
+	std::unordered_map<int64_t, std::string> plugin_name;
+	if (auto t = table_source::open(dir, "plugin_name")) {
+		plugin_name = t->names("plugin_id", "plugin_name");
+	}
+	auto name_of_plugin = [&](int64_t id) {
+		auto it = plugin_name.find(id);
+		return it == plugin_name.end() ? "plugin " + std::to_string(id) : it->second;
+	};
+	std::unordered_map<int64_t, std::string> topic_name;
+	if (auto t = table_source::open(dir, "switchboard_topic")) {
+		topic_name = t->names("topic_id", "topic_name");
+	}
+	auto name_of_topic = [&](int64_t id) {
+		auto it = topic_name.find(id);
+		return it == topic_name.end() ? "topic " + std::to_string(id) : it->second;
+	};
+
+	std::map<int64_t, std::unique_ptr<plugin_stats>> plugins;
+	if (auto t = table_source::open(dir, "threadloop_iteration")) {
+		std::vector<std::string> columns {"plugin_id", "skips", "cpu_time_start", "cpu_time_stop", "wall_time_start", "wall_time_stop"};
+		// Runs from before the counters were logged do not have these.
+		const bool has_counters = t->has_column("cycles");
+		if (has_counters) {
+			columns.insert(columns.end(), counter_totals::columns.cbegin(), counter_totals::columns.cend());
+		}
+		t->for_each_row(columns, [&](const int64_t* v) {
+			std::unique_ptr<plugin_stats>& stats = plugins[v[0]];
+			if (!stats) {
+				stats = std::make_unique<plugin_stats>();
+			}
+			// skips counts the skips before this iteration, so it is the total so far.
+			stats->skips = std::max<uint64_t>(stats->skips, v[1]);
+			stats->cpu_time.record(v[3] - v[2]);
+			stats->wall_time.record(v[5] - v[4]);
+			stats->first_start = std::min(stats->first_start, v[4]);
+			stats->last_stop = std::max(stats->last_stop, v[5]);
+			if (has_counters) {
+				stats->counters.add(v + 6);
+			}
+		});
+	}
+
+	// Only written by threadloops with a budget, and only when it is missed.
+	std::optional<table_source> misses = table_source::open(dir, "threadloop_deadline_miss");
+	if (misses) {
+		misses->for_each_row({"plugin_id", "overrun"}, [&](const int64_t* v) {
+			if (auto it = plugins.find(v[0]); it != plugins.end()) {
+				it->second->overrun.record(v[1]);
+			}
+		});
+	}
+
+	std::map<std::pair<int64_t, int64_t>, std::unique_ptr<callback_stats>> callbacks;
+	if (auto t = table_source::open(dir, "switchboard_callback")) {
+		std::vector<std::string> columns {"topic_id", "plugin_id", "wall_time_start", "wall_time_stop", "put_wall_time"};
+		const bool has_counters = t->has_column("cycles");
+		if (has_counters) {
+			columns.insert(columns.end(), counter_totals::columns.cbegin(), counter_totals::columns.cend());
+		}
+		t->for_each_row(columns, [&](const int64_t* v) {
+			std::unique_ptr<callback_stats>& stats = callbacks[{v[0], v[1]}];
+			if (!stats) {
+				stats = std::make_unique<callback_stats>();
+			}
+			stats->dispatch_latency.record(v[2] - v[4]);
+			stats->duration.record(v[3] - v[2]);
+			if (has_counters) {
+				stats->counters.add(v + 5);
+			}
+		});
+	}
+
+	auto gpu_time = std::make_unique<distribution>();
+	if (auto t = table_source::open(dir, "timewarp_gpu")) {
+		t->for_each_row({"gpu_time_duration"}, [&](const int64_t* v) {
+			gpu_time->record(v[0]);
+		});
+	}
+
+	auto mtp = std::make_unique<distribution>();
+	auto frame_age = std::make_unique<distribution>();
+	auto vsync_interval = std::make_unique<distribution>();
+	if (auto t = table_source::open(dir, "mtp_record")) {
+		const bool has_render_time = t->has_column("render_time");
+		int64_t last_vsync = 0;
+		t->for_each_row(has_render_time ? std::vector<std::string>{"vsync", "imu_time", "render_time"} : std::vector<std::string>{"vsync", "imu_time"}, [&](const int64_t* v) {
+			mtp->record(v[0] - v[1]);
+			if (has_render_time) {
+				frame_age->record(v[0] - v[2]);
+			}
+			if (last_vsync) {
+				vsync_interval->record(v[0] - last_vsync);
+			}
+			last_vsync = v[0];
+		});
+	}
+
+	std::ofstream file;
+	const bool csv = out_path && out_path->extension() == ".csv";
+	if (out_path) {
+		file.open(*out_path);
+	}
+	{
+		summary_writer summary {out_path ? file : std::cout, csv};
+
+		for (auto& [plugin_id, stats] : plugins) {
+			summary.begin("plugins", name_of_plugin(plugin_id));
+			const uint64_t iterations = stats->wall_time.get().count;
+			summary.count("iterations", iterations);
+			summary.count("skips", stats->skips);
+			summary.count("rate_hz", iterations / std::max(1e-9, (stats->last_stop - stats->first_start) * 1e-9));
+			summary.dist("wall_time", stats->wall_time);
+			summary.dist("cpu_time", stats->cpu_time);
+			if (misses) {
+				const uint64_t deadline_misses = stats->overrun.get().count;
+				summary.count("deadline_misses", deadline_misses);
+				if (deadline_misses) {
+					summary.dist("overrun", stats->overrun);
+				}
+			}
+			summary.counters(stats->counters, iterations);
+		}
+
+		for (auto& [key, stats] : callbacks) {
+			summary.begin("callbacks", name_of_topic(key.first) + " -> " + name_of_plugin(key.second));
+			summary.dist("dispatch_latency", stats->dispatch_latency);
+			summary.dist("duration", stats->duration);
+			summary.counters(stats->counters, stats->duration.get().count);
+		}
+
+		if (gpu_time->get().count || mtp->get().count) {
+			summary.begin("timewarp", "timewarp_gl");
+			summary.dist("gpu_time", *gpu_time);
+			summary.dist("mtp", *mtp);
+			if (frame_age->get().count) {
+				summary.dist("frame_age", *frame_age);
+			}
+			// Warps are paced by vsync, so the typical gap between them is the refresh period.
+			const uint64_t period = vsync_interval->get().quantile(0.5);
+			if (period) {
+				uint64_t missed = 0;
+				for (std::size_t i = 0; i < histogram::buckets; ++i) {
+					if (const uint64_t count = vsync_interval->get().counts[i]) {
+						const double periods = static_cast<double>(histogram::highest_equivalent(i)) / period;
+						missed += count * static_cast<uint64_t>(std::max(0.0, std::round(periods) - 1));
+					}
+				}
+				summary.count("vsync_period_ns", period);
+				summary.count("missed_vsyncs", missed);
+				if (frame_age->get().count) {
+					summary.count("stale_frames", frame_age->count_above(period));
+				}
+			}
+		}
+	}
+	if (out_path) {
+		std::cerr << "Wrote " << out_path->string() << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <experimental/filesystem>
+#include "sqlite3pp/sqlite3pp.hpp"
+#include "common/columnar_log.hpp"
+
+/*
+  Converts the columnar logs written by mmap_record_logger (metrics/<table>.ilxc) to SQLite or CSV,
+  next to the input. Timestamps and durations come out as integer nanoseconds, as with
+  sqlite_record_logger.
+
+  Usage: ./main.opt.exe sqlite|csv metrics/<table>.ilxc...
+*/
+
+using namespace ILLIXR;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * @brief One decoded block: a column of values for each column of the table.
+ */
+struct decoded_block {
+	decoded_block(const columnar::block_view& block, const std::vector<columnar::column_type>& types)
+		: rows{block.rows()}
+	{
+		for (unsigned column = 0; column < types.size(); ++column) {
+			integers.emplace_back();
+			doubles.emplace_back();
+			strings.emplace_back();
+			if (false) {
+			} else if (types[column] == columnar::column_type::f64) {
+				doubles.back() = block.doubles(column);
+			} else if (types[column] == columnar::column_type::string) {
+				strings.back() = block.strings(column);
+			} else {
+				integers.back() = block.integers(column);
+			}
+		}
+	}
+
+	std::size_t rows;
+	std::vector<std::vector<int64_t>> integers;
+	std::vector<std::vector<double>> doubles;
+	std::vector<std::vector<std::string_view>> strings;
+};
+
+static std::size_t to_sqlite(const columnar::reader& log, const fs::path& out) {
+	const std::vector<columnar::column_type>& types = log.get_column_types();
+	fs::remove(out);
+	sqlite3pp::database db {out.c_str()};
+
+	std::string create_table_string = "CREATE TABLE " + log.get_name() + "(";
+	std::string insert_string = "INSERT INTO " + log.get_name() + " VALUES (";
+	for (unsigned i = 0; i < types.size(); ++i) {
+		create_table_string += log.get_column_names()[i] + " ";
+		if (false) {
+		} else if (types[i] == columnar::column_type::f64) {
+			create_table_string += "REAL";
+		} else if (types[i] == columnar::column_type::string) {
+			create_table_string += "TEXT";
+		} else {
+			create_table_string += "INTEGER";
+		}
+		create_table_string += i + 1 < types.size() ? ", " : ");";
+		insert_string += "?" + std::to_string(i + 1) + (i + 1 < types.size() ? ", " : ");");
+	}
+	db.execute(create_table_string.c_str());
+
+	sqlite3pp::command insert_cmd {db, insert_string.c_str()};
+	std::size_t rows = 0;
+	sqlite3pp::transaction xct {db};
+	log.for_each_block([&](const columnar::block_view& block) {
+		decoded_block decoded {block, types};
+		for (std::size_t row = 0; row < decoded.rows; ++row) {
+			for (unsigned i = 0; i < types.size(); ++i) {
+				if (false) {
+				} else if (types[i] == columnar::column_type::f64) {
+					insert_cmd.bind(i + 1, decoded.doubles[i][row]);
+				} else if (types[i] == columnar::column_type::string) {
+					insert_cmd.bind(i + 1, std::string{decoded.strings[i][row]}.c_str(), sqlite3pp::copy);
+				} else {
+					insert_cmd.bind(i + 1, static_cast<long long>(decoded.integers[i][row]));
+				}
+			}
+			insert_cmd.execute();
+			insert_cmd.reset();
+		}
+		rows += decoded.rows;
+	});
+	xct.commit();
+	return rows;
+}
+
+static std::size_t to_csv(const columnar::reader& log, const fs::path& out) {
+	const std::vector<columnar::column_type>& types = log.get_column_types();
+	std::ofstream csv {out};
+	for (unsigned i = 0; i < types.size(); ++i) {
+		csv << log.get_column_names()[i] << (i + 1 < types.size() ? ',' : '\n');
+	}
+
+	std::size_t rows = 0;
+	log.for_each_block([&](const columnar::block_view& block) {
+		decoded_block decoded {block, types};
+		for (std::size_t row = 0; row < decoded.rows; ++row) {
+			for (unsigned i = 0; i < types.size(); ++i) {
+				if (false) {
+				} else if (types[i] == columnar::column_type::f64) {
+					csv << decoded.doubles[i][row];
+				} else if (types[i] == columnar::column_type::string) {
+					// Quote, doubling embedded quotes (RFC 4180).
+					csv << '"';
+					for (char c : decoded.strings[i][row]) {
+						csv << (c == '"' ? "\"\"" : std::string{c});
+					}
+					csv << '"';
+				} else {
+					csv << decoded.integers[i][row];
+				}
+				csv << (i + 1 < types.size() ? ',' : '\n');
+			}
+		}
+		rows += decoded.rows;
+	});
+	return rows;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3 || (std::string{argv[1]} != "sqlite" && std::string{argv[1]} != "csv")) {
+		std::cerr << "Usage: " << argv[0] << " sqlite|csv <table>.ilxc..." << std::endl;
+		return 1;
+	}
+	const bool sqlite = std::string{argv[1]} == "sqlite";
+
+	for (int arg = 2; arg < argc; ++arg) {
+		fs::path in {argv[arg]};
+		fs::path out = fs::path{in}.replace_extension(sqlite ? ".sqlite" : ".csv");
+		columnar::mapped_file file {in.string()};
+		columnar::reader log {file.data, file.size};
+		std::size_t rows = sqlite ? to_sqlite(log, out) : to_csv(log, out);
+		std::cout << in.string() << " -> " << out.string() << ": " << rows << " rows" << std::endl;
+	}
+	return 0;
+}
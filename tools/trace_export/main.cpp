@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <experimental/filesystem>
+#include "sqlite3pp/sqlite3pp.hpp"
+#include "common/columnar_log.hpp"
+
+/*
+  Turns the metrics of one ILLIXR run into a Chrome JSON trace, which chrome://tracing and
+  https://ui.perfetto.dev both open.
+
+  - One track per thread: threadloop iterations (named after their plugin), switchboard
+    check_queues and callbacks.
+  - A flow arrow along each switchboard edge: from the thread that put the event, at the time it
+    put it, to the callback that consumed it.
+  - A GPU track for timewarp_gpu, and a motion-to-photon counter from mtp_record.
+
+  Each table is read from metrics/<table>.ilxc (mmap_record_logger) if present, else from
+  metrics/<table>.sqlite (sqlite_record_logger), else from metrics/illixr.sqlite
+  (sqlite_wal_record_logger). Missing tables are skipped.
+
+  Usage: ./main.opt.exe [metrics_dir [trace.json]]
+*/
+
+using namespace ILLIXR;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * @brief One table, column by column. Every column in the tables we read is an integer or a string.
+ */
+struct table {
+	std::vector<std::string> column_names;
+	std::vector<std::vector<int64_t>> integers;
+	std::vector<std::vector<std::string>> strings;
+	std::size_t rows = 0;
+
+	std::size_t column(const std::string& name) const {
+		auto it = std::find(column_names.cbegin(), column_names.cend(), name);
+		if (it == column_names.cend()) {
+			throw std::runtime_error{"Missing column " + name + "; were these metrics written by an older ILLIXR?"};
+		}
+		return it - column_names.cbegin();
+	}
+
+	const std::vector<int64_t>& ints(const std::string& name) const {
+		return integers[column(name)];
+	}
+
+	const std::vector<std::string>& strs(const std::string& name) const {
+		return strings[column(name)];
+	}
+};
+
+static table load_columnar(const fs::path& path) {
+	columnar::mapped_file file {path.string()};
+	columnar::reader log {file.data, file.size};
+	const std::vector<columnar::column_type>& types = log.get_column_types();
+
+	table ret;
+	ret.column_names = log.get_column_names();
+	ret.integers.resize(types.size());
+	ret.strings.resize(types.size());
+	log.for_each_block([&](const columnar::block_view& block) {
+		for (unsigned i = 0; i < types.size(); ++i) {
+			if (false) {
+			} else if (types[i] == columnar::column_type::string) {
+				for (std::string_view value : block.strings(i)) {
+					ret.strings[i].emplace_back(value);
+				}
+			} else if (types[i] != columnar::column_type::f64) {
+				std::vector<int64_t> values = block.integers(i);
+				ret.integers[i].insert(ret.integers[i].end(), values.begin(), values.end());
+			}
+		}
+		ret.rows += block.rows();
+	});
+	return ret;
+}
+
+static table load_sqlite(const fs::path& path, const std::string& name) {
+	sqlite3pp::database db {path.c_str()};
+	sqlite3pp::query query {db, ("SELECT * FROM " + name).c_str()};
+
+	table ret;
+	for (int i = 0; i < query.column_count(); ++i) {
+		ret.column_names.emplace_back(query.column_name(i));
+	}
+	ret.integers.resize(ret.column_names.size());
+	ret.strings.resize(ret.column_names.size());
+	for (auto row : query) {
+		for (int i = 0; i < query.column_count(); ++i) {
+			if (row.column_type(i) == SQLITE_TEXT) {
+				ret.strings[i].push_back(row.get<std::string>(i));
+			} else {
+				ret.integers[i].push_back(row.get<long long>(i));
+			}
+		}
+		++ret.rows;
+	}
+	return ret;
+}
+
+static bool has_combined_table(const fs::path& path, const std::string& name) {
+	if (!fs::exists(path)) {
+		return false;
+	}
+	sqlite3pp::database db {path.c_str()};
+	sqlite3pp::query query {db, "SELECT name FROM sqlite_master WHERE type = 'table' AND name = ?"};
+	query.bind(1, name.c_str(), sqlite3pp::nocopy);
+	return query.begin() != query.end();
+}
+
+static std::optional<table> load_table(const fs::path& dir, const std::string& name) {
+	if (fs::exists(dir / (name + ".ilxc"))) {
+		return load_columnar(dir / (name + ".ilxc"));
+	} else if (fs::exists(dir / (name + ".sqlite"))) {
+		return load_sqlite(dir / (name + ".sqlite"), name);
+	} else if (has_combined_table(dir / "illixr.sqlite", name)) {
+		return load_sqlite(dir / "illixr.sqlite", name);
+	} else {
+		std::cerr << "No " << name << " table in " << dir << "; skipping it." << std::endl;
+		return std::nullopt;
+	}
+}
+
+static std::string json_string(const std::string& in) {
+	std::ostringstream out;
+	out << '"';
+	for (char c : in) {
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+	return out.str();
+}
+
+/**
+ * @brief Writes Trace Event Format events, one per line.
+ *
+ * Timestamps are given in nanoseconds since the epoch and written in microseconds since @p origin.
+ */
+class trace_writer {
+public:
+	// Everything on the CPU shares one process; the GPU gets its own, so it sorts separately.
+	static constexpr int CPU_PID = 1;
+	static constexpr int GPU_PID = 2;
+
+	trace_writer(std::ostream& out_, int64_t origin_)
+		: out{out_}
+		, origin{origin_}
+	{
+		out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+		out << std::fixed << std::setprecision(3);
+	}
+
+	~trace_writer() {
+		out << "\n]}\n";
+	}
+
+	void thread_name(int pid, int64_t tid, const std::string& name) {
+		begin("M", "thread_name", pid, tid) << ", \"args\": {\"name\": " << json_string(name) << "}}";
+	}
+
+	void process_name(int pid, const std::string& name) {
+		begin("M", "process_name", pid, 0) << ", \"args\": {\"name\": " << json_string(name) << "}}";
+	}
+
+	std::ostream& slice(const std::string& name, const char* cat, int pid, int64_t tid, int64_t start, int64_t dur) {
+		begin("X", name, pid, tid) << ", \"cat\": \"" << cat << "\", \"ts\": " << us(start) << ", \"dur\": " << dur / 1000.0;
+		return out;
+	}
+
+	void flow(const std::string& name, uint64_t id, int64_t from_tid, int64_t from, int64_t to_tid, int64_t to) {
+		begin("s", name, CPU_PID, from_tid) << ", \"cat\": \"switchboard\", \"id\": " << id << ", \"ts\": " << us(from) << "}";
+		begin("f", name, CPU_PID, to_tid) << ", \"cat\": \"switchboard\", \"id\": " << id << ", \"bp\": \"e\", \"ts\": " << us(to) << "}";
+	}
+
+	void counter(const std::string& name, int64_t ts, const std::string& series, double value) {
+		begin("C", name, CPU_PID, 0) << ", \"ts\": " << us(ts) << ", \"args\": {" << json_string(series) << ": " << value << "}}";
+	}
+
+private:
+	std::ostream& begin(const char* ph, const std::string& name, int pid, int64_t tid) {
+		out << (first ? "" : ",\n");
+		first = false;
+		out << "{\"ph\": \"" << ph << "\", \"name\": " << json_string(name) << ", \"pid\": " << pid << ", \"tid\": " << tid;
+		return out;
+	}
+
+	double us(int64_t ns) const {
+		return (ns - origin) / 1000.0;
+	}
+
+	std::ostream& out;
+	const int64_t origin;
+	bool first = true;
+};
+
+int main(int argc, char** argv) {
+	const fs::path dir {argc > 1 ? argv[1] : "metrics"};
+	const fs::path out_path {argc > 2 ? argv[2] : "trace.json"};
+
+	std::optional<table> plugin_names = load_table(dir, "plugin_name");
+	std::optional<table> topics = load_table(dir, "switchboard_topic");
+	std::optional<table> iterations = load_table(dir, "threadloop_iteration");
+	std::optional<table> callbacks = load_table(dir, "switchboard_callback");
+	std::optional<table> check_queues = load_table(dir, "switchboard_check_queues");
+	std::optional<table> timewarp_gpu = load_table(dir, "timewarp_gpu");
+	std::optional<table> mtp = load_table(dir, "mtp_record");
+
+	std::unordered_map<int64_t, std::string> plugin_name;
+	if (plugin_names) {
+		for (std::size_t i = 0; i < plugin_names->rows; ++i) {
+			plugin_name[plugin_names->ints("plugin_id")[i]] = plugin_names->strs("plugin_name")[i];
+		}
+	}
+	auto name_of_plugin = [&](int64_t id) {
+		auto it = plugin_name.find(id);
+		return it == plugin_name.end() ? "plugin " + std::to_string(id) : it->second;
+	};
+	std::unordered_map<int64_t, std::string> topic_name;
+	if (topics) {
+		for (std::size_t i = 0; i < topics->rows; ++i) {
+			topic_name[topics->ints("topic_id")[i]] = topics->strs("topic_name")[i];
+		}
+	}
+
+	// Start the timeline at the first thing that happened.
+	int64_t origin = std::numeric_limits<int64_t>::max();
+	for (const auto& [t, column] : std::initializer_list<std::pair<const std::optional<table>*, const char*>>{
+			{&iterations, "wall_time_start"},
+			{&callbacks, "put_wall_time"},
+			{&check_queues, "wall_time_start"},
+			{&timewarp_gpu, "wall_time_start"},
+			{&mtp, "vsync"}}) {
+		if (*t && (*t)->rows) {
+			const std::vector<int64_t>& values = (*t)->ints(column);
+			origin = std::min(origin, *std::min_element(values.begin(), values.end()));
+		}
+	}
+	if (origin == std::numeric_limits<int64_t>::max()) {
+		std::cerr << "Nothing to export from " << dir << std::endl;
+		return 1;
+	}
+
+	std::ofstream out {out_path};
+	{
+		trace_writer trace {out, origin};
+		trace.process_name(trace_writer::CPU_PID, "ILLIXR");
+		trace.process_name(trace_writer::GPU_PID, "GPU");
+
+		std::unordered_map<int64_t, std::string> thread_names;
+		if (iterations) {
+			const table& t = *iterations;
+			const std::vector<int64_t>& thread_id = t.ints("thread_id");
+			const std::vector<int64_t>& plugin_id = t.ints("plugin_id");
+			const std::vector<int64_t>& wall_time_start = t.ints("wall_time_start");
+			const std::vector<int64_t>& wall_time_stop = t.ints("wall_time_stop");
+			const std::vector<int64_t>& iteration_no = t.ints("iteration_no");
+			const std::vector<int64_t>& skips = t.ints("skips");
+			const std::vector<int64_t>& cpu_time_stop = t.ints("cpu_time_stop");
+			const std::vector<int64_t>& cpu_time_start = t.ints("cpu_time_start");
+			for (std::size_t i = 0; i < t.rows; ++i) {
+				const int64_t tid = thread_id[i];
+				const std::string name = name_of_plugin(plugin_id[i]);
+				thread_names.try_emplace(tid, name);
+				trace.slice(name, "threadloop", trace_writer::CPU_PID, tid, wall_time_start[i],
+							wall_time_stop[i] - wall_time_start[i])
+					<< ", \"args\": {\"iteration_no\": " << iteration_no[i]
+					<< ", \"skips\": " << skips[i]
+					<< ", \"cpu_time_ns\": " << cpu_time_stop[i] - cpu_time_start[i] << "}}";
+			}
+		}
+
+		if (check_queues) {
+			const table& t = *check_queues;
+			const std::vector<int64_t>& thread_id = t.ints("thread_id");
+			const std::vector<int64_t>& wall_time_start = t.ints("wall_time_start");
+			const std::vector<int64_t>& wall_time_stop = t.ints("wall_time_stop");
+			const std::vector<int64_t>& iteration_no = t.ints("iteration_no");
+			for (std::size_t i = 0; i < t.rows; ++i) {
+				const int64_t tid = thread_id[i];
+				thread_names.try_emplace(tid, "switchboard");
+				// This spans the time between the previous event's callbacks and the next dequeue.
+				trace.slice("check_queues", "switchboard", trace_writer::CPU_PID, tid, wall_time_start[i],
+							wall_time_stop[i] - wall_time_start[i])
+					<< ", \"args\": {\"iteration_no\": " << iteration_no[i] << "}}";
+			}
+		}
+
+		if (callbacks) {
+			const table& t = *callbacks;
+			const std::vector<int64_t>& thread_id = t.ints("thread_id");
+			const std::vector<int64_t>& topic_id = t.ints("topic_id");
+			const std::vector<int64_t>& plugin_id = t.ints("plugin_id");
+			const std::vector<int64_t>& wall_time_start = t.ints("wall_time_start");
+			const std::vector<int64_t>& wall_time_stop = t.ints("wall_time_stop");
+			const std::vector<int64_t>& iteration_no = t.ints("iteration_no");
+			const std::vector<int64_t>& put_wall_time = t.ints("put_wall_time");
+			const std::vector<int64_t>& put_thread_id = t.ints("put_thread_id");
+			for (std::size_t i = 0; i < t.rows; ++i) {
+				const int64_t tid = thread_id[i];
+				const auto topic_it = topic_name.find(topic_id[i]);
+				const std::string topic = topic_it == topic_name.end() ? "topic " + std::to_string(topic_id[i]) : topic_it->second;
+				thread_names.try_emplace(tid, "switchboard");
+				trace.slice(topic + " -> " + name_of_plugin(plugin_id[i]), "switchboard", trace_writer::CPU_PID, tid,
+							wall_time_start[i], wall_time_stop[i] - wall_time_start[i])
+					<< ", \"args\": {\"iteration_no\": " << iteration_no[i]
+					<< ", \"queued_ns\": " << wall_time_start[i] - put_wall_time[i] << "}}";
+				trace.flow(topic, i, put_thread_id[i], put_wall_time[i], tid, wall_time_start[i]);
+			}
+		}
+
+		for (const auto& [tid, name] : thread_names) {
+			trace.thread_name(trace_writer::CPU_PID, tid, name);
+		}
+
+		if (timewarp_gpu) {
+			const table& t = *timewarp_gpu;
+			const std::vector<int64_t>& wall_time_start = t.ints("wall_time_start");
+			const std::vector<int64_t>& gpu_time_duration = t.ints("gpu_time_duration");
+			const std::vector<int64_t>& iteration_no = t.ints("iteration_no");
+			trace.thread_name(trace_writer::GPU_PID, 1, "timewarp_gl");
+			for (std::size_t i = 0; i < t.rows; ++i) {
+				trace.slice("timewarp", "gpu", trace_writer::GPU_PID, 1, wall_time_start[i], gpu_time_duration[i])
+					<< ", \"args\": {\"iteration_no\": " << iteration_no[i] << "}}";
+			}
+		}
+
+		if (mtp) {
+			const table& t = *mtp;
+			const std::vector<int64_t>& vsync = t.ints("vsync");
+			const std::vector<int64_t>& imu_time = t.ints("imu_time");
+			for (std::size_t i = 0; i < t.rows; ++i) {
+				trace.counter("motion-to-photon", vsync[i], "ms", (vsync[i] - imu_time[i]) / 1e6);
+			}
+		}
+	}
+	std::cout << "Wrote " << out_path.string() << std::endl;
+	return 0;
+}
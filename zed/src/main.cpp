@@ -13,10 +13,10 @@ using namespace ILLIXR;
 
 cv::Mat slMat2cvMat(Mat& input);
 
-const record_header __imu_cam_record {"imu_cam", {
-    {"iteration_no", typeid(std::size_t)},
-    {"has_camera", typeid(bool)},
-}};
+const record_type<std::size_t, bool> __imu_cam_record {"imu_cam", {
+    "iteration_no",
+    "has_camera",
+}, record_verbosity::detailed};
 
 typedef struct {
     cv::Mat* img0;
@@ -77,13 +77,19 @@ private:
 
 protected:
     virtual skip_option _p_should_skip() override {
+        // grab() blocks until the next frame, so it only fails when the camera has a problem; back
+        // off rather than spinning on the error.
         if (zedm->grab(runtime_parameters) == ERROR_CODE::SUCCESS) {
             return skip_option::run;
         } else {
-            return skip_option::skip_and_spin;
+            return skip_option::skip_and_wait;
         }
     }
 
+    virtual std::optional<time_point> _p_wait_deadline() override {
+        return std::chrono::high_resolution_clock::now() + std::chrono::milliseconds{1};
+    }
+
     virtual void _p_one_iteration() override {
         // Retrieve images
         zedm->retrieveImage(imageL_zed, VIEW::LEFT, MEM::CPU, image_size);
@@ -116,7 +122,7 @@ public:
         , zedm{start_camera()}
         , camera_thread_{"zed_camera_thread", pb_, zedm}
         , _m_cam_type{sb->subscribe_latest<cam_type>("cam_type")}
-        , it_log{record_logger_}
+        , it_log{record_logger_, __imu_cam_record}
     {
         camera_thread_.start();
     }
@@ -133,10 +139,15 @@ protected:
             std::this_thread::sleep_for(std::chrono::milliseconds{2});
             return skip_option::run;
         } else {
-            return skip_option::skip_and_yield;
+            // The SDK has no way to block until the next sample, so poll at a multiple of its rate.
+            return skip_option::skip_and_wait;
         }
     }
 
+    virtual std::optional<time_point> _p_wait_deadline() override {
+        return std::chrono::high_resolution_clock::now() + std::chrono::microseconds{250};
+    }
+
     virtual void _p_one_iteration() override {
         // std::cout << "IMU Rate: " << sensors_data.imu.effective_rate << "\n" << std::endl;
 
@@ -163,10 +174,7 @@ protected:
             img1 = c->img1;
         }
 
-        it_log.log(record{__imu_cam_record, {
-            {iteration_no},
-            {bool(img0)},
-        }});
+        it_log.log(iteration_no, bool(img0));
 
         _m_imu_cam->put(new imu_cam_type {
             t,
@@ -201,7 +209,7 @@ private:
     std::size_t last_serial_no {0};
 
     // Logger
-    record_coalescer it_log;
+    typed_record_coalescer<std::size_t, bool> it_log;
 };
 
 // This line makes the plugin importable by Spindle